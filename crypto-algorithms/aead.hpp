@@ -0,0 +1,117 @@
+#pragma once
+
+#include "source_sink.hpp"
+#include "ringbuffer.hpp"
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <algorithm>
+
+namespace symmetric{
+
+//The authenticated encryption modes (Gcm and ChaCha20Poly1305) all have the
+//same interface:
+//
+//    tag_t encrypt(dst, src, size, nonce, aad, aad_size) const;
+//    bool decrypt(dst, src, size, nonce, tag, aad, aad_size) const;
+//
+//plus a nested Context class for messages that arrive in pieces:
+//
+//    Context(aead, nonce, encrypt);
+//    void add_aad(const void *, size_t);
+//    void process(void *dst, const void *src, size_t size);
+//    tag_t finish();
+//    bool verify(const tag_t &);
+//
+//A Context must be given all the associated data before any of the message,
+//and must not outlive the object it was created from. Once finish() or
+//verify() has been called, every further call throws. Each nonce must only
+//ever be used once with the same key.
+
+namespace detail{
+
+//Data is encrypted and authenticated in chunks of this size, so that the MAC
+//reads back bytes that are still in the L1 cache.
+static const size_t aead_chunk_size = 4 << 10;
+
+//Doesn't branch on the contents, so timing reveals nothing about where a
+//forged tag differs.
+inline bool constant_time_equal(const void *void_a, const void *void_b, size_t size){
+	auto a = (const std::uint8_t *)void_a;
+	auto b = (const std::uint8_t *)void_b;
+	std::uint8_t difference = 0;
+	for (size_t i = 0; i < size; i++)
+		difference |= a[i] ^ b[i];
+	return !difference;
+}
+
+template <typename Aead>
+typename Aead::tag_t aead_encrypt(const Aead &aead, void *dst, const void *src, size_t size, const typename Aead::nonce_t &nonce, const void *aad, size_t aad_size){
+	typename Aead::Context context(aead, nonce, true);
+	context.add_aad(aad, aad_size);
+	context.process(dst, src, size);
+	return context.finish();
+}
+
+//Wipes dst if the tag doesn't match.
+template <typename Aead>
+bool aead_decrypt(const Aead &aead, void *dst, const void *src, size_t size, const typename Aead::nonce_t &nonce, const typename Aead::tag_t &tag, const void *aad, size_t aad_size){
+	typename Aead::Context context(aead, nonce, false);
+	context.add_aad(aad, aad_size);
+	context.process(dst, src, size);
+	if (context.verify(tag))
+		return true;
+	if (size)
+		memset(dst, 0, size);
+	return false;
+}
+
+}
+
+namespace stream{
+
+//Encrypts or decrypts everything written to it, and makes the result
+//available for reading. After the last write, call get_tag() when
+//encrypting, or verify() when decrypting.
+//Decrypted data is readable before it has been authenticated, so it must not
+//be acted upon until verify() returns true.
+template <typename Aead, typename Buffer = utility::RingBuffer>
+class AeadStream : public utility::DataSource, public utility::DataSink{
+	typename Aead::Context context;
+	Buffer output_buffer;
+public:
+	AeadStream(const Aead &aead, const typename Aead::nonce_t &nonce, bool encrypt, const void *aad = nullptr, size_t aad_size = 0)
+			: context(aead, nonce, encrypt)
+			, output_buffer(128 << 10){
+		this->context.add_aad(aad, aad_size);
+	}
+	AeadStream(const AeadStream &) = delete;
+	AeadStream &operator=(const AeadStream &) = delete;
+	size_t write(const void *vsrc, size_t size) override{
+		auto src = (const std::uint8_t *)vsrc;
+		size_t ret = 0;
+		for (auto &span : this->output_buffer.prepare_writable()){
+			auto n = std::min(span.size, size - ret);
+			this->context.process(span.data, src + ret, n);
+			ret += n;
+		}
+		this->output_buffer.commit(ret);
+		return ret;
+	}
+	size_t read(void *dst, size_t size) override{
+		return this->output_buffer.read(dst, size);
+	}
+	std::optional<size_t> available() const override{
+		return this->output_buffer.get_length();
+	}
+	typename Aead::tag_t get_tag(){
+		return this->context.finish();
+	}
+	bool verify(const typename Aead::tag_t &tag){
+		return this->context.verify(tag);
+	}
+};
+
+}
+
+}
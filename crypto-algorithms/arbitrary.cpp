@@ -43,7 +43,7 @@ BigNum::BigNum(const void *buffer, size_t size){
 		T byte = ((const unsigned char *)buffer)[i];
 		accum |= byte << (i % n * 8);
 	}
-	if (accum)
+	if (accum || this->data.empty())
 		this->data.push_back(accum);
 	this->reduce();
 }
@@ -175,9 +175,8 @@ const BigNum &BigNum::operator=(const BigNum &other){
 	return *this;
 }
 
-const BigNum &BigNum::operator=(const BigNum &&other){
-	if (this != &other)
-		this->data = std::move(other.data);
+const BigNum &BigNum::operator=(BigNum &&other) noexcept{
+	this->data = std::move(other.data);
 	this->overflow = other.overflow;
 	return *this;
 }
@@ -298,51 +297,91 @@ const BigNum &BigNum::operator>>=(T shift){
 }
 
 BigNum BigNum::operator*(const BigNum &other) const{
-#if 0
 	BigNum ret;
+	ret.data.reserve(this->data.size() + other.data.size() + 1);
+	ret.mul_add(*this, other);
+	return ret;
+}
+
+void BigNum::mul_add(const BigNum &a, const BigNum &b){
+	this->overflow = false;
+	if (!a || !b)
+		return;
+	if (this == &a || this == &b){
+		auto copy = *this;
+		this->mul_add(this == &a ? copy : a, this == &b ? copy : b);
+		return;
+	}
 	auto &v = this->data;
-	auto &v2 = other.data;
-	BigNum temp;
+	auto &v1 = a.data;
+	auto &v2 = b.data;
+	v.resize(std::max(v.size(), v1.size() + v2.size()) + 1, 0);
 	for (size_t i = 0; i < v2.size(); i++){
-		temp.data.clear();
-		temp.data.resize(i);
+		auto multiplier = v2[i];
+		if (!multiplier)
+			continue;
+		//lo + carry + v[i + j] can't overflow the double-width product, so
+		//the carries out of the low half always fit in hi.
 		T carry = 0;
-		for (size_t j = 0; j < v.size(); j++){
-			auto product = v[j] * v2[i];
-			if (carry){
-				if (product > max - carry){
-					product -= max - carry + 1;
-					carry = 1;
-				}else{
-					product += carry;
-					carry = 0;
-				}
-			}
-			temp.data.push_back(product);
-			carry += multiplication_carry(v[j], v2[i]);
+		for (size_t j = 0; j < v1.size(); j++){
+			T lo = v1[j] * multiplier;
+			T hi = multiplication_carry(v1[j], multiplier);
+			lo += carry;
+			hi += lo < carry;
+			auto &dst = v[i + j];
+			dst += lo;
+			hi += dst < lo;
+			carry = hi;
+		}
+		for (auto k = i + v1.size(); carry; k++){
+			v[k] += carry;
+			carry = v[k] < carry;
 		}
-		if (carry)
-			temp.data.push_back(carry);
-		ret += temp;
 	}
-#else
-	if (!*this)
-		return *this;
-	if (!other)
-		return other;
-	auto multiplicand = *this;
-	BigNum ret = 0;
-	auto bits = other.prepare_exponent();
-	for (size_t i = 0;;){
-		auto bit = bits[i];
-		if (bit)
-			ret += multiplicand;
-		if (++i == bits.size())
-			break;
-		multiplicand <<= 1;
+	this->reduce();
+}
+
+void BigNum::sub_mul(const BigNum &a, const BigNum &b){
+	this->overflow = false;
+	if (!a || !b)
+		return;
+	if (this == &a || this == &b){
+		auto copy = *this;
+		this->sub_mul(this == &a ? copy : a, this == &b ? copy : b);
+		return;
 	}
-#endif
-	return ret;
+	auto &v = this->data;
+	auto &v1 = a.data;
+	auto &v2 = b.data;
+	v.resize(std::max(v.size(), v1.size() + v2.size()), 0);
+	bool borrow_out = false;
+	for (size_t i = 0; i < v2.size(); i++){
+		auto multiplier = v2[i];
+		if (!multiplier)
+			continue;
+		T borrow = 0;
+		for (size_t j = 0; j < v1.size(); j++){
+			T lo = v1[j] * multiplier;
+			T hi = multiplication_carry(v1[j], multiplier);
+			lo += borrow;
+			hi += lo < borrow;
+			auto &dst = v[i + j];
+			hi += dst < lo;
+			dst -= lo;
+			borrow = hi;
+		}
+		for (auto k = i + v1.size(); borrow; k++){
+			if (k == v.size()){
+				borrow_out = true;
+				break;
+			}
+			auto old = v[k];
+			v[k] -= borrow;
+			borrow = old < borrow;
+		}
+	}
+	this->overflow = borrow_out;
+	this->reduce();
 }
 
 BigNum BigNum::pow(const BigNum &exponent) const{
@@ -531,6 +570,208 @@ BigNum BigNum::gcd(BigNum b) const{
 	return a;
 }
 
+BigNum BigNum::mod_inverse(const BigNum &modulus) const{
+	if (modulus.even() || modulus < 3)
+		throw std::runtime_error("modular inverse needs an odd modulus");
+	//Invariants: u = x1 * a and v = x2 * a, modulo the modulus.
+	//See Menezes et al., Handbook of Applied Cryptography, 14.61.
+	auto u = *this;
+	if (u >= modulus)
+		u %= modulus;
+	auto v = modulus;
+	BigNum x1 = 1;
+	BigNum x2 = 0;
+	auto halve = [&modulus](BigNum &x){
+		if (x.odd())
+			x += modulus;
+		x >>= 1;
+	};
+	while (u != 1 && v != 1){
+		if (!u || !v)
+			throw std::runtime_error("value has no modular inverse");
+		while (u.even()){
+			u >>= 1;
+			halve(x1);
+		}
+		while (v.even()){
+			v >>= 1;
+			halve(x2);
+		}
+		if (u >= v){
+			u -= v;
+			if (x1 < x2)
+				x1 += modulus;
+			x1 -= x2;
+		}else{
+			v -= u;
+			if (x2 < x1)
+				x2 += modulus;
+			x2 -= x1;
+		}
+	}
+	return u == 1 ? x1 : x2;
+}
+
+namespace{
+
+//Signed 320-bit numbers in two's complement, least significant limb first.
+//Everything below runs in the same time whatever the values.
+typedef std::uint64_t ct_number[5];
+
+//For any odd f and any g below 2^256, g reaches 0 within this many divsteps,
+//so x doesn't need to be reduced first. See Bernstein and Yang, "Fast constant-time gcd computation and modular inversion",
+//theorem 11.2.
+const int ct_divsteps = 741;
+
+//x = mask ? y : x
+void ct_select(ct_number &x, const ct_number &y, std::uint64_t mask){
+	for (size_t i = 0; i < 5; i++)
+		x[i] ^= (x[i] ^ y[i]) & mask;
+}
+
+//x += y & mask
+void ct_add(ct_number &x, const ct_number &y, std::uint64_t mask){
+	std::uint64_t carry = 0;
+	for (size_t i = 0; i < 5; i++){
+		auto a = y[i] & mask;
+		auto sum = x[i] + a;
+		auto carry2 = (std::uint64_t)(sum < a);
+		sum += carry;
+		carry = carry2 | (std::uint64_t)(sum < carry);
+		x[i] = sum;
+	}
+}
+
+//x -= y, returning the borrow out of the top limb.
+std::uint64_t ct_sub(ct_number &x, const ct_number &y){
+	std::uint64_t borrow = 0;
+	for (size_t i = 0; i < 5; i++){
+		auto difference = x[i] - y[i];
+		auto borrow2 = (std::uint64_t)(x[i] < y[i]);
+		x[i] = difference - borrow;
+		borrow = borrow2 | (std::uint64_t)(difference < borrow);
+	}
+	return borrow;
+}
+
+//x = mask ? -x : x
+void ct_negate(ct_number &x, std::uint64_t mask){
+	std::uint64_t carry = mask & 1;
+	for (size_t i = 0; i < 5; i++){
+		auto value = (x[i] ^ mask) + carry;
+		carry = (std::uint64_t)(value < carry);
+		x[i] = value;
+	}
+}
+
+//Arithmetic shift right by one.
+void ct_halve(ct_number &x){
+	for (size_t i = 0; i < 4; i++)
+		x[i] = x[i] >> 1 | x[i + 1] << 63;
+	x[4] = x[4] >> 1 | (x[4] & ((std::uint64_t)1 << 63));
+}
+
+//The rest work on residues in [0, m).
+
+//x = x mod m, for x in [0, 2m).
+void ct_reduce_once(ct_number &x, const ct_number &m){
+	ct_number t;
+	std::copy(x, x + 5, t);
+	auto borrow = ct_sub(t, m);
+	ct_select(x, t, borrow - 1);
+}
+
+//x = mask ? -x : x, modulo m
+void ct_negate_mod(ct_number &x, const ct_number &m, std::uint64_t mask){
+	ct_number t;
+	std::copy(m, m + 5, t);
+	ct_sub(t, x);
+	ct_reduce_once(t, m);
+	ct_select(x, t, mask);
+}
+
+//x = x / 2, modulo m
+void ct_halve_mod(ct_number &x, const ct_number &m){
+	ct_add(x, m, (std::uint64_t)0 - (x[0] & 1));
+	ct_halve(x);
+}
+
+//dst = x^-1 mod m, for odd m, or 0 if there is no inverse. Keeps f = d * x and g = e * x, modulo m, while
+//the divsteps take (f, g) from (m, x) to (+/-1, 0).
+void ct_mod_inverse(ct_number &dst, const ct_number &x, const ct_number &m){
+	ct_number f, g, d = {}, e = { 1 };
+	std::copy(m, m + 5, f);
+	std::copy(x, x + 5, g);
+	std::int64_t delta = 1;
+	for (int i = 0; i < ct_divsteps; i++){
+		//If delta > 0 and g is odd: delta, f, g, d, e = -delta, g, -f, e, -d
+		auto swap = (std::uint64_t)0 - ((std::uint64_t)-delta >> 63 & g[0] & 1);
+		delta = (delta ^ (std::int64_t)swap) - (std::int64_t)swap;
+		ct_number t;
+		std::copy(f, f + 5, t);
+		ct_select(f, g, swap);
+		ct_select(g, t, swap);
+		ct_negate(g, swap);
+		std::copy(d, d + 5, t);
+		ct_select(d, e, swap);
+		ct_select(e, t, swap);
+		ct_negate_mod(e, m, swap);
+
+		//delta, g, e = 1 + delta, (g + (g & 1) * f) / 2, (e + (g & 1) * d) / 2
+		delta++;
+		auto odd = (std::uint64_t)0 - (g[0] & 1);
+		ct_add(g, f, odd);
+		ct_halve(g);
+		ct_add(e, d, odd);
+		ct_reduce_once(e, m);
+		ct_halve_mod(e, m);
+	}
+	//f is now +/-gcd(m, x).
+	auto sign = (std::uint64_t)0 - (f[4] >> 63);
+	ct_negate(f, sign);
+	ct_negate_mod(d, m, sign);
+	auto rest = (f[0] ^ 1) | f[1] | f[2] | f[3] | f[4];
+	auto invertible = ((rest | ((std::uint64_t)0 - rest)) >> 63) - 1;
+	for (size_t i = 0; i < 5; i++)
+		dst[i] = d[i] & invertible;
+}
+
+}
+
+BigNum BigNum::mod_inverse_ct(const BigNum &modulus, bool negate) const{
+	if (modulus.even() || modulus < 3 || modulus.active_bits() > 256)
+		throw std::runtime_error("constant time modular inverse needs an odd modulus of at most 256 bits");
+	//Only inputs longer than 256 bits need reducing, and their length isn't
+	//secret anyway.
+	const BigNum *x = this;
+	BigNum reduced;
+	if (this->active_bits() > 256){
+		reduced = *this % modulus;
+		x = &reduced;
+	}
+	//Always converts 256 bits, masking off the limbs past the end.
+	auto to_number = [](ct_number &dst, const BigNum &src){
+		std::fill(dst, dst + 5, 0);
+		auto n = src.data.size();
+		for (size_t i = 0; i < 256 / bits; i++){
+			auto limb = n ? src.data[std::min(i, n - 1)] : 0;
+			limb &= (T)0 - (T)(i < n);
+			dst[i * bits / 64] |= (std::uint64_t)limb << (i * bits % 64);
+		}
+	};
+	ct_number m, a, result;
+	to_number(m, modulus);
+	to_number(a, *x);
+	ct_mod_inverse(result, a, m);
+	ct_negate_mod(result, m, (std::uint64_t)0 - (std::uint64_t)negate);
+	BigNum ret;
+	ret.data.resize(256 / bits);
+	for (size_t i = 0; i < ret.data.size(); i++)
+		ret.data[i] = (T)(result[i * bits / 64] >> (i * bits % 64));
+	ret.reduce();
+	return ret;
+}
+
 std::vector<std::uint8_t> BigNum::to_buffer() const{
 	std::vector<std::uint8_t> ret;
 	if (!*this){
@@ -557,42 +798,43 @@ bool SignedBigNum::operator<(const SignedBigNum &other) const{
 	return this->bignum < other.bignum ? ret : !ret;
 }
 
-SignedBigNum SignedBigNum::operator+(const SignedBigNum &other) const{
-	return this->sum(other, false);
+void SignedBigNum::accumulate(const SignedBigNum &other, bool flip_right_sign){
+	auto other_sign = other.sign != flip_right_sign;
+	if (this->sign == other_sign)
+		this->bignum += other.bignum;
+	else if (this->bignum >= other.bignum)
+		this->bignum -= other.bignum;
+	else{
+		this->bignum = other.bignum - this->bignum;
+		this->sign = other_sign;
+	}
+	this->normalize();
 }
 
-SignedBigNum SignedBigNum::sum(const SignedBigNum &other, bool flip_right_sign) const{
-	SignedBigNum ret;
-	if (this->positive()){
-		if (other.positive() ^ flip_right_sign)
-			ret.bignum = this->bignum + other.bignum;
-		else{
-			if (this->bignum >= other.bignum)
-				ret.bignum = this->bignum - other.bignum;
-			else{
-				ret.bignum = other.bignum - this->bignum;
-				ret.sign = true;
-			}
-		}
-	}else{
-		if ((!other.positive()) ^ flip_right_sign){
-			ret.bignum = this->bignum + other.bignum;
-			ret.sign = true;
-		}else{
-			if (other.bignum >= this->bignum){
-				ret.bignum = other.bignum - this->bignum;
-				ret.sign = true;
-			}else{
-				ret.bignum = this->bignum - other.bignum;
-				ret.sign = false;
-			}
-		}
+void SignedBigNum::mul_add(const SignedBigNum &a, const SignedBigNum &b){
+	auto sign = a.sign != b.sign;
+	if (!this->bignum || this->sign == sign){
+		this->bignum.mul_add(a.bignum, b.bignum);
+		this->sign = sign;
+		this->normalize();
+		return;
 	}
-	return ret;
+	SignedBigNum product = a.bignum * b.bignum;
+	product.sign = sign;
+	this->accumulate(product, false);
 }
 
-SignedBigNum SignedBigNum::operator-(const SignedBigNum &other) const{
-	return this->sum(other, true);
+void SignedBigNum::sub_mul(const SignedBigNum &a, const SignedBigNum &b){
+	auto sign = a.sign == b.sign;
+	if (!this->bignum || this->sign == sign){
+		this->bignum.mul_add(a.bignum, b.bignum);
+		this->sign = sign;
+		this->normalize();
+		return;
+	}
+	SignedBigNum product = a.bignum * b.bignum;
+	product.sign = sign;
+	this->accumulate(product, false);
 }
 
 std::ostream &operator<<(std::ostream &stream, const BigNum &n){
@@ -615,7 +857,8 @@ SignedBigNum SignedBigNum::extended_euclidean(const SignedBigNum &b) const{
 
 		auto temp = std::move(x0);
 		x0 = std::move(x1);
-		x1 = temp - quotient * x0;
+		temp.sub_mul(quotient, x0);
+		x1 = std::move(temp);
 	}
 
 	return x0.euclidean_modulo(b);
@@ -698,4 +941,100 @@ bool tonelli_shanks(SignedBigNum &first_solution, SignedBigNum &second_solution,
 	return true;
 }
 
+ModContext::ModContext(const BigNum &modulus): modulus(modulus){
+	if (modulus < 2)
+		throw std::runtime_error("invalid modulus");
+	this->bits = modulus.active_bits();
+	this->mu = (BigNum(1) << (this->bits * 2)) / modulus;
+	this->constant_time_inverse = modulus.odd() && this->bits <= 256;
+}
+
+void ModContext::reduce(BigNum &x) const{
+	if (x < this->modulus)
+		return;
+	if (x.active_bits() > this->bits * 2){
+		x %= this->modulus;
+		return;
+	}
+	//q is at most 2 less than floor(x / modulus). See Menezes et al.,
+	//Handbook of Applied Cryptography, 14.42.
+	auto q = ((x >> (this->bits - 1)) * this->mu) >> (this->bits + 1);
+	x.sub_mul(q, this->modulus);
+	while (x >= this->modulus)
+		x -= this->modulus;
+}
+
+BigNum ModContext::residue(const SignedBigNum &x) const{
+	auto ret = x.abs();
+	this->reduce(ret);
+	if (x.negative())
+		this->neg_mod(ret, ret);
+	return ret;
+}
+
+void ModContext::add_mod(BigNum &dst, const BigNum &a, const BigNum &b) const{
+	if (&dst == &b)
+		dst += a;
+	else{
+		dst = a;
+		dst += b;
+	}
+	if (dst >= this->modulus)
+		dst -= this->modulus;
+}
+
+void ModContext::sub_mod(BigNum &dst, const BigNum &a, const BigNum &b) const{
+	if (&dst == &b && &dst != &a){
+		auto copy = b;
+		this->sub_mod(dst, a, copy);
+		return;
+	}
+	dst = a;
+	if (dst < b)
+		dst += this->modulus;
+	dst -= b;
+}
+
+void ModContext::neg_mod(BigNum &dst, const BigNum &a) const{
+	if (!a){
+		dst = 0;
+		return;
+	}
+	if (&dst == &a){
+		auto copy = a;
+		this->neg_mod(dst, copy);
+		return;
+	}
+	dst = this->modulus;
+	dst -= a;
+}
+
+void ModContext::mul_mod(BigNum &dst, const BigNum &a, const BigNum &b) const{
+	if (&dst == &a || &dst == &b){
+		BigNum product;
+		product.mul_add(a, b);
+		dst = std::move(product);
+	}else{
+		dst = 0;
+		dst.mul_add(a, b);
+	}
+	this->reduce(dst);
+}
+
+void ModContext::inv_mod(BigNum &dst, const BigNum &a) const{
+	if (!a)
+		throw std::runtime_error("zero has no modular inverse");
+	if (this->constant_time_inverse)
+		dst = a.mod_inverse_ct(this->modulus);
+	else
+		this->inv_mod_vartime(dst, a);
+}
+
+void ModContext::inv_mod_vartime(BigNum &dst, const BigNum &a) const{
+	if (this->modulus.odd())
+		dst = a.mod_inverse(this->modulus);
+	else
+		dst = SignedBigNum(a).extended_euclidean(this->modulus).abs();
+}
+
 }
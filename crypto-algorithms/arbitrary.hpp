@@ -1,5 +1,7 @@
 #pragma once
 
+#include "hex.hpp"
+#include "small_vector.hpp"
 #include <cstdint>
 #include <random>
 #include <iostream>
@@ -7,12 +9,23 @@
 #include <vector>
 #include <limits>
 #include <type_traits>
+#include <cstring>
 
 namespace arithmetic::arbitrary{
 
 class BigNum{
 	typedef uintptr_t T;
-	std::vector<T> data;
+	//Enough for a product of two 256-bit numbers, plus a carry, so that the
+	//elliptic curve code never touches the heap. Define
+	//CRYPTO_ALGORITHMS_BIGNUM_POOL to have bigger numbers reuse freed blocks
+	//instead of going to the heap every time.
+	static const size_t inline_limbs = 640 / (sizeof(T) * 8);
+#ifdef CRYPTO_ALGORITHMS_BIGNUM_POOL
+	typedef utility::SmallVector<T, inline_limbs, utility::PoolAllocator<T>> limbs_t;
+#else
+	typedef utility::SmallVector<T, inline_limbs> limbs_t;
+#endif
+	limbs_t data;
 	T div_aux;
 	unsigned div_shift_amount;
 	static const T max = std::numeric_limits<T>::max();
@@ -74,9 +87,7 @@ public:
 	template <typename T2>
 	BigNum(T2 value, typename std::enable_if<std::is_integral<T2>::value, T2>::type * = nullptr): data(1, (T)value), overflow(false){}
 	BigNum(const BigNum &other) : data(other.data), overflow(other.overflow){}
-	BigNum(const BigNum &&other) : overflow(other.overflow){
-		this->data = std::move(other.data);
-	}
+	BigNum(BigNum &&other) noexcept : data(std::move(other.data)), overflow(other.overflow){}
 	BigNum(const char *value);
 	template <typename Randomness>
 	BigNum(Randomness &source, BigNum max, const BigNum &min = 0){
@@ -109,32 +120,22 @@ public:
 	static BigNum from_hex_string(const char *string, size_t n = 0){
 		if (!n)
 			n = strlen(string);
-		BigNum ret;
-		for (size_t i = 0; i < n; i++){
-			T digit = 0;
-			auto c = string[i];
-			if (c >= '0' && c <= '9')
-				digit = c - '0';
-			else if (c >= 'A' && c <= 'F')
-				digit = c - 'A' + 10;
-			else if (c >= 'a' && c <= 'f')
-				digit = c - 'a' + 10;
-			else
-				continue;
-
-			ret <<= 4;
-			ret.data.front() |= digit;
-		}
-		return ret;
+		auto buffer = utility::hex_number_to_bytes(string, n);
+		return BigNum(buffer.data(), buffer.size());
 	}
 	void all_bits_on();
 	const BigNum &operator=(const BigNum &other);
-	const BigNum &operator=(const BigNum &&other);
+	const BigNum &operator=(BigNum &&other) noexcept;
 	const BigNum &operator+=(const BigNum &other);
 	const BigNum &operator-=(const BigNum &other);
 	const BigNum &operator<<=(T shift);
 	const BigNum &operator>>=(T shift);
 	BigNum operator*(const BigNum &other) const;
+	//*this += a * b, accumulating the partial products in place.
+	void mul_add(const BigNum &a, const BigNum &b);
+	//*this -= a * b, in place. Like operator-=(), sets the overflow flag and
+	//wraps around if the result would be negative.
+	void sub_mul(const BigNum &a, const BigNum &b);
 	bool even() const{
 		return this->data.front() % 2 == 0;
 	}
@@ -147,26 +148,52 @@ public:
 	std::pair<BigNum, BigNum> div(const BigNum &other) const;
 	BigNum operator/(const BigNum &other) const;
 	BigNum operator%(const BigNum &other) const;
-	BigNum operator+(const BigNum &other) const{
+	//The overloads on temporaries reuse them for the result, so that chains
+	//like a + b + c only make one copy.
+	BigNum operator+(const BigNum &other) const &{
 		auto ret = *this;
 		ret += other;
 		return ret;
 	}
-	BigNum operator-(const BigNum &other) const{
+	BigNum operator+(const BigNum &other) &&{
+		*this += other;
+		return std::move(*this);
+	}
+	BigNum operator+(BigNum &&other) const &{
+		other += *this;
+		return std::move(other);
+	}
+	BigNum operator+(BigNum &&other) &&{
+		*this += other;
+		return std::move(*this);
+	}
+	BigNum operator-(const BigNum &other) const &{
 		auto ret = *this;
 		ret -= other;
 		return ret;
 	}
-	BigNum operator<<(T other) const{
+	BigNum operator-(const BigNum &other) &&{
+		*this -= other;
+		return std::move(*this);
+	}
+	BigNum operator<<(T other) const &{
 		auto ret = *this;
 		ret <<= other;
 		return ret;
 	}
-	BigNum operator>>(T other) const{
+	BigNum operator<<(T other) &&{
+		*this <<= other;
+		return std::move(*this);
+	}
+	BigNum operator>>(T other) const &{
 		auto ret = *this;
 		ret >>= other;
 		return ret;
 	}
+	BigNum operator>>(T other) &&{
+		*this >>= other;
+		return std::move(*this);
+	}
 	const BigNum &operator*=(const BigNum &other){
 		*this = *this * other;
 		return *this;
@@ -268,6 +295,19 @@ public:
 	}
 
 	BigNum gcd(BigNum b) const;
+	//Inverse modulo an odd modulus, with the binary extended GCD. Takes time
+	//that depends on the values, so only use it on public data. Throws if
+	//there is no inverse.
+	BigNum mod_inverse(const BigNum &modulus) const;
+	//Inverse modulo an odd modulus of at most 256 bits, with Bernstein and
+	//Yang's divsteps. The divstep loop runs the same steps whatever the
+	//value, but the BigNums going in and out still reveal their lengths. The
+	//modulus should be prime; multiples of it map to 0.
+	BigNum mod_inverse_ct(const BigNum &modulus) const{
+		return this->mod_inverse_ct(modulus, false);
+	}
+	//The same, but inverts -x if negate is set, without branching on it.
+	BigNum mod_inverse_ct(const BigNum &modulus, bool negate) const;
 	std::vector<std::uint8_t> to_buffer() const;
 	size_t all_bits() const{
 		return this->data.size() * this->bits;
@@ -304,12 +344,20 @@ std::ostream &operator<<(std::ostream &stream, const BigNum &n);
 class SignedBigNum{
 	BigNum bignum;
 	bool sign;
-	SignedBigNum sum(const SignedBigNum &other, bool flip_right_sign) const;
+	void accumulate(const SignedBigNum &other, bool flip_right_sign);
+	void normalize(){
+		if (!this->bignum)
+			this->sign = false;
+	}
 public:
 	SignedBigNum(): sign(false){}
-	SignedBigNum(int value) : bignum(value), sign(value < 0){}
+	SignedBigNum(int value) : bignum(value < 0 ? 0 - (std::uint64_t)value : (std::uint64_t)value), sign(value < 0){}
 	SignedBigNum(const BigNum &b): bignum(b), sign(false){}
-	SignedBigNum(BigNum &&b): bignum(std::move(b)), sign(false){}
+	SignedBigNum(BigNum &&b) noexcept: bignum(std::move(b)), sign(false){}
+	SignedBigNum(const SignedBigNum &) = default;
+	SignedBigNum(SignedBigNum &&) noexcept = default;
+	SignedBigNum &operator=(const SignedBigNum &) = default;
+	SignedBigNum &operator=(SignedBigNum &&) noexcept = default;
 	bool positive() const{
 		return !this->sign;
 	}
@@ -325,11 +373,15 @@ public:
 	void invert_sign(){
 		this->sign = !this->sign;
 	}
-	SignedBigNum operator-() const{
+	SignedBigNum operator-() const &{
 		auto ret = *this;
 		ret.invert_sign();
 		return ret;
 	}
+	SignedBigNum operator-() &&{
+		this->invert_sign();
+		return std::move(*this);
+	}
 	const BigNum &abs() const{
 		return this->bignum;
 	}
@@ -377,8 +429,35 @@ public:
 	bool operator>=(const SignedBigNum &other) const{
 		return !(*this < other);
 	}
-	SignedBigNum operator+(const SignedBigNum &other) const;
-	SignedBigNum operator-(const SignedBigNum &other) const;
+	SignedBigNum operator+(const SignedBigNum &other) const &{
+		auto ret = *this;
+		ret += other;
+		return ret;
+	}
+	SignedBigNum operator+(const SignedBigNum &other) &&{
+		*this += other;
+		return std::move(*this);
+	}
+	SignedBigNum operator+(SignedBigNum &&other) const &{
+		other += *this;
+		return std::move(other);
+	}
+	SignedBigNum operator+(SignedBigNum &&other) &&{
+		*this += other;
+		return std::move(*this);
+	}
+	SignedBigNum operator-(const SignedBigNum &other) const &{
+		auto ret = *this;
+		ret -= other;
+		return ret;
+	}
+	SignedBigNum operator-(const SignedBigNum &other) &&{
+		*this -= other;
+		return std::move(*this);
+	}
+	//*this += a * b and *this -= a * b, in place.
+	void mul_add(const SignedBigNum &a, const SignedBigNum &b);
+	void sub_mul(const SignedBigNum &a, const SignedBigNum &b);
 	const SignedBigNum &operator*=(const SignedBigNum &other){
 		this->bignum *= other.bignum;
 		this->sign ^= other.sign;
@@ -404,16 +483,22 @@ public:
 		return ret;
 	}
 	const SignedBigNum &operator+=(const SignedBigNum &other){
-		return *this = *this + other;
+		this->accumulate(other, false);
+		return *this;
 	}
 	const SignedBigNum &operator-=(const SignedBigNum &other){
-		return *this = *this - other;
+		this->accumulate(other, true);
+		return *this;
 	}
-	SignedBigNum operator*(const SignedBigNum &other) const{
+	SignedBigNum operator*(const SignedBigNum &other) const &{
 		auto ret = *this;
 		ret *= other;
 		return ret;
 	}
+	SignedBigNum operator*(const SignedBigNum &other) &&{
+		*this *= other;
+		return std::move(*this);
+	}
 	SignedBigNum operator/(const SignedBigNum &other) const{
 		auto ret = *this;
 		ret /= other;
@@ -459,6 +544,13 @@ public:
 		return ret;
 	}
 	SignedBigNum extended_euclidean(const SignedBigNum &) const;
+	//See BigNum::mod_inverse() and BigNum::mod_inverse_ct().
+	BigNum mod_inverse(const SignedBigNum &modulus) const{
+		return this->euclidean_modulo(modulus).mod_inverse(modulus.bignum);
+	}
+	BigNum mod_inverse_ct(const SignedBigNum &modulus) const{
+		return this->bignum.mod_inverse_ct(modulus.bignum, this->sign);
+	}
 	BigNum euclidean_modulo(const SignedBigNum &other) const;
 	SignedBigNum pow(const SignedBigNum &exponent) const;
 	BigNum mod_pow(const SignedBigNum &exponent, const SignedBigNum &modulo) const;
@@ -468,4 +560,36 @@ std::ostream &operator<<(std::ostream &stream, const SignedBigNum &n);
 
 bool tonelli_shanks(SignedBigNum &first_solution, SignedBigNum &second_solution, const SignedBigNum &a, const SignedBigNum &n);
 
+//Arithmetic on residues in [0, modulus). Every operation leaves its result
+//fully reduced, using Barrett reduction rather than division, so
+//intermediates never grow past twice the width of the modulus. dst may be
+//the same object as any of the operands.
+class ModContext{
+	BigNum modulus;
+	//floor(2^(2 * bits) / modulus)
+	BigNum mu;
+	size_t bits;
+	bool constant_time_inverse;
+public:
+	ModContext(const BigNum &modulus);
+	const BigNum &get_modulus() const{
+		return this->modulus;
+	}
+	//Reduces any non-negative x in place.
+	void reduce(BigNum &x) const;
+	//Maps any integer to its residue.
+	BigNum residue(const SignedBigNum &x) const;
+	void add_mod(BigNum &dst, const BigNum &a, const BigNum &b) const;
+	void sub_mod(BigNum &dst, const BigNum &a, const BigNum &b) const;
+	void neg_mod(BigNum &dst, const BigNum &a) const;
+	void mul_mod(BigNum &dst, const BigNum &a, const BigNum &b) const;
+	void sqr_mod(BigNum &dst, const BigNum &a) const{
+		this->mul_mod(dst, a, a);
+	}
+	//Uses mod_inverse_ct() for odd moduli of up to 256 bits. Throws if a is 0.
+	void inv_mod(BigNum &dst, const BigNum &a) const;
+	//Faster, but only for public data. Throws if a has no inverse.
+	void inv_mod_vartime(BigNum &dst, const BigNum &a) const;
+};
+
 }
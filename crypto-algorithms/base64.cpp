@@ -1,198 +1,338 @@
 #include "base64.hpp"
+#include "cpu.hpp"
 #include <cassert>
 #include <stdexcept>
+#ifdef CRYPTO_ALGORITHMS_X86
+#include <immintrin.h>
+#endif
 
-static const char * const base64_alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+namespace{
 
-namespace utility{
+using utility::Base64Alphabet;
+using utility::detail::base64::Tables;
 
-void Base64Stream::process_all(){
-	const auto ibs = this->input_block_size();
-	const auto obs = this->output_block_size();
-	char iblock[4];
-	char oblock[4];
-	while (this->input_buffer.get_length() >= ibs && this->output_buffer.free() >= obs){
-		this->input_buffer.read(iblock, ibs);
-		auto output_size = this->process(oblock, iblock, ibs);
-		this->output_buffer.write(oblock, output_size);
+//Returns false if the group contains padding or an invalid character, in
+//which case nothing is written.
+template <Base64Alphabet Alphabet>
+bool decode_group(std::uint8_t *dst, const std::uint8_t *src){
+	auto &reverse_alphabet = Tables<Alphabet>::reverse_alphabet;
+	int a = reverse_alphabet[src[0]];
+	int b = reverse_alphabet[src[1]];
+	int c = reverse_alphabet[src[2]];
+	int d = reverse_alphabet[src[3]];
+	if ((a | b | c | d) < 0)
+		return false;
+	dst[0] = (std::uint8_t)(a << 2 | b >> 4);
+	dst[1] = (std::uint8_t)(b << 4 | c >> 2);
+	dst[2] = (std::uint8_t)(c << 6 | d);
+	return true;
+}
+
+#ifdef CRYPTO_ALGORITHMS_X86
+
+//The vector kernels follow Wojciech Mula's and Daniel Lemire's
+//shuffle-based algorithms. Each returns the number of input bytes it
+//consumed, which is always a whole number of groups. They may load a few
+//bytes past the groups they process and store a few bytes past the output
+//they produce, but never beyond src_size and dst_size.
+
+//Lookup tables for the kernels, indexed by nibble.
+//Encoding maps 6-bit values to characters by adding an offset picked by
+//value range. Decoding validates each byte by looking up a bit set by its
+//low nibble and another by its high nibble; the byte is valid only if they
+//don't intersect. It then translates it by adding an offset picked by its
+//high nibble, except for one character that shares its high nibble with
+//others that need a different offset, whose index is adjusted.
+template <Base64Alphabet Alphabet>
+struct VectorTables;
+
+template <>
+struct VectorTables<Base64Alphabet::standard>{
+	static constexpr std::int8_t lut_lo[16] = { 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A };
+	static constexpr std::int8_t lut_hi[16] = { 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 };
+	static constexpr std::int8_t lut_roll[16] = { 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0 };
+	static const char special = '/';
+	static const std::int8_t special_adjustment = -1;
+};
+
+template <>
+struct VectorTables<Base64Alphabet::url_safe>{
+	static constexpr std::int8_t lut_lo[16] = { 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x3B, 0x3B, 0x3A, 0x3B, 0x33 };
+	static constexpr std::int8_t lut_hi[16] = { 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x20, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 };
+	static constexpr std::int8_t lut_roll[16] = { 0, 0, 17, 4, -65, -65, -71, -71, -32, 0, 0, 0, 0, 0, 0, 0 };
+	static const char special = '_';
+	static const std::int8_t special_adjustment = 3;
+};
+
+template <Base64Alphabet Alphabet>
+struct EncodeOffsets{
+	static constexpr std::int8_t value[16] = {
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, Tables<Alphabet>::c62 - 62, Tables<Alphabet>::c63 - 63, 'A', 0, 0
+	};
+};
+
+CRYPTO_ALGORITHMS_TARGET("ssse3")
+inline __m128i load_table(const std::int8_t *table){
+	return _mm_loadu_si128((const __m128i *)table);
+}
+
+CRYPTO_ALGORITHMS_TARGET("avx2")
+inline __m256i load_table256(const std::int8_t *table){
+	return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)table));
+}
+
+template <Base64Alphabet Alphabet>
+CRYPTO_ALGORITHMS_TARGET("ssse3")
+size_t encode_ssse3(std::uint8_t *dst, size_t dst_size, const std::uint8_t *src, size_t src_size){
+	const auto shuffle = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const auto offsets = load_table(EncodeOffsets<Alphabet>::value);
+	size_t ret = 0;
+	for (; src_size >= 16 && dst_size >= 16; src_size -= 12, dst_size -= 16){
+		//Spread 12 bytes into 16 6-bit values, one per byte.
+		auto in = _mm_loadu_si128((const __m128i *)(src + ret));
+		in = _mm_shuffle_epi8(in, shuffle);
+		auto t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+		auto t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+		auto t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+		auto t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+		auto indices = _mm_or_si128(t1, t3);
+		//Map them to the alphabet.
+		auto ranges = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+		auto letters = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+		ranges = _mm_or_si128(ranges, _mm_and_si128(letters, _mm_set1_epi8(13)));
+		auto out = _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, ranges));
+		_mm_storeu_si128((__m128i *)dst, out);
+		dst += 16;
+		ret += 12;
 	}
+	return ret;
 }
 
-size_t Base64Stream::write(const void *vsrc, size_t size){
-	auto src = (const std::uint8_t *)vsrc;
+template <Base64Alphabet Alphabet>
+CRYPTO_ALGORITHMS_TARGET("avx2")
+size_t encode_avx2(std::uint8_t *dst, size_t dst_size, const std::uint8_t *src, size_t src_size){
+	const auto shuffle = _mm256_setr_epi8(
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+	);
+	const auto offsets = load_table256(EncodeOffsets<Alphabet>::value);
 	size_t ret = 0;
-	while (size){
-		this->process_all();
-		auto written = this->input_buffer.write(src, size);
-		if (!written)
-			break;
-		src += written;
-		size -= written;
-		ret += written;
+	for (; src_size >= 28 && dst_size >= 32; src_size -= 24, dst_size -= 32){
+		auto lo = _mm_loadu_si128((const __m128i *)(src + ret));
+		auto hi = _mm_loadu_si128((const __m128i *)(src + ret + 12));
+		auto in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		in = _mm256_shuffle_epi8(in, shuffle);
+		auto t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+		auto t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		auto t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+		auto t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		auto indices = _mm256_or_si256(t1, t3);
+		auto ranges = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+		auto letters = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+		ranges = _mm256_or_si256(ranges, _mm256_and_si256(letters, _mm256_set1_epi8(13)));
+		auto out = _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, ranges));
+		_mm256_storeu_si256((__m256i *)dst, out);
+		dst += 32;
+		ret += 24;
 	}
-	this->process_all();
 	return ret;
 }
 
-size_t Base64Stream::read(void *vdst, size_t size){
-	auto dst = (std::uint8_t *)vdst;
+template <Base64Alphabet Alphabet>
+CRYPTO_ALGORITHMS_TARGET("ssse3")
+size_t decode_ssse3(std::uint8_t *dst, size_t dst_size, const std::uint8_t *src, size_t src_size){
+	typedef VectorTables<Alphabet> T;
+	const auto lut_lo = load_table(T::lut_lo);
+	const auto lut_hi = load_table(T::lut_hi);
+	const auto lut_roll = load_table(T::lut_roll);
+	const auto nibble_mask = _mm_set1_epi8(0x0F);
 	size_t ret = 0;
-	while (size){
-		this->process_all();
-		auto read = this->output_buffer.read(dst, size);
-		if (!read)
+	for (; src_size >= 16 && dst_size >= 16; src_size -= 16, dst_size -= 12){
+		auto in = _mm_loadu_si128((const __m128i *)(src + ret));
+		auto hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), nibble_mask);
+		auto lo_nibbles = _mm_and_si128(in, nibble_mask);
+		auto lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+		auto hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xFFFF)
 			break;
-		dst += read;
-		size -= read;
-		ret += read;
+		auto special = _mm_and_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8(T::special)), _mm_set1_epi8(T::special_adjustment));
+		auto roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(special, hi_nibbles));
+		auto values = _mm_add_epi8(in, roll);
+		//Pack 16 6-bit values into 12 bytes.
+		auto merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+		auto out = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+		out = _mm_shuffle_epi8(out, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+		_mm_storeu_si128((__m128i *)dst, out);
+		dst += 12;
+		ret += 16;
 	}
-	this->process_all();
 	return ret;
 }
 
-size_t Base64Encoder::process(void *vdst, const void *vsrc, size_t src_size){
-	auto src = (const std::uint8_t *)vsrc;
-	auto dst = (std::uint8_t *)vdst;
-	switch (src_size){
-		case 1:
-			dst[0] = base64_alphabet[(src[0] >> 2) & 0b0011'1111];
-			dst[1] = base64_alphabet[(src[0] << 4) & 0b0011'0000];
-			dst[3] = dst[2] = '=';
-			break;
-		case 2:
-			dst[0] = base64_alphabet[(src[0] >> 2) & 0b0011'1111];
-			dst[1] = base64_alphabet[
-					(src[0] << 4) & 0b0011'0000 |
-					(src[1] >> 4) & 0b0000'1111
-			];
-			dst[2] = base64_alphabet[(src[1] << 2) & 0b0011'1100];
-			dst[3] = '=';
-			break;
-		case 3:
-			dst[0] = base64_alphabet[(src[0] >> 2) & 0b0011'1111];
-			dst[1] = base64_alphabet[
-					(src[0] << 4) & 0b0011'0000 |
-					(src[1] >> 4) & 0b0000'1111
-			];
-			dst[2] = base64_alphabet[
-				(src[1] << 2) & 0b0011'1100 |
-				(src[2] >> 6) & 0b0000'0011
-			];
-			dst[3] = base64_alphabet[src[2] & 0b0011'1111];
+template <Base64Alphabet Alphabet>
+CRYPTO_ALGORITHMS_TARGET("avx2")
+size_t decode_avx2(std::uint8_t *dst, size_t dst_size, const std::uint8_t *src, size_t src_size){
+	typedef VectorTables<Alphabet> T;
+	const auto lut_lo = load_table256(T::lut_lo);
+	const auto lut_hi = load_table256(T::lut_hi);
+	const auto lut_roll = load_table256(T::lut_roll);
+	const auto pack = _mm256_setr_epi8(
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+	);
+	const auto nibble_mask = _mm256_set1_epi8(0x0F);
+	size_t ret = 0;
+	for (; src_size >= 32 && dst_size >= 32; src_size -= 32, dst_size -= 24){
+		auto in = _mm256_loadu_si256((const __m256i *)(src + ret));
+		auto hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), nibble_mask);
+		auto lo_nibbles = _mm256_and_si256(in, nibble_mask);
+		auto lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+		auto hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+		if (!_mm256_testz_si256(lo, hi))
 			break;
-		default:
-			assert(false);
+		auto special = _mm256_and_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8(T::special)), _mm256_set1_epi8(T::special_adjustment));
+		auto roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(special, hi_nibbles));
+		auto values = _mm256_add_epi8(in, roll);
+		auto merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+		auto out = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+		out = _mm256_shuffle_epi8(out, pack);
+		out = _mm256_permutevar8x32_epi32(out, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+		_mm256_storeu_si256((__m256i *)dst, out);
+		dst += 24;
+		ret += 32;
 	}
-	return 4;
+	return ret;
 }
 
-void Base64Encoder::terminate(){
-	this->process_all();
-	auto n = this->input_buffer.get_length();
-	if (!n || this->output_buffer.free() < 4)
-		return;
-	char iblock[3];
-	char oblock[4];
-	this->input_buffer.read(iblock, n);
-	this->process(oblock, iblock, n);
-	this->output_buffer.write(oblock, 4);
+#endif
+
 }
 
-Base64Decoder::Base64Decoder(){
-	std::fill(this->reverse_alphabet, this->reverse_alphabet + 256, (signed char)-1);
-	size_t i = 0;
-	for (auto p = base64_alphabet; *p; p++, i++)
-		this->reverse_alphabet[*p] = (signed char)i;
+namespace utility{
+
+namespace detail{
+
+namespace base64{
+
+template <Base64Alphabet Alphabet>
+size_t encode_bulk(std::uint8_t *dst, size_t dst_size, const std::uint8_t *src, size_t src_size){
+	size_t ret = 0;
+	size_t written = 0;
+#ifdef CRYPTO_ALGORITHMS_X86
+	auto &features = cpu::features();
+	if (features.avx2){
+		ret += encode_avx2<Alphabet>(dst, dst_size, src, src_size);
+		written = ret / 3 * 4;
+	}
+	if (features.ssse3){
+		ret += encode_ssse3<Alphabet>(dst + written, dst_size - written, src + ret, src_size - ret);
+		written = ret / 3 * 4;
+	}
+#endif
+	for (; src_size - ret >= 3 && dst_size - written >= 4; ret += 3, written += 4)
+		encode_group<Base64Variant<Alphabet>>(dst + written, src + ret, 3);
+	return ret;
 }
 
-size_t Base64Decoder::process(void *vdst, const void *vsrc, size_t src_size){
-	auto src = (const std::uint8_t *)vsrc;
-	auto dst = (std::uint8_t *)vdst;
-	std::uint8_t temp[4];
+template <Base64Alphabet Alphabet>
+size_t decode_bulk(std::uint8_t *dst, size_t dst_size, const std::uint8_t *src, size_t src_size){
 	size_t ret = 0;
-	for (size_t i = 0; i < 4; i++){
-		if (ret){
-			temp[i] = 0;
-			continue;
-		}
-		if (src[i] == '='){
-			if (i < 2)
-				throw std::runtime_error("invalid base64 input: invalid padding");
-			ret = i - 1;
-			temp[i] = 0;
-			continue;
-		}
-		auto x = this->reverse_alphabet[src[i]];
-		if (x == -1)
-			throw std::runtime_error((std::string)"invalid base64 character: " + (char)src[i]);
-		temp[i] = x;
+	size_t written = 0;
+#ifdef CRYPTO_ALGORITHMS_X86
+	auto &features = cpu::features();
+	if (features.avx2){
+		ret += decode_avx2<Alphabet>(dst, dst_size, src, src_size);
+		written = ret / 4 * 3;
+	}
+	if (features.ssse3){
+		ret += decode_ssse3<Alphabet>(dst + written, dst_size - written, src + ret, src_size - ret);
+		written = ret / 4 * 3;
 	}
-	dst[0] = (temp[0] << 2) | (temp[1] >> 4) & 0b0000'0011;
-	dst[1] = (temp[1] << 4) | (temp[2] >> 2) & 0b0000'1111;
-	dst[2] = (temp[2] << 6) | temp[3];
-	return ret ? ret : 3;
+#endif
+	for (; src_size - ret >= 4 && dst_size - written >= 3; ret += 4, written += 3)
+		if (!decode_group<Alphabet>(dst + written, src + ret))
+			break;
+	return ret;
+}
+
+template size_t encode_bulk<Base64Alphabet::standard>(std::uint8_t *, size_t, const std::uint8_t *, size_t);
+template size_t encode_bulk<Base64Alphabet::url_safe>(std::uint8_t *, size_t, const std::uint8_t *, size_t);
+template size_t decode_bulk<Base64Alphabet::standard>(std::uint8_t *, size_t, const std::uint8_t *, size_t);
+template size_t decode_bulk<Base64Alphabet::url_safe>(std::uint8_t *, size_t, const std::uint8_t *, size_t);
+
 }
 
-void Base64Decoder::terminate(){
-	this->process_all();
-	if (this->input_buffer.get_length())
-		throw std::runtime_error("invalid base64 input: invalid length; should be a multiple of 4");
 }
 
-template <typename T>
-static void flush(T &ret, Base64Stream &encoder){
-	while (auto available = encoder.available().value()){
-		auto m = ret.size();
-		ret.resize(m + available);
-		encoder.read(ret.data() + m, available);
+void Base64Stream::process_all(){
+	const auto ibs = this->input_block_size();
+	const auto obs = this->output_block_size();
+	while (true){
+		//Process as many whole groups as possible straight from the input
+		//buffer into the output buffer.
+		auto input = this->input_buffer.peek_readable()[0];
+		auto output = this->output_buffer.prepare_writable()[0];
+		auto groups = std::min(input.size / ibs, output.size / obs);
+		if (groups){
+			//Let the bulk path take as much as it can, and fall back to one
+			//group at a time wherever it stops.
+			size_t i = 0;
+			size_t written = 0;
+			while (i < groups){
+				size_t bulk_written;
+				i += this->process_bulk(output.data + written, output.size - written, input.data + i * ibs, (groups - i) * ibs, bulk_written) / ibs;
+				written += bulk_written;
+				if (i < groups){
+					written += this->process(output.data + written, input.data + i * ibs, ibs);
+					i++;
+				}
+			}
+			this->input_buffer.consume(groups * ibs);
+			this->output_buffer.commit(written);
+			continue;
+		}
+
+		//The next group straddles the end of one of the buffers.
+		if (this->input_buffer.get_length() < ibs || this->output_buffer.free() < obs)
+			break;
+		char iblock[4];
+		char oblock[8];
+		this->input_buffer.read(iblock, ibs);
+		auto output_size = this->process(oblock, iblock, ibs);
+		this->output_buffer.write(oblock, output_size);
 	}
 }
 
-std::string Base64Encoder::encode(const void *vsrc, size_t size){
+size_t Base64Stream::write(const void *vsrc, size_t size){
 	auto src = (const std::uint8_t *)vsrc;
-	Base64Encoder encoder;
-	
-	std::string ret;
-	auto predicted_size = (size * 4) / 3;
-	predicted_size += (4 - predicted_size) % 4;
-	ret.reserve(predicted_size);
-	
+	size_t ret = 0;
 	while (size){
-		auto written = encoder.write(src, size);
-		if (!written){
-			::utility::flush(ret, encoder);
-			continue;
-		}
+		this->process_all();
+		auto written = this->input_buffer.write(src, size);
+		if (!written)
+			break;
 		src += written;
 		size -= written;
+		ret += written;
 	}
-	::utility::flush(ret, encoder);
-	encoder.terminate();
-	::utility::flush(ret, encoder);
+	this->process_all();
 	return ret;
 }
 
-std::vector<std::uint8_t> Base64Decoder::decode(const std::string &input){
-	auto src = (const std::uint8_t *)input.data();
-	size_t size = input.size();
-	Base64Decoder decoder;
-
-	std::vector<std::uint8_t> ret;
-	//A little extra just in case.
-	ret.reserve(size * 3 / 4 + 8);
-
+size_t Base64Stream::read(void *vdst, size_t size){
+	auto dst = (std::uint8_t *)vdst;
+	size_t ret = 0;
 	while (size){
-		auto written = decoder.write(src, size);
-		if (!written){
-			::utility::flush(ret, decoder);
-			continue;
-		}
-		src += written;
-		size -= written;
+		this->process_all();
+		auto read = this->output_buffer.read(dst, size);
+		if (!read)
+			break;
+		dst += read;
+		size -= read;
+		ret += read;
 	}
-	::utility::flush(ret, decoder);
-	decoder.terminate();
-	::utility::flush(ret, decoder);
+	this->process_all();
 	return ret;
 }
 
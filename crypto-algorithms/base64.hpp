@@ -2,20 +2,243 @@
 
 #include "source_sink.hpp"
 #include "ringbuffer.hpp"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace utility{
 
+enum class Base64Alphabet{
+	//A-Z, a-z, 0-9, '+' and '/' (RFC 4648, section 4).
+	standard,
+	//A-Z, a-z, 0-9, '-' and '_' (RFC 4648, section 5), safe in URLs and file
+	//names.
+	url_safe,
+};
+
+//Compile-time description of a flavor of base64.
+//Without padding, the last group is shortened to 2 or 3 characters instead of
+//being filled out with '='.
+//LineLength is the number of characters after which the encoder starts a new
+//line with a CRLF, or 0 to never break lines. Decoders of variants with line
+//breaks ignore CR and LF anywhere in their input.
+template <Base64Alphabet Alphabet, bool Padding = true, size_t LineLength = 0>
+struct Base64Variant{
+	static_assert(LineLength % 4 == 0, "the line length must be a whole number of groups");
+	static const Base64Alphabet alphabet = Alphabet;
+	static const bool padding = Padding;
+	static const size_t line_length = LineLength;
+};
+
+typedef Base64Variant<Base64Alphabet::standard> Base64Standard;
+typedef Base64Variant<Base64Alphabet::standard, false> Base64Unpadded;
+typedef Base64Variant<Base64Alphabet::url_safe> Base64Url;
+typedef Base64Variant<Base64Alphabet::url_safe, false> Base64UrlUnpadded;
+//RFC 2045.
+typedef Base64Variant<Base64Alphabet::standard, true, 76> Base64Mime;
+
+namespace detail{
+
+namespace base64{
+
+constexpr std::array<char, 64> make_alphabet(char c62, char c63){
+	std::array<char, 64> ret{};
+	for (int i = 0; i < 26; i++){
+		ret[i] = (char)('A' + i);
+		ret[i + 26] = (char)('a' + i);
+	}
+	for (int i = 0; i < 10; i++)
+		ret[i + 52] = (char)('0' + i);
+	ret[62] = c62;
+	ret[63] = c63;
+	return ret;
+}
+
+constexpr std::array<signed char, 256> make_reverse_alphabet(const std::array<char, 64> &alphabet){
+	std::array<signed char, 256> ret{};
+	for (auto &x : ret)
+		x = -1;
+	for (int i = 0; i < 64; i++)
+		ret[(std::uint8_t)alphabet[i]] = (signed char)i;
+	return ret;
+}
+
+template <Base64Alphabet Alphabet>
+struct Tables{
+	static constexpr char c62 = Alphabet == Base64Alphabet::standard ? '+' : '-';
+	static constexpr char c63 = Alphabet == Base64Alphabet::standard ? '/' : '_';
+	static constexpr std::array<char, 64> alphabet = make_alphabet(c62, c63);
+	static constexpr std::array<signed char, 256> reverse_alphabet = make_reverse_alphabet(alphabet);
+};
+
+//Bulk kernels, defined in base64.cpp for every alphabet. They use the widest
+//vector instructions available, process whole groups only, and return the
+//number of input bytes consumed. decode_bulk() stops at the first group that
+//contains padding or an invalid character. Both may store past the end of
+//their output, but never beyond dst_size.
+template <Base64Alphabet Alphabet>
+size_t encode_bulk(std::uint8_t *dst, size_t dst_size, const std::uint8_t *src, size_t src_size);
+template <Base64Alphabet Alphabet>
+size_t decode_bulk(std::uint8_t *dst, size_t dst_size, const std::uint8_t *src, size_t src_size);
+
+//Encodes a group of 1 to 3 bytes. Returns the number of characters written.
+template <typename Variant>
+size_t encode_group(std::uint8_t *dst, const std::uint8_t *src, size_t src_size){
+	auto &alphabet = Tables<Variant::alphabet>::alphabet;
+	dst[0] = alphabet[(src[0] >> 2) & 0b0011'1111];
+	switch (src_size){
+		case 1:
+			dst[1] = alphabet[(src[0] << 4) & 0b0011'0000];
+			if (!Variant::padding)
+				return 2;
+			dst[3] = dst[2] = '=';
+			break;
+		case 2:
+			dst[1] = alphabet[
+					((src[0] << 4) & 0b0011'0000) |
+					((src[1] >> 4) & 0b0000'1111)
+			];
+			dst[2] = alphabet[(src[1] << 2) & 0b0011'1100];
+			if (!Variant::padding)
+				return 3;
+			dst[3] = '=';
+			break;
+		default:
+			dst[1] = alphabet[
+					((src[0] << 4) & 0b0011'0000) |
+					((src[1] >> 4) & 0b0000'1111)
+			];
+			dst[2] = alphabet[
+				((src[1] << 2) & 0b0011'1100) |
+				((src[2] >> 6) & 0b0000'0011)
+			];
+			dst[3] = alphabet[src[2] & 0b0011'1111];
+			break;
+	}
+	return 4;
+}
+
+//Encodes a group of 1 to 3 bytes, starting a new line first if the current
+//one is full. Needs room for 6 characters. column is the number of characters
+//on the current line. Returns the number of characters written.
+template <typename Variant>
+size_t encode_final_group(std::uint8_t *dst, const std::uint8_t *src, size_t src_size, size_t &column){
+	size_t ret = 0;
+	if (Variant::line_length && column == Variant::line_length){
+		dst[ret++] = '\r';
+		dst[ret++] = '\n';
+		column = 0;
+	}
+	auto n = encode_group<Variant>(dst + ret, src, src_size);
+	column += n;
+	return ret + n;
+}
+
+//Encodes as many whole groups as fit, breaking lines as needed. Returns the
+//number of input bytes consumed, and the number of characters written through
+//written.
+template <typename Variant>
+size_t encode_run(std::uint8_t *dst, size_t dst_size, const std::uint8_t *src, size_t src_size, size_t &column, size_t &written){
+	const auto alphabet = Variant::alphabet;
+	if (!Variant::line_length){
+		auto ret = encode_bulk<alphabet>(dst, dst_size, src, src_size);
+		written = ret / 3 * 4;
+		return ret;
+	}
+	size_t ret = 0;
+	written = 0;
+	while (src_size - ret >= 3){
+		if (column == Variant::line_length){
+			if (dst_size - written < 6)
+				break;
+			dst[written++] = '\r';
+			dst[written++] = '\n';
+			column = 0;
+		}
+		auto groups = std::min((Variant::line_length - column) / 4, (src_size - ret) / 3);
+		auto consumed = encode_bulk<alphabet>(dst + written, dst_size - written, src + ret, groups * 3);
+		ret += consumed;
+		written += consumed / 3 * 4;
+		column += consumed / 3 * 4;
+		if (consumed < groups * 3)
+			break;
+	}
+	return ret;
+}
+
+//Decodes a group that may contain padding, throwing if it's invalid. Always
+//writes 3 bytes, and returns how many of them are meaningful.
+template <typename Variant>
+size_t decode_final_group(std::uint8_t *dst, const std::uint8_t *src){
+	auto &reverse_alphabet = Tables<Variant::alphabet>::reverse_alphabet;
+	std::uint8_t temp[4];
+	size_t ret = 0;
+	for (size_t i = 0; i < 4; i++){
+		if (ret){
+			temp[i] = 0;
+			continue;
+		}
+		if (src[i] == '='){
+			if (i < 2)
+				throw std::runtime_error("invalid base64 input: invalid padding");
+			ret = i - 1;
+			temp[i] = 0;
+			continue;
+		}
+		auto x = reverse_alphabet[src[i]];
+		if (x == -1)
+			throw std::runtime_error((std::string)"invalid base64 character: " + (char)src[i]);
+		temp[i] = x;
+	}
+	dst[0] = (temp[0] << 2) | ((temp[1] >> 4) & 0b0000'0011);
+	dst[1] = (temp[1] << 4) | ((temp[2] >> 2) & 0b0000'1111);
+	dst[2] = (temp[2] << 6) | temp[3];
+	return ret ? ret : 3;
+}
+
+//Decodes the 2 or 3 characters of a shortened last group. Always writes 3
+//bytes, and returns how many of them are meaningful.
+template <typename Variant>
+size_t decode_unpadded_group(std::uint8_t *dst, const std::uint8_t *src, size_t src_size){
+	if (src_size < 2)
+		throw std::runtime_error("invalid base64 input: invalid length");
+	std::uint8_t group[4] = { '=', '=', '=', '=' };
+	memcpy(group, src, src_size);
+	return decode_final_group<Variant>(dst, group);
+}
+
+inline bool is_line_break(std::uint8_t c){
+	return c == '\r' || c == '\n';
+}
+
+}
+
+}
+
 class Base64Stream : public utility::DataSource, public utility::DataSink{
 protected:
 	utility::RingBuffer input_buffer;
 	utility::RingBuffer output_buffer;
-	
+
 	void process_all();
 	virtual size_t input_block_size() = 0;
+	//The most output a single group can produce.
 	virtual size_t output_block_size() = 0;
 	virtual size_t process(void *, const void *, size_t) = 0;
+	//Processes a run of whole groups, stopping early at any group that needs
+	//special handling, which is then passed to process(). Returns the number
+	//of input bytes consumed, and the size of the output through the last
+	//parameter. dst_size may be larger than the output, to give vectorized
+	//implementations room for wide stores.
+	virtual size_t process_bulk(std::uint8_t *, size_t, const std::uint8_t *, size_t, size_t &written){
+		written = 0;
+		return 0;
+	}
 public:
-	Base64Stream(): input_buffer(4 << 10), output_buffer(4 << 10){}
+	Base64Stream(): input_buffer(64 << 10), output_buffer(64 << 10){}
 	virtual ~Base64Stream(){}
 	Base64Stream(const Base64Stream &) = delete;
 	Base64Stream &operator=(const Base64Stream &) = delete;
@@ -29,21 +252,39 @@ public:
 	}
 };
 
-class Base64Encoder : public Base64Stream{
+template <typename Variant>
+class BasicBase64Encoder : public Base64Stream{
+	size_t column = 0;
+
 	size_t input_block_size() override{
 		return 3;
 	}
 	size_t output_block_size() override{
-		return 4;
+		return Variant::line_length ? 6 : 4;
+	}
+	size_t process(void *dst, const void *src, size_t src_size) override{
+		return detail::base64::encode_final_group<Variant>((std::uint8_t *)dst, (const std::uint8_t *)src, src_size, this->column);
+	}
+	size_t process_bulk(std::uint8_t *dst, size_t dst_size, const std::uint8_t *src, size_t src_size, size_t &written) override{
+		return detail::base64::encode_run<Variant>(dst, dst_size, src, src_size, this->column, written);
 	}
-	size_t process(void *, const void *, size_t) override;
 public:
-	Base64Encoder() = default;
-	Base64Encoder(const Base64Encoder &) = delete;
-	Base64Encoder &operator=(const Base64Encoder &) = delete;
-	Base64Encoder(Base64Encoder &&other) = delete;
-	Base64Encoder &operator=(Base64Encoder &&other) = delete;
-	void terminate() override;
+	BasicBase64Encoder() = default;
+	BasicBase64Encoder(const BasicBase64Encoder &) = delete;
+	BasicBase64Encoder &operator=(const BasicBase64Encoder &) = delete;
+	BasicBase64Encoder(BasicBase64Encoder &&other) = delete;
+	BasicBase64Encoder &operator=(BasicBase64Encoder &&other) = delete;
+	void terminate() override{
+		this->process_all();
+		auto n = this->input_buffer.get_length();
+		if (!n || this->output_buffer.free() < 6)
+			return;
+		std::uint8_t iblock[3];
+		std::uint8_t oblock[6];
+		this->input_buffer.read(iblock, n);
+		auto m = this->process(oblock, iblock, n);
+		this->output_buffer.write(oblock, m);
+	}
 	//convenience functions:
 	static std::string encode(const void *, size_t);
 	static std::string encode(const std::vector<std::uint8_t> &data){
@@ -51,24 +292,134 @@ public:
 	}
 };
 
-class Base64Decoder : public Base64Stream{
-	signed char reverse_alphabet[256];
+template <typename Variant>
+std::string BasicBase64Encoder<Variant>::encode(const void *vsrc, size_t size){
+	auto src = (const std::uint8_t *)vsrc;
+	auto whole = size / 3 * 3;
+	auto tail = size - whole;
+	auto characters = whole / 3 * 4 + (!tail ? 0 : Variant::padding ? 4 : tail + 1);
+	auto output_size = characters;
+	if (Variant::line_length && characters)
+		output_size += (characters - 1) / Variant::line_length * 2;
+
+	//Leave some room for the vector kernels to store past the end.
+	std::string ret(output_size + 32, 0);
+	auto dst = (std::uint8_t *)&ret[0];
+	size_t column = 0;
+	size_t written;
+	auto consumed = detail::base64::encode_run<Variant>(dst, ret.size(), src, whole, column, written);
+	if (tail)
+		written += detail::base64::encode_final_group<Variant>(dst + written, src + consumed, tail, column);
+	ret.resize(written);
+	return ret;
+}
+
+template <typename Variant>
+class BasicBase64Decoder : public Base64Stream{
 	size_t input_block_size() override{
 		return 4;
 	}
 	size_t output_block_size() override{
 		return 3;
 	}
-	size_t process(void *, const void *, size_t) override;
+	size_t process(void *dst, const void *src, size_t) override{
+		return detail::base64::decode_final_group<Variant>((std::uint8_t *)dst, (const std::uint8_t *)src);
+	}
+	size_t process_bulk(std::uint8_t *dst, size_t dst_size, const std::uint8_t *src, size_t src_size, size_t &written) override{
+		auto ret = detail::base64::decode_bulk<Variant::alphabet>(dst, dst_size, src, src_size);
+		written = ret / 4 * 3;
+		return ret;
+	}
 public:
-	Base64Decoder();
-	Base64Decoder(const Base64Decoder &) = delete;
-	Base64Decoder &operator=(const Base64Decoder &) = delete;
-	Base64Decoder(Base64Decoder &&other) = delete;
-	Base64Decoder &operator=(Base64Decoder &&other) = delete;
-	void terminate() override;
+	BasicBase64Decoder() = default;
+	BasicBase64Decoder(const BasicBase64Decoder &) = delete;
+	BasicBase64Decoder &operator=(const BasicBase64Decoder &) = delete;
+	BasicBase64Decoder(BasicBase64Decoder &&other) = delete;
+	BasicBase64Decoder &operator=(BasicBase64Decoder &&other) = delete;
+	size_t write(const void *vsrc, size_t size) override{
+		if (!Variant::line_length)
+			return Base64Stream::write(vsrc, size);
+		//Drop line breaks on the way in.
+		auto src = (const std::uint8_t *)vsrc;
+		size_t ret = 0;
+		while (ret < size){
+			if (detail::base64::is_line_break(src[ret])){
+				ret++;
+				continue;
+			}
+			auto end = ret;
+			while (end < size && !detail::base64::is_line_break(src[end]))
+				end++;
+			auto written = Base64Stream::write(src + ret, end - ret);
+			ret += written;
+			if (ret < end)
+				break;
+		}
+		return ret;
+	}
+	void terminate() override{
+		this->process_all();
+		auto n = this->input_buffer.get_length();
+		if (!n)
+			return;
+		if (Variant::padding || n >= 4)
+			throw std::runtime_error("invalid base64 input: invalid length; should be a multiple of 4");
+		std::uint8_t iblock[4];
+		std::uint8_t oblock[3];
+		this->input_buffer.read(iblock, n);
+		auto m = detail::base64::decode_unpadded_group<Variant>(oblock, iblock, n);
+		this->output_buffer.write(oblock, m);
+	}
 	//convenience function:
 	static std::vector<std::uint8_t> decode(const std::string &);
 };
 
+template <typename Variant>
+std::vector<std::uint8_t> BasicBase64Decoder<Variant>::decode(const std::string &input){
+	auto src = (const std::uint8_t *)input.data();
+	auto size = input.size();
+	std::string stripped;
+	if (Variant::line_length){
+		stripped.reserve(size);
+		for (size_t i = 0; i < size;){
+			auto begin = i;
+			while (i < size && !detail::base64::is_line_break(src[i]))
+				i++;
+			stripped.append(input, begin, i - begin);
+			while (i < size && detail::base64::is_line_break(src[i]))
+				i++;
+		}
+		src = (const std::uint8_t *)stripped.data();
+		size = stripped.size();
+	}
+	auto whole = size / 4 * 4;
+
+	std::vector<std::uint8_t> ret(whole / 4 * 3 + 32);
+	size_t i = 0;
+	size_t written = 0;
+	while (i < whole){
+		auto consumed = detail::base64::decode_bulk<Variant::alphabet>(ret.data() + written, ret.size() - written, src + i, whole - i);
+		i += consumed;
+		written += consumed / 4 * 3;
+		if (i < whole){
+			written += detail::base64::decode_final_group<Variant>(ret.data() + written, src + i);
+			i += 4;
+		}
+	}
+	if (whole != size){
+		if (Variant::padding)
+			throw std::runtime_error("invalid base64 input: invalid length; should be a multiple of 4");
+		written += detail::base64::decode_unpadded_group<Variant>(ret.data() + written, src + whole, size - whole);
+	}
+	ret.resize(written);
+	return ret;
+}
+
+typedef BasicBase64Encoder<Base64Standard> Base64Encoder;
+typedef BasicBase64Decoder<Base64Standard> Base64Decoder;
+typedef BasicBase64Encoder<Base64Url> Base64UrlEncoder;
+typedef BasicBase64Decoder<Base64Url> Base64UrlDecoder;
+typedef BasicBase64Encoder<Base64Mime> Base64MimeEncoder;
+typedef BasicBase64Decoder<Base64Mime> Base64MimeDecoder;
+
 }
@@ -66,10 +66,8 @@ public:
 		if (l != block_size * 2)
 			throw std::runtime_error("invalid hex string");
 		block_t ret;
-		for (auto &b : ret){
-			b = utility::hex2val(*(s++)) << 4;
-			b |= utility::hex2val(*(s++));
-		}
+		if (!utility::hex_decode(ret.data(), s, block_size))
+			throw utility::InvalidHexException();
 		return ret;
 	}
 	static void array_xor(void *void_dst, const void *void_left, const void *void_right, size_t size){
@@ -0,0 +1,323 @@
+#include "chacha20.hpp"
+#include "bit.hpp"
+#include "cpu.hpp"
+#include <random>
+#include <stdexcept>
+#ifdef CRYPTO_ALGORITHMS_X86
+#include <immintrin.h>
+#endif
+
+namespace{
+
+std::uint32_t load32(const std::uint8_t *p){
+	return (std::uint32_t)p[0] | (std::uint32_t)p[1] << 8 | (std::uint32_t)p[2] << 16 | (std::uint32_t)p[3] << 24;
+}
+
+void store32(std::uint8_t *p, std::uint32_t x){
+	p[0] = (std::uint8_t)x;
+	p[1] = (std::uint8_t)(x >> 8);
+	p[2] = (std::uint8_t)(x >> 16);
+	p[3] = (std::uint8_t)(x >> 24);
+}
+
+void set_constants(std::uint32_t (&state)[16]){
+	//"expand 32-byte k"
+	state[0] = 0x61707865;
+	state[1] = 0x3320646e;
+	state[2] = 0x79622d32;
+	state[3] = 0x6b206574;
+}
+
+void quarter_round(std::uint32_t &a, std::uint32_t &b, std::uint32_t &c, std::uint32_t &d){
+	a += b; d ^= a; d = rotate_left_static<16>(d);
+	c += d; b ^= c; b = rotate_left_static<12>(b);
+	a += b; d ^= a; d = rotate_left_static<8>(d);
+	c += d; b ^= c; b = rotate_left_static<7>(b);
+}
+
+void block_scalar(std::uint8_t *dst, const std::uint8_t *src, const std::uint32_t (&state)[16]){
+	std::uint32_t x[16];
+	std::copy(state, state + 16, x);
+	for (int i = 0; i < 10; i++){
+		quarter_round(x[0], x[4], x[ 8], x[12]);
+		quarter_round(x[1], x[5], x[ 9], x[13]);
+		quarter_round(x[2], x[6], x[10], x[14]);
+		quarter_round(x[3], x[7], x[11], x[15]);
+		quarter_round(x[0], x[5], x[10], x[15]);
+		quarter_round(x[1], x[6], x[11], x[12]);
+		quarter_round(x[2], x[7], x[ 8], x[13]);
+		quarter_round(x[3], x[4], x[ 9], x[14]);
+	}
+	for (int i = 0; i < 16; i++){
+		auto k = x[i] + state[i];
+		if (src)
+			k ^= load32(src + i * 4);
+		store32(dst + i * 4, k);
+	}
+}
+
+#ifdef CRYPTO_ALGORITHMS_X86
+
+//The kernels keep word i of every block in lane j of vector x[i], so that
+//each instruction advances all the blocks at once, and then transpose the
+//words back into consecutive blocks for output. They return the number of
+//blocks they processed.
+
+CRYPTO_ALGORITHMS_TARGET("sse2")
+__m128i rotate128(__m128i x, int n){
+	return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n));
+}
+
+CRYPTO_ALGORITHMS_TARGET("sse2")
+void quarter_round(__m128i &a, __m128i &b, __m128i &c, __m128i &d){
+	a = _mm_add_epi32(a, b); d = rotate128(_mm_xor_si128(d, a), 16);
+	c = _mm_add_epi32(c, d); b = rotate128(_mm_xor_si128(b, c), 12);
+	a = _mm_add_epi32(a, b); d = rotate128(_mm_xor_si128(d, a), 8);
+	c = _mm_add_epi32(c, d); b = rotate128(_mm_xor_si128(b, c), 7);
+}
+
+//Turns four vectors holding one word of four blocks each into four vectors
+//holding four words of one block each.
+CRYPTO_ALGORITHMS_TARGET("sse2")
+void transpose(__m128i &a, __m128i &b, __m128i &c, __m128i &d){
+	auto t0 = _mm_unpacklo_epi32(a, b);
+	auto t1 = _mm_unpacklo_epi32(c, d);
+	auto t2 = _mm_unpackhi_epi32(a, b);
+	auto t3 = _mm_unpackhi_epi32(c, d);
+	a = _mm_unpacklo_epi64(t0, t1);
+	b = _mm_unpackhi_epi64(t0, t1);
+	c = _mm_unpacklo_epi64(t2, t3);
+	d = _mm_unpackhi_epi64(t2, t3);
+}
+
+CRYPTO_ALGORITHMS_TARGET("sse2")
+void output128(std::uint8_t *dst, const std::uint8_t *src, __m128i x){
+	if (src)
+		x = _mm_xor_si128(x, _mm_loadu_si128((const __m128i *)src));
+	_mm_storeu_si128((__m128i *)dst, x);
+}
+
+CRYPTO_ALGORITHMS_TARGET("sse2")
+size_t blocks_sse2(std::uint8_t *dst, const std::uint8_t *src, std::uint32_t (&state)[16], size_t blocks){
+	const size_t width = 4;
+	size_t ret = 0;
+	for (; blocks - ret >= width; ret += width){
+		__m128i initial[16], x[16];
+		for (int i = 0; i < 16; i++)
+			initial[i] = _mm_set1_epi32((int)state[i]);
+		initial[12] = _mm_add_epi32(initial[12], _mm_setr_epi32(0, 1, 2, 3));
+		std::copy(initial, initial + 16, x);
+		for (int i = 0; i < 10; i++){
+			quarter_round(x[0], x[4], x[ 8], x[12]);
+			quarter_round(x[1], x[5], x[ 9], x[13]);
+			quarter_round(x[2], x[6], x[10], x[14]);
+			quarter_round(x[3], x[7], x[11], x[15]);
+			quarter_round(x[0], x[5], x[10], x[15]);
+			quarter_round(x[1], x[6], x[11], x[12]);
+			quarter_round(x[2], x[7], x[ 8], x[13]);
+			quarter_round(x[3], x[4], x[ 9], x[14]);
+		}
+		for (int i = 0; i < 16; i++)
+			x[i] = _mm_add_epi32(x[i], initial[i]);
+		for (int group = 0; group < 4; group++){
+			auto w = x + group * 4;
+			transpose(w[0], w[1], w[2], w[3]);
+			for (int block = 0; block < 4; block++){
+				auto offset = (ret + block) * 64 + group * 16;
+				output128(dst + offset, src ? src + offset : nullptr, w[block]);
+			}
+		}
+		state[12] += width;
+	}
+	return ret;
+}
+
+CRYPTO_ALGORITHMS_TARGET("avx2")
+__m256i rotate256(__m256i x, int n){
+	return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+}
+
+CRYPTO_ALGORITHMS_TARGET("avx2")
+void quarter_round(__m256i &a, __m256i &b, __m256i &c, __m256i &d){
+	//Rotations by whole bytes are done with a single shuffle.
+	const auto rot16 = _mm256_setr_epi8(
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13
+	);
+	const auto rot8 = _mm256_setr_epi8(
+		3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+		3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14
+	);
+	a = _mm256_add_epi32(a, b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot16);
+	c = _mm256_add_epi32(c, d); b = rotate256(_mm256_xor_si256(b, c), 12);
+	a = _mm256_add_epi32(a, b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot8);
+	c = _mm256_add_epi32(c, d); b = rotate256(_mm256_xor_si256(b, c), 7);
+}
+
+//Same as the SSE2 version, within each 128-bit lane.
+CRYPTO_ALGORITHMS_TARGET("avx2")
+void transpose(__m256i &a, __m256i &b, __m256i &c, __m256i &d){
+	auto t0 = _mm256_unpacklo_epi32(a, b);
+	auto t1 = _mm256_unpacklo_epi32(c, d);
+	auto t2 = _mm256_unpackhi_epi32(a, b);
+	auto t3 = _mm256_unpackhi_epi32(c, d);
+	a = _mm256_unpacklo_epi64(t0, t1);
+	b = _mm256_unpackhi_epi64(t0, t1);
+	c = _mm256_unpacklo_epi64(t2, t3);
+	d = _mm256_unpackhi_epi64(t2, t3);
+}
+
+CRYPTO_ALGORITHMS_TARGET("avx2")
+void output256(std::uint8_t *dst, const std::uint8_t *src, __m256i x){
+	if (src)
+		x = _mm256_xor_si256(x, _mm256_loadu_si256((const __m256i *)src));
+	_mm256_storeu_si256((__m256i *)dst, x);
+}
+
+CRYPTO_ALGORITHMS_TARGET("avx2")
+size_t blocks_avx2(std::uint8_t *dst, const std::uint8_t *src, std::uint32_t (&state)[16], size_t blocks){
+	const size_t width = 8;
+	size_t ret = 0;
+	for (; blocks - ret >= width; ret += width){
+		__m256i initial[16], x[16];
+		for (int i = 0; i < 16; i++)
+			initial[i] = _mm256_set1_epi32((int)state[i]);
+		initial[12] = _mm256_add_epi32(initial[12], _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		std::copy(initial, initial + 16, x);
+		for (int i = 0; i < 10; i++){
+			quarter_round(x[0], x[4], x[ 8], x[12]);
+			quarter_round(x[1], x[5], x[ 9], x[13]);
+			quarter_round(x[2], x[6], x[10], x[14]);
+			quarter_round(x[3], x[7], x[11], x[15]);
+			quarter_round(x[0], x[5], x[10], x[15]);
+			quarter_round(x[1], x[6], x[11], x[12]);
+			quarter_round(x[2], x[7], x[ 8], x[13]);
+			quarter_round(x[3], x[4], x[ 9], x[14]);
+		}
+		for (int i = 0; i < 16; i++)
+			x[i] = _mm256_add_epi32(x[i], initial[i]);
+		for (int group = 0; group < 4; group++)
+			transpose(x[group * 4 + 0], x[group * 4 + 1], x[group * 4 + 2], x[group * 4 + 3]);
+		//x[group * 4 + block] now holds words group * 4 to group * 4 + 3 of
+		//the given block in its low lane, and of block + 4 in its high lane.
+		for (int block = 0; block < 4; block++){
+			for (int half = 0; half < 2; half++){
+				auto a = x[half * 8 + block];
+				auto b = x[half * 8 + 4 + block];
+				auto offset = (ret + block) * 64 + half * 32;
+				output256(dst + offset, src ? src + offset : nullptr, _mm256_permute2x128_si256(a, b, 0x20));
+				offset += 4 * 64;
+				output256(dst + offset, src ? src + offset : nullptr, _mm256_permute2x128_si256(a, b, 0x31));
+			}
+		}
+		state[12] += width;
+	}
+	return ret;
+}
+
+#endif
+
+void load_key(std::uint32_t (&state)[16], const std::uint8_t *key){
+	set_constants(state);
+	for (int i = 0; i < 8; i++)
+		state[4 + i] = load32(key + i * 4);
+}
+
+}
+
+namespace symmetric{
+
+namespace detail{
+
+void chacha20_blocks(std::uint8_t *dst, const std::uint8_t *src, std::uint32_t (&state)[16], size_t blocks){
+	size_t done = 0;
+#ifdef CRYPTO_ALGORITHMS_X86
+	auto &features = utility::cpu::features();
+	if (features.avx2)
+		done += blocks_avx2(dst, src, state, blocks);
+	if (features.sse2)
+		done += blocks_sse2(dst + done * 64, src ? src + done * 64 : nullptr, state, blocks - done);
+#endif
+	for (; done < blocks; done++){
+		block_scalar(dst + done * 64, src ? src + done * 64 : nullptr, state);
+		state[12]++;
+	}
+}
+
+}
+
+ChaCha20::ChaCha20(const key_t &key, const nonce_t &nonce, std::uint32_t counter){
+	load_key(this->state, key.data().data());
+	this->state[12] = counter;
+	for (int i = 0; i < 3; i++)
+		this->state[13 + i] = load32(nonce.data() + i * 4);
+	this->remaining = ((std::uint64_t)1 << 32) - counter;
+}
+
+void ChaCha20::process(void *dst, const void *src, size_t blocks){
+	if (blocks > this->remaining)
+		throw std::runtime_error("ChaCha20 block counter exhausted");
+	this->remaining -= blocks;
+	detail::chacha20_blocks((std::uint8_t *)dst, (const std::uint8_t *)src, this->state, blocks);
+}
+
+}
+
+namespace csprng{
+
+void ChaCha20Rng::init(const std::uint8_t *key, const std::uint8_t *nonce){
+	load_key(this->state, key);
+	this->state[12] = 0;
+	this->state[13] = 0;
+	this->state[14] = load32(nonce);
+	this->state[15] = load32(nonce + 4);
+}
+
+ChaCha20Rng::ChaCha20Rng(){
+	std::random_device dev;
+	std::uint8_t seed[key_t::size + std::tuple_size<nonce_t>::value];
+	for (size_t i = 0; i < sizeof(seed); i += 4)
+		store32(seed + i, dev());
+	this->init(seed, seed + key_t::size);
+}
+
+ChaCha20Rng::ChaCha20Rng(const key_t &key, const nonce_t &nonce){
+	this->init(key.data().data(), nonce.data());
+}
+
+void ChaCha20Rng::generate(std::uint8_t *dst, size_t blocks){
+	while (blocks){
+		//The kernels only advance the low word of the counter.
+		auto n = (size_t)std::min<std::uint64_t>(blocks, ((std::uint64_t)1 << 32) - this->state[12]);
+		symmetric::detail::chacha20_blocks(dst, nullptr, this->state, n);
+		if (!this->state[12])
+			this->state[13]++;
+		dst += n * block_size;
+		blocks -= n;
+	}
+}
+
+void ChaCha20Rng::get_bytes(void *void_dst, size_t size){
+	auto dst = (std::uint8_t *)void_dst;
+	auto write_size = std::min(size, this->size);
+	memcpy(dst, this->buffer + this->offset, write_size);
+	this->offset += write_size;
+	this->size -= write_size;
+	dst += write_size;
+	size -= write_size;
+
+	//Whole blocks are generated directly into the destination.
+	auto blocks = size / block_size;
+	this->generate(dst, blocks);
+	dst += blocks * block_size;
+	size -= blocks * block_size;
+
+	if (size){
+		this->generate(this->buffer, batch_size);
+		memcpy(dst, this->buffer, size);
+		this->offset = size;
+		this->size = buffer_size - size;
+	}
+}
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "block.hpp"
+#include "stream.hpp"
+#include "rng.hpp"
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace symmetric{
+
+namespace detail{
+
+//Runs the ChaCha20 block function on consecutive counter values starting at
+//state[12], and XORs the keystream into src, writing the result to dst. dst
+//may be equal to src. If src is null the keystream itself is written. Uses
+//AVX2 or SSE2 kernels, 8 or 4 blocks at a time, when available. Advances
+//state[12], wrapping around to zero.
+void chacha20_blocks(std::uint8_t *dst, const std::uint8_t *src, std::uint32_t (&state)[16], size_t blocks);
+
+}
+
+//The stream cipher from RFC 8439, with a 96-bit nonce and a 32-bit block
+//counter.
+class ChaCha20{
+public:
+	static const size_t block_size = 64;
+	typedef Key<256> key_t;
+	typedef std::array<std::uint8_t, 12> nonce_t;
+	typedef std::array<std::uint8_t, block_size> block_t;
+private:
+	std::uint32_t state[16];
+	//Blocks left before the counter runs out.
+	std::uint64_t remaining;
+public:
+	ChaCha20(const key_t &key, const nonce_t &nonce, std::uint32_t counter = 0);
+	ChaCha20(const ChaCha20 &) = default;
+	ChaCha20 &operator=(const ChaCha20 &) = default;
+	//Encrypts or decrypts the next blocks of the stream. dst may be equal to
+	//src. Throws if the counter would run out, after 256 GiB.
+	void process(void *dst, const void *src, size_t blocks);
+	//Writes the keystream for the next blocks.
+	void keystream(void *dst, size_t blocks){
+		this->process(dst, nullptr, blocks);
+	}
+	block_t operator()(){
+		block_t ret;
+		this->keystream(ret.data(), 1);
+		return ret;
+	}
+	std::uint32_t get_counter() const{
+		return this->state[12];
+	}
+};
+
+namespace stream{
+
+//ChaCha20 as a DataSource and DataSink. Encryption and decryption are the
+//same operation. Call terminate() at the end of the stream to process the
+//last partial block.
+template <typename Buffer = utility::RingBuffer>
+class ChaCha20Stream : public BlockStream<ChaCha20::block_size, Buffer>{
+	ChaCha20 c;
+	void process(std::uint8_t *dst, const std::uint8_t *src, size_t blocks) override{
+		this->c.process(dst, src, blocks);
+	}
+public:
+	ChaCha20Stream(const ChaCha20::key_t &key, const ChaCha20::nonce_t &nonce, std::uint32_t counter = 0)
+		: c(key, nonce, counter){}
+	ChaCha20Stream(const ChaCha20 &c): c(c){}
+	void terminate() override{
+		this->process_tail();
+	}
+};
+
+}
+
+}
+
+namespace csprng{
+
+//Generates the ChaCha20 keystream for a key and a 64-bit nonce, using the
+//original 64-bit block counter, so it never runs out. Much faster than
+//BlockCipherRng on processors without AES instructions.
+class ChaCha20Rng : public Prng{
+	static const size_t block_size = symmetric::ChaCha20::block_size;
+	//Number of blocks generated per refill.
+	static const size_t batch_size = 16;
+	static const size_t buffer_size = batch_size * block_size;
+
+	std::uint32_t state[16];
+	std::uint8_t buffer[buffer_size];
+	size_t offset = 0;
+	size_t size = 0;
+
+	void init(const std::uint8_t *key, const std::uint8_t *nonce);
+	void generate(std::uint8_t *dst, size_t blocks);
+public:
+	typedef symmetric::ChaCha20::key_t key_t;
+	typedef std::array<std::uint8_t, 8> nonce_t;
+
+	//Seeds from std::random_device.
+	ChaCha20Rng();
+	ChaCha20Rng(const key_t &key, const nonce_t &nonce = {});
+	ChaCha20Rng(const ChaCha20Rng &) = default;
+	ChaCha20Rng &operator=(const ChaCha20Rng &) = default;
+	void get_bytes(void *void_dst, size_t size) override;
+	using Prng::get_bytes;
+};
+
+}
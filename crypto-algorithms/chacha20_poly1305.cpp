@@ -0,0 +1,107 @@
+#include "chacha20_poly1305.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace symmetric{
+
+std::array<std::uint8_t, hash::Poly1305::key_size> ChaCha20Poly1305::Context::one_time_key(ChaCha20 &cipher){
+	//The first block of keystream keys the MAC, and the message is encrypted
+	//from the second one on.
+	auto block = cipher();
+	std::array<std::uint8_t, hash::Poly1305::key_size> ret;
+	std::copy(block.begin(), block.begin() + ret.size(), ret.begin());
+	return ret;
+}
+
+ChaCha20Poly1305::Context::Context(const ChaCha20Poly1305 &aead, const nonce_t &nonce, bool encrypt)
+	: cipher(aead.key, nonce, 0)
+	, mac(one_time_key(this->cipher))
+	, encrypt(encrypt){}
+
+void ChaCha20Poly1305::Context::pad(std::uint64_t size){
+	static const std::uint8_t zeroes[hash::Poly1305::block_size] = {};
+	this->mac.update(zeroes, (size_t)(-size % sizeof(zeroes)));
+}
+
+void ChaCha20Poly1305::Context::xor_keystream(std::uint8_t *dst, const std::uint8_t *src, size_t size){
+	auto n = std::min(size, this->keystream_size);
+	for (size_t i = 0; i < n; i++)
+		dst[i] = src[i] ^ this->keystream[this->keystream_offset + i];
+	this->keystream_offset += n;
+	this->keystream_size -= n;
+	dst += n;
+	src += n;
+	size -= n;
+
+	//Whole blocks go straight through the vectorized kernels.
+	auto blocks = size / ChaCha20::block_size;
+	this->cipher.process(dst, src, blocks);
+	dst += blocks * ChaCha20::block_size;
+	src += blocks * ChaCha20::block_size;
+	size -= blocks * ChaCha20::block_size;
+
+	if (size){
+		this->cipher.keystream(this->keystream, 1);
+		for (size_t i = 0; i < size; i++)
+			dst[i] = src[i] ^ this->keystream[i];
+		this->keystream_offset = size;
+		this->keystream_size = ChaCha20::block_size - size;
+	}
+}
+
+void ChaCha20Poly1305::Context::check_not_finished() const{
+	if (this->finished)
+		throw std::runtime_error("ChaCha20-Poly1305 context already finished");
+}
+
+void ChaCha20Poly1305::Context::add_aad(const void *src, size_t size){
+	this->check_not_finished();
+	if (this->data_started)
+		throw std::runtime_error("ChaCha20-Poly1305 associated data must come before the message");
+	this->mac.update(src, size);
+	this->aad_size += size;
+}
+
+void ChaCha20Poly1305::Context::process(void *void_dst, const void *void_src, size_t size){
+	this->check_not_finished();
+	if (!this->data_started){
+		this->pad(this->aad_size);
+		this->data_started = true;
+	}
+	this->data_size += size;
+	auto dst = (std::uint8_t *)void_dst;
+	auto src = (const std::uint8_t *)void_src;
+	while (size){
+		auto n = std::min(size, detail::aead_chunk_size);
+		if (!this->encrypt)
+			this->mac.update(src, n);
+		this->xor_keystream(dst, src, n);
+		if (this->encrypt)
+			this->mac.update(dst, n);
+		dst += n;
+		src += n;
+		size -= n;
+	}
+}
+
+ChaCha20Poly1305::tag_t ChaCha20Poly1305::Context::finish(){
+	this->check_not_finished();
+	if (!this->data_started)
+		this->process(nullptr, nullptr, 0);
+	this->pad(this->data_size);
+	std::uint8_t lengths[16];
+	for (int i = 0; i < 8; i++){
+		lengths[i] = (std::uint8_t)(this->aad_size >> (i * 8));
+		lengths[8 + i] = (std::uint8_t)(this->data_size >> (i * 8));
+	}
+	this->mac.update(lengths, sizeof(lengths));
+	this->finished = true;
+	return this->mac.finish();
+}
+
+bool ChaCha20Poly1305::Context::verify(const tag_t &tag){
+	auto actual = this->finish();
+	return detail::constant_time_equal(actual.data(), tag.data(), tag_size);
+}
+
+}
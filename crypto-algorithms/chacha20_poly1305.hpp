@@ -0,0 +1,58 @@
+#pragma once
+
+#include "aead.hpp"
+#include "chacha20.hpp"
+#include "poly1305.hpp"
+#include <array>
+#include <cstdint>
+
+namespace symmetric{
+
+//The AEAD construction from RFC 8439.
+class ChaCha20Poly1305{
+public:
+	typedef ChaCha20::key_t key_t;
+	typedef ChaCha20::nonce_t nonce_t;
+	static const size_t tag_size = hash::Poly1305::tag_size;
+	typedef hash::Poly1305::tag_t tag_t;
+	class Context;
+private:
+	key_t key;
+public:
+	ChaCha20Poly1305(const key_t &key): key(key){}
+	tag_t encrypt(void *dst, const void *src, size_t size, const nonce_t &nonce, const void *aad = nullptr, size_t aad_size = 0) const{
+		return detail::aead_encrypt(*this, dst, src, size, nonce, aad, aad_size);
+	}
+	//Returns false, and wipes dst, if the tag doesn't match.
+	bool decrypt(void *dst, const void *src, size_t size, const nonce_t &nonce, const tag_t &tag, const void *aad = nullptr, size_t aad_size = 0) const{
+		return detail::aead_decrypt(*this, dst, src, size, nonce, tag, aad, aad_size);
+	}
+};
+
+class ChaCha20Poly1305::Context{
+	ChaCha20 cipher;
+	hash::Poly1305 mac;
+	std::uint8_t keystream[ChaCha20::block_size];
+	size_t keystream_offset = 0;
+	size_t keystream_size = 0;
+	std::uint64_t aad_size = 0;
+	std::uint64_t data_size = 0;
+	bool encrypt;
+	bool data_started = false;
+	bool finished = false;
+
+	static std::array<std::uint8_t, hash::Poly1305::key_size> one_time_key(ChaCha20 &);
+	void pad(std::uint64_t size);
+	void xor_keystream(std::uint8_t *dst, const std::uint8_t *src, size_t size);
+	void check_not_finished() const;
+public:
+	Context(const ChaCha20Poly1305 &aead, const nonce_t &nonce, bool encrypt);
+	Context(const Context &) = default;
+	Context &operator=(const Context &) = default;
+	void add_aad(const void *src, size_t size);
+	void process(void *dst, const void *src, size_t size);
+	tag_t finish();
+	bool verify(const tag_t &tag);
+};
+
+}
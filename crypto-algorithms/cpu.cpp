@@ -0,0 +1,66 @@
+#include "cpu.hpp"
+#if defined(CRYPTO_ALGORITHMS_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace{
+
+utility::cpu::Features detect(){
+	utility::cpu::Features ret;
+#if defined(CRYPTO_ALGORITHMS_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	auto max_leaf = info[0];
+	__cpuid(info, 1);
+	ret.sse2 = (info[3] >> 26) & 1;
+	ret.ssse3 = (info[2] >> 9) & 1;
+	ret.pclmul = (info[2] >> 1) & 1;
+	//AVX registers are only usable if the OS saves them on context switches.
+	bool os_avx = ((info[2] >> 27) & 1) && ((info[2] >> 28) & 1) && (_xgetbv(0) & 6) == 6;
+	if (max_leaf >= 7){
+		__cpuidex(info, 7, 0);
+		ret.avx2 = os_avx && ((info[1] >> 5) & 1);
+	}
+#elif defined(CRYPTO_ALGORITHMS_X86)
+	__builtin_cpu_init();
+	ret.sse2 = __builtin_cpu_supports("sse2");
+	ret.ssse3 = __builtin_cpu_supports("ssse3");
+	ret.avx2 = __builtin_cpu_supports("avx2");
+	ret.pclmul = __builtin_cpu_supports("pclmul");
+#endif
+	return ret;
+}
+
+const utility::cpu::Features &detected(){
+	static const auto ret = detect();
+	return ret;
+}
+
+utility::cpu::Features &current(){
+	static auto ret = detected();
+	return ret;
+}
+
+}
+
+namespace utility{
+
+namespace cpu{
+
+const Features &features(){
+	return current();
+}
+
+void set_features(const Features &features){
+	auto &detected = ::detected();
+	auto &current = ::current();
+	current.sse2 = features.sse2 && detected.sse2;
+	current.ssse3 = features.ssse3 && detected.ssse3;
+	current.avx2 = features.avx2 && detected.avx2;
+	current.pclmul = features.pclmul && detected.pclmul;
+}
+
+}
+
+}
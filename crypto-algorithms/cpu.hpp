@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+
+//Runtime detection of optional instruction set extensions, so that
+//vectorized kernels can be compiled into every build and picked at run time.
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CRYPTO_ALGORITHMS_X86 1
+#endif
+
+//Marks a function as allowed to use the given extensions, e.g.
+//CRYPTO_ALGORITHMS_TARGET("avx2"). Such a function must only be called after
+//checking utility::cpu::features(). MSVC doesn't need this.
+#if defined(CRYPTO_ALGORITHMS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CRYPTO_ALGORITHMS_TARGET(x) __attribute__((target(x)))
+#else
+#define CRYPTO_ALGORITHMS_TARGET(x)
+#endif
+
+namespace utility{
+
+namespace cpu{
+
+struct Features{
+	bool sse2 = false;
+	bool ssse3 = false;
+	bool avx2 = false;
+	//Carry-less multiplication, for GHASH.
+	bool pclmul = false;
+};
+
+//The extensions supported by both the processor and the OS.
+const Features &features();
+//Disables some of the detected extensions, to exercise the fallbacks in
+//tests. Extensions that weren't detected can't be enabled. Must not be called
+//while other threads may be using the library.
+void set_features(const Features &);
+
+//Runs a bulk operation over size elements with the widest kernels available:
+//Kernels::avx2, then Kernels::sse if the extension named by
+//Kernels::sse_feature is there, and Kernels::scalar for whatever is left. The
+//vector kernels return how many elements they processed, leaving any tail
+//shorter than a vector to the next one. On other architectures only
+//Kernels::scalar needs to exist.
+template <typename Kernels, typename Dst, typename Src, typename Parameter>
+void run_kernels(Dst *dst, const Src *src, const Parameter &parameter, size_t size){
+	size_t done = 0;
+#ifdef CRYPTO_ALGORITHMS_X86
+	auto &f = features();
+	if (f.avx2)
+		done += Kernels::avx2(dst, src, parameter, size);
+	if (f.*Kernels::sse_feature)
+		done += Kernels::sse(dst + done, src + done, parameter, size - done);
+#endif
+	Kernels::scalar(dst + done, src + done, parameter, size - done);
+}
+
+}
+
+}
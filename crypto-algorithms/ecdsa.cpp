@@ -44,7 +44,9 @@ std::unique_ptr<ECDSA::Signature> PrivateKey::sign_digest(const void *digest, No
 	auto r = (param_g * nonce.k).get_x() % n;
 	if (!r)
 		return nullptr;
-	auto s = (this->key * r + z) * nonce.k.extended_euclidean(n) % n;
+	auto s = z;
+	s.mul_add(this->key, r);
+	s = s * nonce.k.mod_inverse_ct(n) % n;
 	if (!s)
 		return nullptr;
 	return std::make_unique<Signature>(r.abs(), s.abs());
@@ -66,15 +68,16 @@ MessageVerificationResult Signature::verify_digest(const void *digest, PublicKey
 	auto &n = param_n;
 	number_t r = this->r;
 	number_t s = this->s;
-	if (pk.is_infinite() || !pk.is_solution() || !(pk * n).is_infinite())
+	if (pk.is_infinite() || !pk.is_solution() || !pk.multiply_public(n).is_infinite())
 		return MessageVerificationResult::SignatureInvalid;
 	auto m = n;
 	if (r < 1 || s < 1 || r >= m || s >= m)
 		return MessageVerificationResult::SignatureInvalid;
-	auto w = s.extended_euclidean(m);
+	//Everything here is public, so the faster inversions are fine.
+	number_t w = s.mod_inverse(m);
 	auto u1 = (z * w).euclidean_modulo(m);
 	auto u2 = (r * w).euclidean_modulo(m);
-	auto x = param_g * u1 + pk * u2;
+	auto x = param_g.multiply_public(u1).add_public(pk.multiply_public(u2));
 	if (x.is_infinite() || r != x.get_x())
 		return MessageVerificationResult::MessageInvalid;
 	return MessageVerificationResult::MessageVerified;
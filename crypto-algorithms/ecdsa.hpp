@@ -69,6 +69,9 @@ public:
 	EllipticCurve::Point operator*(const number_t &other) const{
 		return this->key * other;
 	}
+	EllipticCurve::Point multiply_public(const number_t &other) const{
+		return this->key.multiply_public(other);
+	}
 };
 
 class PrivateKey : public ECDSA::PrivateKey{
@@ -2,38 +2,72 @@
 
 namespace asymmetric::EllipticCurve{
 
+Parameters::Field::Field(const T &p, const T &a, const T &b, const T &c, const T &d): context(p.abs()){
+	this->a = this->context.residue(a);
+	this->b = this->context.residue(b);
+	this->c = this->context.residue(c);
+	this->d = this->context.residue(d);
+	this->context.add_mod(this->b2, this->b, this->b);
+	this->context.add_mod(this->a3, this->a, this->a);
+	this->context.add_mod(this->a3, this->a3, this->a);
+}
+
 bool Parameters::is_solution(const T &x, const T &y) const{
-	T l = y.mod_pow(2, p);
-	auto r = this->evaluate_x(x);
-	return l == r;
+	auto &m = this->get_context();
+	return this->is_solution(m.residue(x), m.residue(y));
+}
+
+bool Parameters::is_solution(const U &x, const U &y) const{
+	U l;
+	this->get_context().sqr_mod(l, y);
+	return l == this->evaluate_x(x);
 }
 
 Parameters::T Parameters::evaluate_x(const T &x) const{
-	auto ret = a;
-	ret = ret * x + b;
-	ret = ret * x + c;
-	ret = ret * x + d;
-	ret %= p;
+	return this->evaluate_x(this->get_context().residue(x));
+}
+
+Parameters::U Parameters::evaluate_x(const U &x) const{
+	auto &m = this->get_context();
+	auto &f = *this->field;
+	U ret;
+	m.mul_mod(ret, f.a, x);
+	m.add_mod(ret, ret, f.b);
+	m.mul_mod(ret, ret, x);
+	m.add_mod(ret, ret, f.c);
+	m.mul_mod(ret, ret, x);
+	m.add_mod(ret, ret, f.d);
 	return ret;
 }
 
 bool Parameters::get_slope(T &dst, const T &x, const T &y) const{
+	auto &m = this->get_context();
+	U slope;
+	if (!this->get_slope(slope, m.residue(x), m.residue(y)))
+		return false;
+	dst = std::move(slope);
+	return true;
+}
+
+bool Parameters::get_slope(U &dst, const U &x, const U &y, bool public_data) const{
 	if (!this->is_solution(x, y))
 		return false;
 	if (!y)
 		return false;
 
-	auto dividend = a * 3;
-	dividend = dividend * x + b;
-	dividend %= p;
-	dividend = dividend * x + c;
-	dividend %= p;
-	auto divisor = (y * 2).extended_euclidean(p);
-
-	dst = ((dividend * divisor) % p);
-
-	//assert((dst * 2 * Y) % p == dividend);
-
+	auto &m = this->get_context();
+	auto &f = *this->field;
+	U dividend, divisor;
+	m.mul_mod(dividend, f.a3, x);
+	m.add_mod(dividend, dividend, f.b2);
+	m.mul_mod(dividend, dividend, x);
+	m.add_mod(dividend, dividend, f.c);
+	m.add_mod(divisor, y, y);
+	if (public_data)
+		m.inv_mod_vartime(divisor, divisor);
+	else
+		m.inv_mod(divisor, divisor);
+	m.mul_mod(dst, dividend, divisor);
 	return true;
 }
 
@@ -78,6 +112,10 @@ bool Point::operator==(const Point &other) const{
 }
 
 Point Point::operator+(const Point &other) const{
+	return this->add(other, false);
+}
+
+Point Point::add(const Point &other, bool public_data) const{
 	if (this->infinite)
 		return other.infinite ? Point() : other;
 	if (other.infinite)
@@ -88,37 +126,42 @@ Point Point::operator+(const Point &other) const{
 	if (!this->is_solution() || !other.is_solution())
 		throw std::runtime_error("Attempted to add an elliptic curve point that's not a solution");
 
-	T coeff1;
-	auto p = this->parameters.get_p();
-	auto a = *this;
-	auto b = other;
-	if (a == b){
-		if (!a.get_slope(coeff1))
+	auto &m = this->parameters.get_context();
+	auto x1 = m.residue(this->x);
+	auto y1 = m.residue(this->y);
+	auto x2 = m.residue(other.x);
+	auto y2 = m.residue(other.y);
+	U slope;
+	if (x1 == x2){
+		if (y1 != y2 || !this->parameters.get_slope(slope, x1, y1, public_data))
 			return Point();
 	}else{
-		if (a.x == b.x)
-			return Point();
-		if (a.x > b.x){
-			b = *this;
-			a = other;
-		}
-		coeff1 = ((b.y - a.y) * (b.x - a.x).extended_euclidean(p)).euclidean_modulo(p);
+		U dx;
+		m.sub_mod(slope, y2, y1);
+		m.sub_mod(dx, x2, x1);
+		if (public_data)
+			m.inv_mod_vartime(dx, dx);
+		else
+			m.inv_mod(dx, dx);
+		m.mul_mod(slope, slope, dx);
 	}
-	auto coeff0 = (a.y - coeff1 * a.x).euclidean_modulo(p);
-	//assert((T)(coeff1 * a.x + coeff0).euclidean_modulo(p) == a.y);
-	//assert((T)(coeff1 * b.x + coeff0).euclidean_modulo(p) == b.y);
-	auto x = ((coeff1 * coeff1) - a.x - b.x).euclidean_modulo(p);
-	auto y = (-(coeff1 * x + coeff0)).euclidean_modulo(p);
-
-	Point ret(x, y, this->parameters);
-	//assert(ret.is_solution());
-	return ret;
+	//x3 = slope^2 - x1 - x2
+	//y3 = slope * (x1 - x3) - y1
+	U x, y;
+	m.sqr_mod(x, slope);
+	m.sub_mod(x, x, x1);
+	m.sub_mod(x, x, x2);
+	m.sub_mod(y, x1, x);
+	m.mul_mod(y, y, slope);
+	m.sub_mod(y, y, y1);
+
+	return Point(std::move(x), std::move(y), this->parameters);
 }
 
 Point Point::operator-(const Point &other){
 	if (other.infinite)
 		return *this;
-	return Point(this->x, (-this->y).euclidean_modulo(this->parameters.get_p()), this->parameters);
+	return *this + -other;
 }
 
 Point Point::operator*(const arithmetic::arbitrary::SignedBigNum &multiplier) const{
@@ -128,6 +171,16 @@ Point Point::operator*(const arithmetic::arbitrary::SignedBigNum &multiplier) co
 }
 
 Point Point::operator*(const arithmetic::arbitrary::BigNum &multiplier) const{
+	return this->multiply(multiplier, false);
+}
+
+Point Point::multiply_public(const arithmetic::arbitrary::SignedBigNum &multiplier) const{
+	if (multiplier.negative())
+		return -this->multiply(multiplier.abs(), true);
+	return this->multiply(multiplier.abs(), true);
+}
+
+Point Point::multiply(const arithmetic::arbitrary::BigNum &multiplier, bool public_data) const{
 	if (!multiplier)
 		return Point();
 	auto bytes = multiplier.to_buffer();
@@ -139,8 +192,8 @@ Point Point::operator*(const arithmetic::arbitrary::BigNum &multiplier) const{
 	for (size_t i = 0; i < m; i++){
 		auto bit = (bytes[i / 8] >> (i % 8)) & 1;
 		if (bit)
-			ret += a;
-		a += a;
+			ret = ret.add(a, public_data);
+		a = a.add(a, public_data);
 	}
 	return ret;
 }
@@ -148,7 +201,10 @@ Point Point::operator*(const arithmetic::arbitrary::BigNum &multiplier) const{
 Point Point::operator-() const{
 	if (this->infinite)
 		return *this;
-	return Point(this->x, (-this->y).euclidean_modulo(this->parameters.get_p()), this->parameters);
+	auto &m = this->parameters.get_context();
+	U y;
+	m.neg_mod(y, m.residue(this->y));
+	return Point(this->x, std::move(y), this->parameters);
 }
 
 int Point::hex2val(char c){
@@ -161,10 +217,6 @@ int Point::hex2val(char c){
 	return -1;
 }
 
-bool Point::get_slope(T &dst) const{
-	return this->parameters.get_slope(dst, this->get_x(), this->get_y());
-}
-
 size_t Point::last_byte(const std::vector<std::uint8_t> &buffer){
 	size_t ret = 0;
 	auto n = buffer.size();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cassert>
+#include <memory>
 
 #include "bignum.hpp"
 
@@ -8,10 +9,23 @@ namespace asymmetric::EllipticCurve{
 
 class Parameters{
 	typedef arithmetic::arbitrary::SignedBigNum T;
+	typedef arithmetic::arbitrary::BigNum U;
+	typedef arithmetic::arbitrary::ModContext ModContext;
+	//Everything the arithmetic needs, reduced modulo p once, and shared
+	//between copies.
+	struct Field{
+		ModContext context;
+		U a, b, c, d;
+		//The coefficients of the derivative: 3a and 2b.
+		U a3, b2;
+		Field(const T &p, const T &a, const T &b, const T &c, const T &d);
+	};
 	T p, a, b, c, d;
+	std::shared_ptr<const Field> field;
 public:
 	Parameters() = default;
-	Parameters(const T &p, const T &a, const T &b, const T &c, const T &d): p(p), a(a), b(b), c(c), d(d){}
+	Parameters(const T &p, const T &a, const T &b, const T &c, const T &d)
+		: p(p), a(a), b(b), c(c), d(d), field(std::make_shared<Field>(p, a, b, c, d)){}
 	Parameters(const Parameters &) = default;
 	Parameters(Parameters &&) = default;
 	Parameters &operator=(const Parameters &) = default;
@@ -28,20 +42,30 @@ public:
 	T get_p() const{
 		return this->p;
 	}
+	const ModContext &get_context() const{
+		return this->field->context;
+	}
+	//The same as above, on residues modulo p. If public_data is set, the
+	//slope is computed with the faster variable-time inversion.
+	bool is_solution(const U &x, const U &y) const;
+	U evaluate_x(const U &x) const;
+	bool get_slope(U &dst, const U &x, const U &y, bool public_data = false) const;
 };
 
 class Point{
 	typedef arithmetic::arbitrary::SignedBigNum T;
+	typedef arithmetic::arbitrary::BigNum U;
 	T x, y;
 	Parameters parameters;
 	bool infinite = false;
 
 	static int hex2val(char c);
-	bool get_slope(T &dst) const;
 	static size_t last_byte(const std::vector<std::uint8_t> &buffer);
 	static size_t bit_size(std::uint8_t b);
 	static size_t count_bits(const std::vector<std::uint8_t> &buffer);
 	static size_t count_hex_string_characters(const char *compressed);
+	Point add(const Point &other, bool public_data) const;
+	Point multiply(const arithmetic::arbitrary::BigNum &multiplier, bool public_data) const;
 public:
 	Point(){
 		this->infinite = true;
@@ -70,8 +94,20 @@ public:
 	}
 	Point operator+(const Point &other) const;
 	Point operator-(const Point &other);
+	//Double-and-add. Not constant time: which additions run depends on the
+	//bits of the multiplier.
 	Point operator*(const arithmetic::arbitrary::SignedBigNum &multiplier) const;
 	Point operator*(const arithmetic::arbitrary::BigNum &multiplier) const;
+	//The same as + and *, but with variable-time field inversions. Only for
+	//points and scalars that are all public, such as in signature
+	//verification.
+	Point add_public(const Point &other) const{
+		return this->add(other, true);
+	}
+	Point multiply_public(const arithmetic::arbitrary::SignedBigNum &multiplier) const;
+	Point multiply_public(const arithmetic::arbitrary::BigNum &multiplier) const{
+		return this->multiply(multiplier, true);
+	}
 	const Point &operator+=(const Point &other){
 		return *this = *this + other;
 	}
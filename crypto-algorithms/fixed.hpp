@@ -1,5 +1,6 @@
 #pragma once
 
+#include "hex.hpp"
 #include <cstddef>
 #include <climits>
 #include <cstring>
@@ -7,6 +8,7 @@
 #include <array>
 #include <type_traits>
 #include <cstdint>
+#include <limits>
 
 namespace arithmetic::fixed{
 
@@ -141,23 +143,9 @@ public:
 	static BigNum from_hex_string(const char *string, size_t length = 0){
 		if (!length)
 			length = strlen(string);
-		BigNum ret;
-		for (size_t write_pos = 0, read_pos = length; write_pos < bytes * 2 && read_pos--;){
-			number_t digit = 0;
-			auto c = string[read_pos];
-			if (c >= '0' && c <= '9')
-				digit = c - '0';
-			else if (c >= 'A' && c <= 'F')
-				digit = c - 'A' + 10;
-			else if (c >= 'a' && c <= 'f')
-				digit = c - 'a' + 10;
-			else
-				continue;
-
-			ret.data[write_pos / (2 * sizeof(number_t))] |= digit << (write_pos % (2 * sizeof(number_t)) * 4);
-			write_pos++;
-		}
-		return ret;
+		//Digits that don't fit are dropped.
+		auto buffer = utility::hex_number_to_bytes(string, length);
+		return BigNum(buffer.data(), buffer.size());
 	}
 	BigNum(const BigNum &other) = default;
 	BigNum &operator=(const BigNum &other) = default;
@@ -0,0 +1,229 @@
+#include "gcm.hpp"
+#include "cpu.hpp"
+#include <algorithm>
+#include <cstring>
+#ifdef CRYPTO_ALGORITHMS_X86
+#include <immintrin.h>
+#endif
+
+namespace{
+
+typedef symmetric::detail::Ghash Ghash;
+
+std::uint64_t load_be64(const std::uint8_t *p){
+	std::uint64_t ret = 0;
+	for (int i = 0; i < 8; i++)
+		ret = ret << 8 | p[i];
+	return ret;
+}
+
+void store_be64(std::uint8_t *p, std::uint64_t x){
+	for (int i = 8; i--;){
+		p[i] = (std::uint8_t)x;
+		x >>= 8;
+	}
+}
+
+//The reductions of the four bits shifted out of the low end by a 4-bit
+//shift, for the table driven multiplication.
+const std::uint64_t last4[16] = {
+	0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+	0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0,
+};
+
+void blocks_table(std::uint8_t (&state)[Ghash::block_size], const Ghash::Key &key, const std::uint8_t *src, size_t blocks){
+	for (; blocks--; src += Ghash::block_size){
+		for (size_t i = 0; i < Ghash::block_size; i++)
+			state[i] ^= src[i];
+		key.multiply(state);
+	}
+}
+
+#ifdef CRYPTO_ALGORITHMS_X86
+
+//GCM's bit order is reflected, so the kernel byte-reverses its inputs and
+//outputs, multiplies as if the bits were in the normal order, and corrects
+//for the reflection by shifting the product left by one before reducing it.
+//See Gueron and Kounavis, "Intel Carry-Less Multiplication Instruction and
+//its Usage for Computing the GCM Mode".
+
+//Unreduced 256-bit product of a and b.
+CRYPTO_ALGORITHMS_TARGET("pclmul,sse2")
+void clmul(__m128i a, __m128i b, __m128i &lo, __m128i &hi){
+	auto middle = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+	lo = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x00), _mm_slli_si128(middle, 8));
+	hi = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x11), _mm_srli_si128(middle, 8));
+}
+
+CRYPTO_ALGORITHMS_TARGET("sse2")
+__m128i reduce(__m128i lo, __m128i hi){
+	//Shift the product left by one.
+	auto lo_carry = _mm_srli_epi32(lo, 31);
+	auto hi_carry = _mm_srli_epi32(hi, 31);
+	lo = _mm_slli_epi32(lo, 1);
+	hi = _mm_slli_epi32(hi, 1);
+	auto across = _mm_srli_si128(lo_carry, 12);
+	lo = _mm_or_si128(lo, _mm_slli_si128(lo_carry, 4));
+	hi = _mm_or_si128(hi, _mm_slli_si128(hi_carry, 4));
+	hi = _mm_or_si128(hi, across);
+
+	//Reduce modulo x^128 + x^7 + x^2 + x + 1.
+	auto a = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+	auto b = _mm_srli_si128(a, 4);
+	lo = _mm_xor_si128(lo, _mm_slli_si128(a, 12));
+	auto c = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+	c = _mm_xor_si128(c, b);
+	lo = _mm_xor_si128(lo, c);
+	return _mm_xor_si128(hi, lo);
+}
+
+CRYPTO_ALGORITHMS_TARGET("ssse3")
+__m128i load(const std::uint8_t *p){
+	const auto reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), reverse);
+}
+
+CRYPTO_ALGORITHMS_TARGET("pclmul,ssse3")
+void blocks_pclmul(std::uint8_t (&state)[Ghash::block_size], const Ghash::Key &key, const std::uint8_t *src, size_t blocks){
+	const auto reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	auto h1 = _mm_load_si128((const __m128i *)key.powers[0]);
+	auto h2 = _mm_load_si128((const __m128i *)key.powers[1]);
+	auto h3 = _mm_load_si128((const __m128i *)key.powers[2]);
+	auto h4 = _mm_load_si128((const __m128i *)key.powers[3]);
+	auto y = load(state);
+
+	//(((y + x0) * H + x1) * H + x2) * H + x3) * H
+	//    = (y + x0) * H^4 + x1 * H^3 + x2 * H^2 + x3 * H
+	for (; blocks >= 4; blocks -= 4, src += 4 * Ghash::block_size){
+		__m128i lo, hi, lo2, hi2;
+		clmul(_mm_xor_si128(y, load(src)), h4, lo, hi);
+		clmul(load(src + 16), h3, lo2, hi2);
+		lo = _mm_xor_si128(lo, lo2);
+		hi = _mm_xor_si128(hi, hi2);
+		clmul(load(src + 32), h2, lo2, hi2);
+		lo = _mm_xor_si128(lo, lo2);
+		hi = _mm_xor_si128(hi, hi2);
+		clmul(load(src + 48), h1, lo2, hi2);
+		lo = _mm_xor_si128(lo, lo2);
+		hi = _mm_xor_si128(hi, hi2);
+		y = reduce(lo, hi);
+	}
+	for (; blocks; blocks--, src += Ghash::block_size){
+		__m128i lo, hi;
+		clmul(_mm_xor_si128(y, load(src)), h1, lo, hi);
+		y = reduce(lo, hi);
+	}
+	_mm_storeu_si128((__m128i *)state, _mm_shuffle_epi8(y, reverse));
+}
+
+#endif
+
+void process_blocks(std::uint8_t (&state)[Ghash::block_size], const Ghash::Key &key, const std::uint8_t *src, size_t blocks){
+#ifdef CRYPTO_ALGORITHMS_X86
+	auto &features = utility::cpu::features();
+	if (features.pclmul && features.ssse3){
+		blocks_pclmul(state, key, src, blocks);
+		return;
+	}
+#endif
+	blocks_table(state, key, src, blocks);
+}
+
+}
+
+namespace symmetric{
+
+namespace detail{
+
+Ghash::Key::Key(const block_t &h){
+	auto vh = load_be64(h.data());
+	auto vl = load_be64(h.data() + 8);
+	this->hl[0] = 0;
+	this->hh[0] = 0;
+	this->hl[8] = vl;
+	this->hh[8] = vh;
+	for (int i = 4; i > 0; i >>= 1){
+		auto t = (vl & 1) * 0xE1000000;
+		vl = vh << 63 | vl >> 1;
+		vh = vh >> 1 ^ t << 32;
+		this->hl[i] = vl;
+		this->hh[i] = vh;
+	}
+	for (int i = 2; i <= 8; i *= 2){
+		for (int j = 1; j < i; j++){
+			this->hh[i + j] = this->hh[i] ^ this->hh[j];
+			this->hl[i + j] = this->hl[i] ^ this->hl[j];
+		}
+	}
+
+	std::uint8_t power[block_size];
+	std::copy(h.begin(), h.end(), power);
+	for (auto &dst : this->powers){
+		std::reverse_copy(power, power + block_size, dst);
+		this->multiply(power);
+	}
+}
+
+void Ghash::Key::multiply(std::uint8_t (&x)[block_size]) const{
+	auto lo = x[15] & 0x0F;
+	auto zh = this->hh[lo];
+	auto zl = this->hl[lo];
+	for (int i = 15; i >= 0; i--){
+		lo = x[i] & 0x0F;
+		auto hi = x[i] >> 4;
+		if (i != 15){
+			auto rem = zl & 0x0F;
+			zl = zh << 60 | zl >> 4;
+			zh = zh >> 4 ^ last4[rem] << 48;
+			zh ^= this->hh[lo];
+			zl ^= this->hl[lo];
+		}
+		auto rem = zl & 0x0F;
+		zl = zh << 60 | zl >> 4;
+		zh = zh >> 4 ^ last4[rem] << 48;
+		zh ^= this->hh[hi];
+		zl ^= this->hl[hi];
+	}
+	store_be64(x, zh);
+	store_be64(x + 8, zl);
+}
+
+void Ghash::update(const void *void_src, size_t size){
+	auto src = (const std::uint8_t *)void_src;
+	if (this->buffered){
+		auto n = std::min(size, block_size - this->buffered);
+		memcpy(this->buffer + this->buffered, src, n);
+		this->buffered += n;
+		src += n;
+		size -= n;
+		if (this->buffered < block_size)
+			return;
+		process_blocks(this->state, *this->key, this->buffer, 1);
+		this->buffered = 0;
+	}
+	auto blocks = size / block_size;
+	process_blocks(this->state, *this->key, src, blocks);
+	src += blocks * block_size;
+	size -= blocks * block_size;
+	if (size)
+		memcpy(this->buffer, src, size);
+	this->buffered = size;
+}
+
+void Ghash::pad(){
+	if (!this->buffered)
+		return;
+	memset(this->buffer + this->buffered, 0, block_size - this->buffered);
+	process_blocks(this->state, *this->key, this->buffer, 1);
+	this->buffered = 0;
+}
+
+Ghash::block_t Ghash::get_state() const{
+	block_t ret;
+	std::copy(this->state, this->state + block_size, ret.begin());
+	return ret;
+}
+
+}
+
+}
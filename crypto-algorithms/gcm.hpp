@@ -0,0 +1,192 @@
+#pragma once
+
+#include "aead.hpp"
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+
+namespace symmetric{
+
+namespace detail{
+
+//The universal hash from GCM. Uses PCLMULQDQ, four blocks per reduction,
+//when available, and 4-bit tables otherwise.
+class Ghash{
+public:
+	static const size_t block_size = 16;
+	typedef std::array<std::uint8_t, block_size> block_t;
+
+	//Everything derived from the hash key H.
+	struct Key{
+		//Multiples of H, for the table driven code.
+		std::uint64_t hl[16];
+		std::uint64_t hh[16];
+		//H, H^2, H^3 and H^4, byte reversed, for the PCLMULQDQ code.
+		alignas(16) std::uint8_t powers[4][block_size];
+
+		Key(const block_t &h);
+		//x = x * H
+		void multiply(std::uint8_t (&x)[block_size]) const;
+	};
+private:
+	const Key *key;
+	std::uint8_t state[block_size] = {};
+	std::uint8_t buffer[block_size];
+	size_t buffered = 0;
+public:
+	Ghash(const Key &key): key(&key){}
+	void update(const void *src, size_t size);
+	//Pads the input so far with zeros to a whole number of blocks.
+	void pad();
+	//Only valid right after pad().
+	block_t get_state() const;
+};
+
+}
+
+//Galois/Counter Mode over any block cipher with 128-bit blocks, with a
+//96-bit nonce and a full length tag.
+template <typename Cipher>
+class Gcm{
+	static_assert(Cipher::block_size == 16, "GCM requires a cipher with 128-bit blocks!");
+public:
+	typedef typename Cipher::key_t key_t;
+	typedef std::array<std::uint8_t, 12> nonce_t;
+	static const size_t tag_size = 16;
+	typedef std::array<std::uint8_t, tag_size> tag_t;
+	class Context;
+private:
+	Cipher c;
+	detail::Ghash::Key hash_key;
+public:
+	Gcm(const Cipher &c): c(c), hash_key(c.encrypt_block(typename Cipher::block_t{})){}
+	Gcm(const key_t &key): Gcm(Cipher(key)){}
+	tag_t encrypt(void *dst, const void *src, size_t size, const nonce_t &nonce, const void *aad = nullptr, size_t aad_size = 0) const{
+		return detail::aead_encrypt(*this, dst, src, size, nonce, aad, aad_size);
+	}
+	//Returns false, and wipes dst, if the tag doesn't match.
+	bool decrypt(void *dst, const void *src, size_t size, const nonce_t &nonce, const tag_t &tag, const void *aad = nullptr, size_t aad_size = 0) const{
+		return detail::aead_decrypt(*this, dst, src, size, nonce, tag, aad, aad_size);
+	}
+};
+
+template <typename Cipher>
+class Gcm<Cipher>::Context{
+	typedef typename Cipher::block_t block_t;
+	static const size_t block_size = Cipher::block_size;
+	//The counter only has 32 bits, and the first value is used for the tag.
+	static const std::uint64_t max_data_size = (((std::uint64_t)1 << 32) - 2) * block_size;
+	//Number of counter blocks encrypted together.
+	static const size_t batch_size = 8;
+
+	const Gcm *gcm;
+	block_t counter;
+	block_t tag_mask;
+	detail::Ghash ghash;
+	std::uint8_t keystream[batch_size * block_size];
+	size_t keystream_offset = 0;
+	size_t keystream_size = 0;
+	std::uint64_t aad_size = 0;
+	std::uint64_t data_size = 0;
+	bool encrypt;
+	bool data_started = false;
+	bool finished = false;
+
+	void increment_counter(){
+		for (size_t i = block_size; i-- > 12;)
+			if (++this->counter[i])
+				break;
+	}
+	void generate(std::uint8_t *dst, size_t blocks){
+		for (size_t i = 0; i < blocks; i++){
+			this->gcm->c.encrypt_block(dst + i * block_size, this->counter.data());
+			this->increment_counter();
+		}
+	}
+	void check_not_finished() const{
+		if (this->finished)
+			throw std::runtime_error("GCM context already finished");
+	}
+	void xor_keystream(std::uint8_t *dst, const std::uint8_t *src, size_t size){
+		while (size){
+			if (!this->keystream_size){
+				this->generate(this->keystream, batch_size);
+				this->keystream_offset = 0;
+				this->keystream_size = sizeof(this->keystream);
+			}
+			auto n = std::min(size, this->keystream_size);
+			auto keystream = this->keystream + this->keystream_offset;
+			for (size_t i = 0; i < n; i++)
+				dst[i] = src[i] ^ keystream[i];
+			this->keystream_offset += n;
+			this->keystream_size -= n;
+			dst += n;
+			src += n;
+			size -= n;
+		}
+	}
+public:
+	Context(const Gcm &gcm, const nonce_t &nonce, bool encrypt): gcm(&gcm), ghash(gcm.hash_key), encrypt(encrypt){
+		std::copy(nonce.begin(), nonce.end(), this->counter.begin());
+		std::fill(this->counter.begin() + nonce.size(), this->counter.end(), 0);
+		this->counter[block_size - 1] = 1;
+		this->tag_mask = gcm.c.encrypt_block(this->counter);
+		this->increment_counter();
+	}
+	Context(const Context &) = default;
+	Context &operator=(const Context &) = default;
+	void add_aad(const void *src, size_t size){
+		this->check_not_finished();
+		if (this->data_started)
+			throw std::runtime_error("GCM associated data must come before the message");
+		this->ghash.update(src, size);
+		this->aad_size += size;
+	}
+	void process(void *void_dst, const void *void_src, size_t size){
+		this->check_not_finished();
+		if (!this->data_started){
+			this->ghash.pad();
+			this->data_started = true;
+		}
+		if (size > max_data_size - this->data_size)
+			throw std::runtime_error("GCM message too long");
+		this->data_size += size;
+		auto dst = (std::uint8_t *)void_dst;
+		auto src = (const std::uint8_t *)void_src;
+		while (size){
+			auto n = std::min(size, detail::aead_chunk_size);
+			if (!this->encrypt)
+				this->ghash.update(src, n);
+			this->xor_keystream(dst, src, n);
+			if (this->encrypt)
+				this->ghash.update(dst, n);
+			dst += n;
+			src += n;
+			size -= n;
+		}
+	}
+	tag_t finish(){
+		this->check_not_finished();
+		if (!this->data_started)
+			this->process(nullptr, nullptr, 0);
+		this->ghash.pad();
+		std::uint8_t lengths[block_size];
+		for (int i = 0; i < 8; i++){
+			lengths[i] = (std::uint8_t)((this->aad_size * 8) >> (56 - i * 8));
+			lengths[8 + i] = (std::uint8_t)((this->data_size * 8) >> (56 - i * 8));
+		}
+		this->ghash.update(lengths, block_size);
+		this->finished = true;
+		auto s = this->ghash.get_state();
+		tag_t ret;
+		for (size_t i = 0; i < tag_size; i++)
+			ret[i] = s[i] ^ this->tag_mask[i];
+		return ret;
+	}
+	bool verify(const tag_t &tag){
+		auto actual = this->finish();
+		return detail::constant_time_equal(actual.data(), tag.data(), tag_size);
+	}
+};
+
+}
@@ -0,0 +1,136 @@
+#include "gf256.hpp"
+#include "cpu.hpp"
+#ifdef CRYPTO_ALGORITHMS_X86
+#include <immintrin.h>
+#endif
+
+namespace{
+
+struct Tables{
+	std::uint8_t exp[512];
+	std::uint8_t log[256];
+
+	Tables(){
+		//3 generates the multiplicative group.
+		std::uint8_t x = 1;
+		for (int i = 0; i < 255; i++){
+			this->exp[i] = this->exp[i + 255] = x;
+			this->log[x] = (std::uint8_t)i;
+			x ^= (std::uint8_t)(x << 1) ^ (x & 0x80 ? 0x1B : 0);
+		}
+		this->exp[510] = this->exp[511] = this->exp[0];
+		this->log[0] = 0;
+	}
+};
+
+const Tables tables;
+
+//The products of c with every possible low and high nibble.
+struct NibbleTables{
+	std::uint8_t lo[16];
+	std::uint8_t hi[16];
+
+	NibbleTables(std::uint8_t c){
+		for (int i = 0; i < 16; i++){
+			this->lo[i] = gf256::multiply(c, (std::uint8_t)i);
+			this->hi[i] = gf256::multiply(c, (std::uint8_t)(i << 4));
+		}
+	}
+};
+
+//Both bulk operations compute dst[i] = c * x[i] ^ y[i]. Horner selects whether
+//x is dst and y is src, or the other way around.
+
+template <bool Horner>
+void kernel_scalar(std::uint8_t *dst, const std::uint8_t *src, const NibbleTables &t, size_t size){
+	for (size_t i = 0; i < size; i++){
+		auto x = Horner ? dst[i] : src[i];
+		auto y = Horner ? src[i] : dst[i];
+		dst[i] = t.lo[x & 0x0F] ^ t.hi[x >> 4] ^ y;
+	}
+}
+
+#ifdef CRYPTO_ALGORITHMS_X86
+
+template <bool Horner>
+CRYPTO_ALGORITHMS_TARGET("ssse3")
+size_t kernel_ssse3(std::uint8_t *dst, const std::uint8_t *src, const NibbleTables &t, size_t size){
+	const auto lo = _mm_loadu_si128((const __m128i *)t.lo);
+	const auto hi = _mm_loadu_si128((const __m128i *)t.hi);
+	const auto mask = _mm_set1_epi8(0x0F);
+	size_t ret = 0;
+	for (; size - ret >= 16; ret += 16){
+		auto d = _mm_loadu_si128((const __m128i *)(dst + ret));
+		auto s = _mm_loadu_si128((const __m128i *)(src + ret));
+		auto x = Horner ? d : s;
+		auto product = _mm_xor_si128(
+			_mm_shuffle_epi8(lo, _mm_and_si128(x, mask)),
+			_mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi16(x, 4), mask))
+		);
+		_mm_storeu_si128((__m128i *)(dst + ret), _mm_xor_si128(product, Horner ? s : d));
+	}
+	return ret;
+}
+
+template <bool Horner>
+CRYPTO_ALGORITHMS_TARGET("avx2")
+size_t kernel_avx2(std::uint8_t *dst, const std::uint8_t *src, const NibbleTables &t, size_t size){
+	const auto lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)t.lo));
+	const auto hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)t.hi));
+	const auto mask = _mm256_set1_epi8(0x0F);
+	size_t ret = 0;
+	for (; size - ret >= 32; ret += 32){
+		auto d = _mm256_loadu_si256((const __m256i *)(dst + ret));
+		auto s = _mm256_loadu_si256((const __m256i *)(src + ret));
+		auto x = Horner ? d : s;
+		auto product = _mm256_xor_si256(
+			_mm256_shuffle_epi8(lo, _mm256_and_si256(x, mask)),
+			_mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi16(x, 4), mask))
+		);
+		_mm256_storeu_si256((__m256i *)(dst + ret), _mm256_xor_si256(product, Horner ? s : d));
+	}
+	return ret;
+}
+
+#endif
+
+template <bool Horner>
+struct Kernels{
+	static constexpr auto scalar = kernel_scalar<Horner>;
+#ifdef CRYPTO_ALGORITHMS_X86
+	static constexpr auto sse_feature = &utility::cpu::Features::ssse3;
+	static constexpr auto sse = kernel_ssse3<Horner>;
+	static constexpr auto avx2 = kernel_avx2<Horner>;
+#endif
+};
+
+template <bool Horner>
+void process(std::uint8_t *dst, const std::uint8_t *src, std::uint8_t c, size_t size){
+	utility::cpu::run_kernels<Kernels<Horner>>(dst, src, NibbleTables(c), size);
+}
+
+}
+
+namespace gf256{
+
+std::uint8_t multiply(std::uint8_t a, std::uint8_t b){
+	if (!a || !b)
+		return 0;
+	return tables.exp[tables.log[a] + tables.log[b]];
+}
+
+std::uint8_t inverse(std::uint8_t a){
+	if (!a)
+		return 0;
+	return tables.exp[255 - tables.log[a]];
+}
+
+void multiply_add(std::uint8_t *dst, const std::uint8_t *src, std::uint8_t c, size_t size){
+	process<false>(dst, src, c, size);
+}
+
+void multiply_xor(std::uint8_t *dst, const std::uint8_t *src, std::uint8_t c, size_t size){
+	process<true>(dst, src, c, size);
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+//Arithmetic in GF(2^8), modulo x^8 + x^4 + x^3 + x + 1 (the AES polynomial).
+//Addition and subtraction are both XOR.
+namespace gf256{
+
+std::uint8_t multiply(std::uint8_t a, std::uint8_t b);
+//The inverse of 0 is taken to be 0.
+std::uint8_t inverse(std::uint8_t a);
+inline std::uint8_t divide(std::uint8_t a, std::uint8_t b){
+	return multiply(a, inverse(b));
+}
+
+//Bulk operations with a constant, vectorized with SSSE3 or AVX2 where the
+//processor allows, by looking up the products of the two nibbles of each
+//byte in 16-entry tables.
+
+//dst[i] ^= c * src[i]
+void multiply_add(std::uint8_t *dst, const std::uint8_t *src, std::uint8_t c, size_t size);
+//dst[i] = c * dst[i] ^ src[i], one step of Horner's rule.
+void multiply_xor(std::uint8_t *dst, const std::uint8_t *src, std::uint8_t c, size_t size);
+
+}
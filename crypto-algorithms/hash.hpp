@@ -25,10 +25,7 @@ namespace detail{
 template <typename T>
 void write_to_char_array(char (&dst)[T::string_size], const std::array<std::uint8_t, T::size> &digest){
 	dst[T::string_size - 1] = 0;
-	for (size_t i = 0; i < T::size; i++){
-		dst[i * 2 + 0] = utility::hex_digits[digest[i] >> 4];
-		dst[i * 2 + 1] = utility::hex_digits[digest[i] & 0x0F];
-	}
+	utility::hex_encode(dst, digest.data(), T::size);
 }
 
 template <typename T>
@@ -38,6 +35,46 @@ std::string to_string(const T &digest){
 	return std::string(temp, T::size * 2);
 }
 
+//Each algorithm's Midstate is a snapshot of its complete hashing state.
+//Resuming from it with load_state() continues the hash as if the data that
+//produced it had been passed to update() again.
+//A hash object holds nothing but that state, so clone() is cheap. Data that
+//many messages share as a prefix can be hashed once and the object cloned for
+//every message.
+//Midstates are serialized as the sequence of their fields, each integer in
+//little endian, so that they can be moved between machines.
+template <typename T>
+void serialize_integers(std::vector<std::uint8_t> &dst, const T *src, size_t n){
+	for (size_t i = 0; i < n; i++){
+		std::uint64_t x = src[i];
+		for (size_t j = 0; j < sizeof(T); j++){
+			dst.push_back(x & 0xFF);
+			x >>= 8;
+		}
+	}
+}
+
+template <typename T>
+const std::uint8_t *deserialize_integers(T *dst, size_t n, const std::uint8_t *src){
+	for (size_t i = 0; i < n; i++){
+		std::uint64_t x = 0;
+		for (size_t j = sizeof(T); j--;){
+			x <<= 8;
+			x |= src[j];
+		}
+		dst[i] = (T)x;
+		src += sizeof(T);
+	}
+	return src;
+}
+
+class InvalidMidstateException : public std::exception{
+public:
+	const char *what() const noexcept override{
+		return "invalid serialized hash state";
+	}
+};
+
 template <typename T>
 void write_to_char_vector(std::vector<char> &dst, const T &digest){
 	char array[T::string_size];
@@ -1,5 +1,204 @@
 #include "hex.hpp"
+#include "cpu.hpp"
+#include <algorithm>
+#ifdef CRYPTO_ALGORITHMS_X86
+#include <immintrin.h>
+#endif
 
 namespace utility{
 extern const char hex_digits[] = "0123456789abcdef";
 }
+
+namespace{
+
+//Returns the value of a hex digit, or -1.
+int hex_value(char c){
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+void encode_scalar(char *dst, const std::uint8_t *src, size_t size){
+	for (size_t i = 0; i < size; i++){
+		dst[i * 2 + 0] = utility::hex_digits[src[i] >> 4];
+		dst[i * 2 + 1] = utility::hex_digits[src[i] & 0x0F];
+	}
+}
+
+//Returns the number of bytes decoded before the first invalid digit.
+size_t decode_scalar(std::uint8_t *dst, const char *src, size_t size){
+	for (size_t i = 0; i < size; i++){
+		auto hi = hex_value(src[i * 2 + 0]);
+		auto lo = hex_value(src[i * 2 + 1]);
+		if ((hi | lo) < 0)
+			return i;
+		dst[i] = (std::uint8_t)(hi << 4 | lo);
+	}
+	return size;
+}
+
+#ifdef CRYPTO_ALGORITHMS_X86
+
+//The kernels return the number of bytes they encoded or decoded. The decoders
+//stop before the first block that contains an invalid digit, and leave it to
+//the scalar code to find it.
+
+CRYPTO_ALGORITHMS_TARGET("ssse3")
+size_t encode_ssse3(char *dst, const std::uint8_t *src, size_t size){
+	const auto digits = _mm_loadu_si128((const __m128i *)utility::hex_digits);
+	const auto mask = _mm_set1_epi8(0x0F);
+	size_t ret = 0;
+	for (; size - ret >= 16; ret += 16){
+		auto in = _mm_loadu_si128((const __m128i *)(src + ret));
+		auto hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(in, 4), mask));
+		auto lo = _mm_shuffle_epi8(digits, _mm_and_si128(in, mask));
+		_mm_storeu_si128((__m128i *)(dst + ret * 2), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(dst + ret * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+	return ret;
+}
+
+CRYPTO_ALGORITHMS_TARGET("avx2")
+size_t encode_avx2(char *dst, const std::uint8_t *src, size_t size){
+	const auto digits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)utility::hex_digits));
+	const auto mask = _mm256_set1_epi8(0x0F);
+	size_t ret = 0;
+	for (; size - ret >= 32; ret += 32){
+		auto in = _mm256_loadu_si256((const __m256i *)(src + ret));
+		auto hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(in, 4), mask));
+		auto lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(in, mask));
+		//The unpacks work within 128-bit lanes, so put the lanes back in
+		//order afterwards.
+		auto a = _mm256_unpacklo_epi8(hi, lo);
+		auto b = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((__m256i *)(dst + ret * 2), _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((__m256i *)(dst + ret * 2 + 32), _mm256_permute2x128_si256(a, b, 0x31));
+	}
+	return ret;
+}
+
+//Converts 16 digits to their values, and sets valid to all ones for the
+//bytes that were digits.
+CRYPTO_ALGORITHMS_TARGET("ssse3")
+__m128i digit_values(__m128i in, __m128i &valid){
+	auto digit = _mm_sub_epi8(in, _mm_set1_epi8('0'));
+	auto is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+	auto letter = _mm_sub_epi8(_mm_or_si128(in, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+	auto is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+	valid = _mm_or_si128(is_digit, is_letter);
+	return _mm_or_si128(
+		_mm_and_si128(is_digit, digit),
+		_mm_and_si128(is_letter, _mm_add_epi8(letter, _mm_set1_epi8(10)))
+	);
+}
+
+CRYPTO_ALGORITHMS_TARGET("ssse3")
+size_t decode_ssse3(std::uint8_t *dst, const char *src, size_t size){
+	//Each pair of digits becomes hi * 16 + lo.
+	const auto weights = _mm_set1_epi16(0x0110);
+	size_t ret = 0;
+	for (; size - ret >= 16; ret += 16){
+		__m128i valid0, valid1;
+		auto v0 = digit_values(_mm_loadu_si128((const __m128i *)(src + ret * 2)), valid0);
+		auto v1 = digit_values(_mm_loadu_si128((const __m128i *)(src + ret * 2 + 16)), valid1);
+		if (_mm_movemask_epi8(_mm_and_si128(valid0, valid1)) != 0xFFFF)
+			break;
+		auto packed = _mm_packus_epi16(_mm_maddubs_epi16(v0, weights), _mm_maddubs_epi16(v1, weights));
+		_mm_storeu_si128((__m128i *)(dst + ret), packed);
+	}
+	return ret;
+}
+
+CRYPTO_ALGORITHMS_TARGET("avx2")
+__m256i digit_values(__m256i in, __m256i &valid){
+	auto digit = _mm256_sub_epi8(in, _mm256_set1_epi8('0'));
+	auto is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+	auto letter = _mm256_sub_epi8(_mm256_or_si256(in, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+	auto is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+	valid = _mm256_or_si256(is_digit, is_letter);
+	return _mm256_or_si256(
+		_mm256_and_si256(is_digit, digit),
+		_mm256_and_si256(is_letter, _mm256_add_epi8(letter, _mm256_set1_epi8(10)))
+	);
+}
+
+CRYPTO_ALGORITHMS_TARGET("avx2")
+size_t decode_avx2(std::uint8_t *dst, const char *src, size_t size){
+	const auto weights = _mm256_set1_epi16(0x0110);
+	size_t ret = 0;
+	for (; size - ret >= 32; ret += 32){
+		__m256i valid0, valid1;
+		auto v0 = digit_values(_mm256_loadu_si256((const __m256i *)(src + ret * 2)), valid0);
+		auto v1 = digit_values(_mm256_loadu_si256((const __m256i *)(src + ret * 2 + 32)), valid1);
+		if (_mm256_movemask_epi8(_mm256_and_si256(valid0, valid1)) != -1)
+			break;
+		auto packed = _mm256_packus_epi16(_mm256_maddubs_epi16(v0, weights), _mm256_maddubs_epi16(v1, weights));
+		packed = _mm256_permute4x64_epi64(packed, 0xD8);
+		_mm256_storeu_si256((__m256i *)(dst + ret), packed);
+	}
+	return ret;
+}
+
+#endif
+
+}
+
+namespace utility{
+
+void hex_encode(char *dst, const void *vsrc, size_t size){
+	auto src = (const std::uint8_t *)vsrc;
+	size_t done = 0;
+#ifdef CRYPTO_ALGORITHMS_X86
+	auto &features = cpu::features();
+	if (features.avx2)
+		done += encode_avx2(dst, src, size);
+	if (features.ssse3)
+		done += encode_ssse3(dst + done * 2, src + done, size - done);
+#endif
+	encode_scalar(dst + done * 2, src + done, size - done);
+}
+
+bool hex_decode(void *vdst, const char *src, size_t size, size_t *error_position){
+	auto dst = (std::uint8_t *)vdst;
+	size_t done = 0;
+#ifdef CRYPTO_ALGORITHMS_X86
+	auto &features = cpu::features();
+	if (features.avx2)
+		done += decode_avx2(dst, src, size);
+	if (features.ssse3)
+		done += decode_ssse3(dst + done, src + done * 2, size - done);
+#endif
+	done += decode_scalar(dst + done, src + done * 2, size - done);
+	if (done == size)
+		return true;
+	if (error_position)
+		*error_position = done * 2 + (hex_value(src[done * 2]) < 0 ? 0 : 1);
+	return false;
+}
+
+std::vector<std::uint8_t> hex_number_to_bytes(const char *src, size_t length){
+	//Gather the digits, right-aligned to a whole number of bytes.
+	std::string digits;
+	digits.reserve(length + 1);
+	for (size_t i = 0; i < length;){
+		auto begin = i;
+		while (i < length && hex_value(src[i]) >= 0)
+			i++;
+		digits.append(src + begin, i - begin);
+		while (i < length && hex_value(src[i]) < 0)
+			i++;
+	}
+	if (digits.size() % 2)
+		digits.insert(digits.begin(), '0');
+
+	std::vector<std::uint8_t> ret(digits.size() / 2);
+	hex_decode(ret.data(), digits.data(), ret.size());
+	std::reverse(ret.begin(), ret.end());
+	return ret;
+}
+
+}
@@ -5,6 +5,7 @@
 #include <stdexcept>
 #include <array>
 #include <cstring>
+#include <string>
 #include <vector>
 
 namespace utility{
@@ -28,6 +29,21 @@ inline std::uint8_t hex2val(char c){
 	throw InvalidHexException();
 }
 
+//Bulk conversions, vectorized where the processor allows. None of them throw.
+
+//Writes the 2 * size lowercase hex digits of src to dst. Doesn't
+//null-terminate.
+void hex_encode(char *dst, const void *src, size_t size);
+//Decodes size bytes from the 2 * size hex digits, of either case, in src.
+//Returns false if any character isn't a hex digit, in which case the contents
+//of dst are unspecified, and the offset of the first such character is
+//stored in error_position, if given.
+bool hex_decode(void *dst, const char *src, size_t size, size_t *error_position = nullptr);
+//Parses a number written in hex, most significant digit first, ignoring any
+//characters that aren't hex digits, so that separators can be used freely.
+//Returns its bytes, least significant first.
+std::vector<std::uint8_t> hex_number_to_bytes(const char *src, size_t length);
+
 template <size_t N>
 std::array<std::uint8_t, N> hex_string_to_buffer(const char *s, size_t size = 0){
 	if (!size)
@@ -35,21 +51,15 @@ std::array<std::uint8_t, N> hex_string_to_buffer(const char *s, size_t size = 0)
 	if (size != N * 2)
 		throw std::runtime_error("invalid hex string");
 	std::array<std::uint8_t, N> ret;
-	for (auto &b : ret){
-		b = utility::hex2val(*(s++)) << 4;
-		b |= utility::hex2val(*(s++));
-	}
+	if (!hex_decode(ret.data(), s, N))
+		throw InvalidHexException();
 	return ret;
 }
 
-inline std::string buffer_to_hex_string(const void *vsrc, size_t size){
-	std::string ret;
-	ret.reserve(size * 2);
-	auto src = (const std::uint8_t *)vsrc;
-	for (size_t i = 0; i < size; i++){
-		ret += hex_digits[src[i] >> 4];
-		ret += hex_digits[src[i] & 0xF];
-	}
+inline std::string buffer_to_hex_string(const void *src, size_t size){
+	std::string ret(size * 2, 0);
+	if (size)
+		hex_encode(&ret[0], src, size);
 	return ret;
 }
 
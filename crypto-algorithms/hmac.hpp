@@ -0,0 +1,208 @@
+#pragma once
+
+#include "hash.hpp"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+
+namespace hash{
+
+template <typename Algorithm>
+class HMAC : public algorithm::HashAlgorithm{
+public:
+	static const size_t block_size = Algorithm::block_size;
+	typedef typename Algorithm::digest_type digest_type;
+private:
+	//Hash states right after processing the key XORed with ipad and opad,
+	//respectively. Every MAC resumes from copies of these, so the key is only
+	//ever hashed once.
+	Algorithm inner_midstate;
+	Algorithm outer_midstate;
+	Algorithm inner;
+
+	void set_key(const void *key, size_t size){
+		std::uint8_t pad[block_size] = {};
+		if (size > block_size){
+			auto digest = Algorithm::compute(key, size);
+			memcpy(pad, digest.to_array().data(), digest_type::size);
+		}else if (size)
+			memcpy(pad, key, size);
+
+		for (auto &b : pad)
+			b ^= 0x36;
+		this->inner_midstate.reset();
+		this->inner_midstate.update(pad, block_size);
+
+		for (auto &b : pad)
+			b ^= 0x36 ^ 0x5C;
+		this->outer_midstate.reset();
+		this->outer_midstate.update(pad, block_size);
+
+		memset(pad, 0, sizeof(pad));
+		this->inner = this->inner_midstate;
+	}
+	digest_type finish(Algorithm &inner) const{
+		auto digest = inner.get_digest();
+		auto outer = this->outer_midstate;
+		outer.update(digest.to_array().data(), digest_type::size);
+		return outer.get_digest();
+	}
+public:
+	HMAC(const void *key, size_t size){
+		this->set_key(key, size);
+	}
+	HMAC(const std::string &key): HMAC(key.data(), key.size()){}
+	HMAC(const std::vector<std::uint8_t> &key): HMAC(key.data(), key.size()){}
+	HMAC(const HMAC &) = default;
+	HMAC &operator=(const HMAC &) = default;
+	void reset() noexcept override{
+		this->inner = this->inner_midstate;
+	}
+	void update(const void *buffer, size_t length) noexcept override{
+		this->inner.update(buffer, length);
+	}
+	//Returns the MAC of all the data passed to update() since the last reset,
+	//and resets the object so that it can be reused with the same key.
+	digest_type get_digest() noexcept{
+		auto ret = this->finish(this->inner);
+		this->reset();
+		return ret;
+	}
+	//Computes the MAC of a single message without touching the incremental
+	//state.
+	digest_type compute(const void *buffer, size_t length) const noexcept{
+		auto inner = this->inner_midstate;
+		inner.update(buffer, length);
+		return this->finish(inner);
+	}
+	digest_type compute(const std::string &input) const noexcept{
+		return this->compute(input.data(), input.size());
+	}
+	static digest_type compute(const void *key, size_t key_size, const void *buffer, size_t length){
+		return HMAC(key, key_size).compute(buffer, length);
+	}
+	static digest_type compute(const std::string &key, const std::string &input){
+		return HMAC(key).compute(input);
+	}
+};
+
+template <typename Algorithm>
+class HKDF{
+public:
+	typedef typename Algorithm::digest_type digest_type;
+	static const size_t max_output_size = digest_type::size * 255;
+private:
+	HMAC<Algorithm> prk;
+public:
+	//Performs the extract step. An empty salt is equivalent to a salt of
+	//digest_type::size zeroes.
+	HKDF(const void *salt, size_t salt_size, const void *ikm, size_t ikm_size)
+		: HKDF(HMAC<Algorithm>::compute(salt, salt_size, ikm, ikm_size)){}
+	//Skips the extract step and uses an existing pseudorandom key.
+	HKDF(const digest_type &prk): prk(prk.to_array().data(), digest_type::size){}
+	HKDF(const HKDF &) = default;
+	HKDF &operator=(const HKDF &) = default;
+	void expand(void *void_dst, size_t size, const void *info, size_t info_size) const{
+		if (size > max_output_size)
+			throw std::runtime_error("requested HKDF output is too long");
+		auto dst = (std::uint8_t *)void_dst;
+		typename digest_type::digest_t t;
+		for (std::uint8_t i = 1; size; i++){
+			auto mac = this->prk;
+			if (i > 1)
+				mac.update(t.data(), t.size());
+			mac.update(info, info_size);
+			mac.update(&i, 1);
+			t = mac.get_digest().to_array();
+			auto n = std::min(size, t.size());
+			memcpy(dst, t.data(), n);
+			dst += n;
+			size -= n;
+		}
+	}
+	std::vector<std::uint8_t> expand(size_t size, const void *info = nullptr, size_t info_size = 0) const{
+		std::vector<std::uint8_t> ret(size);
+		this->expand(ret.data(), size, info, info_size);
+		return ret;
+	}
+	std::vector<std::uint8_t> expand(size_t size, const std::string &info) const{
+		return this->expand(size, info.data(), info.size());
+	}
+	static std::vector<std::uint8_t> derive(const std::string &salt, const std::string &ikm, const std::string &info, size_t size){
+		return HKDF(salt.data(), salt.size(), ikm.data(), ikm.size()).expand(size, info);
+	}
+};
+
+template <typename Algorithm>
+class PBKDF2{
+public:
+	typedef typename Algorithm::digest_type digest_type;
+private:
+	typedef typename digest_type::digest_t block_t;
+	HMAC<Algorithm> prf;
+
+	block_t compute_block(const void *salt, size_t salt_size, std::uint32_t iterations, std::uint32_t index) const{
+		auto mac = this->prf;
+		mac.update(salt, salt_size);
+		std::uint8_t be_index[] = {
+			(std::uint8_t)(index >> 24),
+			(std::uint8_t)(index >> 16),
+			(std::uint8_t)(index >> 8),
+			(std::uint8_t)index,
+		};
+		mac.update(be_index, sizeof(be_index));
+		auto u = mac.get_digest().to_array();
+		auto ret = u;
+		for (std::uint32_t i = 1; i < iterations; i++){
+			u = this->prf.compute(u.data(), u.size()).to_array();
+			for (size_t j = 0; j < ret.size(); j++)
+				ret[j] ^= u[j];
+		}
+		return ret;
+	}
+public:
+	PBKDF2(const void *password, size_t size): prf(password, size){}
+	PBKDF2(const std::string &password): prf(password){}
+	PBKDF2(const PBKDF2 &) = default;
+	PBKDF2 &operator=(const PBKDF2 &) = default;
+	//Output blocks are independent of each other, so when the requested size
+	//spans more than one digest, they can be computed in parallel. Passing 0
+	//threads uses one thread per hardware thread.
+	void derive(void *void_dst, size_t size, const void *salt, size_t salt_size, std::uint32_t iterations, unsigned threads = 1) const{
+		if (!iterations)
+			throw std::runtime_error("invalid parameters");
+		const size_t hlen = digest_type::size;
+		const auto blocks = (size + hlen - 1) / hlen;
+		if (blocks > 0xFFFFFFFF)
+			throw std::runtime_error("requested PBKDF2 output is too long");
+		if (!threads)
+			threads = std::max(std::thread::hardware_concurrency(), 1U);
+		threads = (unsigned)std::min<size_t>(threads, blocks);
+
+		auto dst = (std::uint8_t *)void_dst;
+		auto worker = [&](size_t first){
+			for (auto i = first; i < blocks; i += std::max(threads, 1U)){
+				auto block = this->compute_block(salt, salt_size, iterations, (std::uint32_t)(i + 1));
+				memcpy(dst + i * hlen, block.data(), std::min(hlen, size - i * hlen));
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (unsigned i = 1; i < threads; i++)
+			workers.emplace_back(worker, i);
+		worker(0);
+		for (auto &t : workers)
+			t.join();
+	}
+	std::vector<std::uint8_t> derive(size_t size, const std::string &salt, std::uint32_t iterations, unsigned threads = 1) const{
+		std::vector<std::uint8_t> ret(size);
+		this->derive(ret.data(), size, salt.data(), salt.size(), iterations, threads);
+		return ret;
+	}
+};
+
+}
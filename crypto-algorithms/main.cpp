@@ -2,14 +2,20 @@
 #include "test_sha1.hpp"
 #include "test_sha256.hpp"
 #include "test_sha512.hpp"
+#include "test_hmac.hpp"
 #include "test_aes.hpp"
 #include "test_twofish.hpp"
 #include "test_secp256k1.hpp"
 #include "test_bignum.hpp"
+#include "test_ringbuffer.hpp"
 #include "test_stream.hpp"
+#include "test_mapped_file.hpp"
 #include "test_cbc.hpp"
 #include "test_rng.hpp"
+#include "test_chacha20.hpp"
+#include "test_aead.hpp"
 #include "test_base64.hpp"
+#include "test_hex.hpp"
 #include "test_shamir.hpp"
 #include "test_ed25519.hpp"
 #include <iostream>
@@ -23,14 +29,20 @@ int main(){
 		test_sha1();
 		test_sha256();
 		test_sha512();
+		test_hmac();
 		test_aes();
 		test_twofish();
+		test_ringbuffer();
 		test_stream();
+		test_mapped_file();
 		test_cbc();
 		test_rng();
+		test_chacha20();
+		test_aead();
 		test_secp256k1();
 		test_ed25519();
 		test_base64();
+		test_hex();
 		test_shamir();
 	}catch (std::exception &e){
 		std::cerr << e.what() << std::endl;
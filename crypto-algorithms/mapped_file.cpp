@@ -0,0 +1,298 @@
+#include "mapped_file.hpp"
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace{
+
+[[noreturn]] void throw_file_error(const char *what, const std::filesystem::path &path){
+	throw std::runtime_error((std::string)what + ": " + path.string());
+}
+
+[[noreturn]] void throw_file_error(const char *what){
+	throw std::runtime_error(what);
+}
+
+void advise(const void *mapping, size_t size, const utility::MappingHints &hints){
+	//All hints are best effort. Failure just means the OS ignores them.
+#ifdef _WIN32
+	if (hints.will_need){
+		WIN32_MEMORY_RANGE_ENTRY range = { (void *)mapping, size };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+#else
+	auto p = (void *)mapping;
+	if (hints.sequential)
+		madvise(p, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+	if (hints.huge_pages)
+		madvise(p, size, MADV_HUGEPAGE);
+#endif
+	if (hints.will_need)
+		madvise(p, size, MADV_WILLNEED);
+#endif
+}
+
+const size_t minimum_sink_capacity = 1 << 20;
+
+#ifdef _WIN32
+const utility::detail::file_handle_t invalid_file = INVALID_HANDLE_VALUE;
+#else
+const utility::detail::file_handle_t invalid_file = -1;
+#endif
+
+}
+
+namespace utility{
+
+MappedFileSource::MappedFileSource(const std::filesystem::path &path, const MappingHints &hints){
+#ifdef _WIN32
+	auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, hints.sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw_file_error("failed to open file", path);
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)){
+		CloseHandle(file);
+		throw_file_error("failed to get file size", path);
+	}
+	if ((std::uint64_t)size.QuadPart > std::numeric_limits<size_t>::max()){
+		CloseHandle(file);
+		throw_file_error("file is too large to map", path);
+	}
+	this->mapping_size = (size_t)size.QuadPart;
+	if (this->mapping_size){
+		auto file_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (file_mapping)
+			this->mapping = (const std::uint8_t *)MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+		//The view keeps its own reference to the file.
+		if (file_mapping)
+			CloseHandle(file_mapping);
+	}
+	CloseHandle(file);
+#else
+	auto file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		throw_file_error("failed to open file", path);
+	struct stat st;
+	if (fstat(file, &st) < 0){
+		::close(file);
+		throw_file_error("failed to get file size", path);
+	}
+	if ((std::uint64_t)st.st_size > std::numeric_limits<size_t>::max()){
+		::close(file);
+		throw_file_error("file is too large to map", path);
+	}
+	this->mapping_size = (size_t)st.st_size;
+	if (this->mapping_size){
+		auto p = mmap(nullptr, this->mapping_size, PROT_READ, MAP_SHARED, file, 0);
+		if (p != MAP_FAILED)
+			this->mapping = (const std::uint8_t *)p;
+	}
+	//The mapping keeps its own reference to the file.
+	::close(file);
+#endif
+	if (this->mapping_size && !this->mapping)
+		throw_file_error("failed to map file", path);
+	if (this->mapping)
+		advise(this->mapping, this->mapping_size, hints);
+}
+
+MappedFileSource &MappedFileSource::operator=(MappedFileSource &&other){
+	this->unmap();
+	this->mapping = std::exchange(other.mapping, nullptr);
+	this->mapping_size = std::exchange(other.mapping_size, 0);
+	this->offset = std::exchange(other.offset, 0);
+	return *this;
+}
+
+MappedFileSource::~MappedFileSource(){
+	this->unmap();
+}
+
+void MappedFileSource::unmap(){
+	if (!this->mapping)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(this->mapping);
+#else
+	munmap((void *)this->mapping, this->mapping_size);
+#endif
+	this->mapping = nullptr;
+	this->mapping_size = 0;
+	this->offset = 0;
+}
+
+size_t MappedFileSource::read(void *dst, size_t size){
+	size = std::min(size, this->size());
+	if (size)
+		memcpy(dst, this->data(), size);
+	this->offset += size;
+	return size;
+}
+
+DataSource &MappedFileSource::operator>>(DataSink &sink){
+	while (this->size()){
+		auto written = sink.write(this->data(), this->size());
+		if (!written)
+			break;
+		this->offset += written;
+	}
+	return *this;
+}
+
+MappedFileSink::MappedFileSink(): file(invalid_file){}
+
+MappedFileSink::MappedFileSink(const std::filesystem::path &path, const MappingHints &hints, size_t expected_size)
+		: hints(hints){
+#ifdef _WIN32
+	this->file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr);
+#else
+	this->file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+#endif
+	if (this->file == invalid_file)
+		throw_file_error("failed to open file", path);
+	if (expected_size){
+		try{
+			this->reserve(expected_size);
+		}catch (std::exception &){
+			this->close();
+			throw;
+		}
+	}
+}
+
+MappedFileSink &MappedFileSink::operator=(MappedFileSink &&other){
+	this->close();
+	this->file = std::exchange(other.file, invalid_file);
+#ifdef _WIN32
+	this->file_mapping = std::exchange(other.file_mapping, nullptr);
+#endif
+	this->mapping = std::exchange(other.mapping, nullptr);
+	this->capacity = std::exchange(other.capacity, 0);
+	this->length = std::exchange(other.length, 0);
+	this->hints = other.hints;
+	return *this;
+}
+
+MappedFileSink::~MappedFileSink(){
+	try{
+		this->close();
+	}catch (std::exception &){}
+}
+
+//Replaces the current mapping, if any, with one of the given capacity. The new
+//mapping is set up before the old one is dropped, so that if that fails the
+//sink is left as it was.
+void MappedFileSink::map(size_t capacity){
+#ifdef _WIN32
+	auto size = (std::uint64_t)capacity;
+	auto file_mapping = CreateFileMappingW(this->file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+	if (!file_mapping)
+		throw_file_error("failed to map file");
+	auto mapping = (std::uint8_t *)MapViewOfFile(file_mapping, FILE_MAP_WRITE, 0, 0, capacity);
+	if (!mapping){
+		CloseHandle(file_mapping);
+		throw_file_error("failed to map file");
+	}
+	this->unmap();
+	this->file_mapping = file_mapping;
+#else
+	if (ftruncate(this->file, (off_t)capacity) < 0)
+		throw_file_error("failed to resize file");
+	auto p = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, this->file, 0);
+	if (p == MAP_FAILED)
+		throw_file_error("failed to map file");
+	auto mapping = (std::uint8_t *)p;
+	this->unmap();
+#endif
+	this->mapping = mapping;
+	this->capacity = capacity;
+	advise(this->mapping, this->capacity, this->hints);
+}
+
+void MappedFileSink::unmap(){
+	if (!this->mapping)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(this->mapping);
+	CloseHandle(this->file_mapping);
+	this->file_mapping = nullptr;
+#else
+	munmap(this->mapping, this->capacity);
+#endif
+	this->mapping = nullptr;
+	this->capacity = 0;
+}
+
+void MappedFileSink::reserve(size_t size){
+	if (size <= this->capacity)
+		return;
+	if (this->file == invalid_file)
+		throw_file_error("file is not open");
+	auto new_capacity = std::max(this->capacity, minimum_sink_capacity);
+	while (new_capacity < size)
+		new_capacity *= 2;
+	this->map(new_capacity);
+}
+
+size_t MappedFileSink::write(const void *src, size_t size){
+	auto dst = this->prepare(size);
+	if (size)
+		memcpy(dst, src, size);
+	this->commit(size);
+	return size;
+}
+
+std::uint8_t *MappedFileSink::prepare(size_t size){
+	this->reserve(this->length + size);
+	return this->mapping + this->length;
+}
+
+void MappedFileSink::commit(size_t size){
+	this->length += std::min(size, this->capacity - this->length);
+}
+
+void MappedFileSink::flush(){
+	if (!this->mapping)
+		return;
+#ifdef _WIN32
+	FlushViewOfFile(this->mapping, this->length);
+#else
+	msync(this->mapping, this->length, MS_SYNC);
+#endif
+}
+
+void MappedFileSink::close(){
+	if (this->file == invalid_file)
+		return;
+	this->unmap();
+	//Drop the slack left over from growing the mapping.
+#ifdef _WIN32
+	LARGE_INTEGER size;
+	size.QuadPart = (LONGLONG)this->length;
+	auto ok = SetFilePointerEx(this->file, size, nullptr, FILE_BEGIN) && SetEndOfFile(this->file);
+	CloseHandle(this->file);
+#else
+	auto ok = ftruncate(this->file, (off_t)this->length) == 0;
+	::close(this->file);
+#endif
+	this->file = invalid_file;
+	this->length = 0;
+	if (!ok)
+		throw_file_error("failed to resize file");
+}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "source_sink.hpp"
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+
+namespace utility{
+
+struct MappingHints{
+	//The file will be processed front to back, so the OS can read ahead
+	//aggressively and drop pages that have already been consumed.
+	bool sequential = true;
+	//Back the mapping with huge pages where the OS and file system support
+	//it, to cut down on TLB misses over very large files.
+	bool huge_pages = false;
+	//Start paging in the whole file right away.
+	bool will_need = false;
+};
+
+namespace detail{
+
+#ifdef _WIN32
+typedef void *file_handle_t;
+#else
+typedef int file_handle_t;
+#endif
+
+}
+
+//Maps a whole file into memory. read() still copies, to satisfy the
+//DataSource interface, but data()/size() expose the unread part of the
+//mapping so that hashes, ciphers and encoders can run directly over it, and
+//operator>>() hands the mapping to the sink without an intermediate buffer.
+class MappedFileSource : public DataSource{
+	const std::uint8_t *mapping = nullptr;
+	size_t mapping_size = 0;
+	size_t offset = 0;
+
+	void unmap();
+public:
+	MappedFileSource() = default;
+	MappedFileSource(const std::filesystem::path &path, const MappingHints &hints = {});
+	MappedFileSource(const MappedFileSource &) = delete;
+	MappedFileSource &operator=(const MappedFileSource &) = delete;
+	MappedFileSource(MappedFileSource &&other){
+		*this = std::move(other);
+	}
+	MappedFileSource &operator=(MappedFileSource &&other);
+	~MappedFileSource();
+	size_t read(void *dst, size_t size) override;
+	std::optional<size_t> available() const override{
+		return this->size();
+	}
+	DataSource &operator>>(DataSink &) override;
+	const std::uint8_t *data() const{
+		return this->mapping + this->offset;
+	}
+	size_t size() const{
+		return this->mapping_size - this->offset;
+	}
+	void skip(size_t size){
+		this->offset += std::min(size, this->size());
+	}
+};
+
+//Writes a file through a memory mapping that grows as needed. The file is
+//truncated to the amount of data actually written when the sink is closed or
+//destroyed. Producers that can generate their output in place can use
+//prepare()/commit() to write straight into the mapping.
+class MappedFileSink : public DataSink{
+	detail::file_handle_t file;
+#ifdef _WIN32
+	void *file_mapping = nullptr;
+#endif
+	std::uint8_t *mapping = nullptr;
+	size_t capacity = 0;
+	size_t length = 0;
+	MappingHints hints;
+
+	void map(size_t capacity);
+	void unmap();
+	void reserve(size_t size);
+public:
+	MappedFileSink();
+	MappedFileSink(const std::filesystem::path &path, const MappingHints &hints = {}, size_t expected_size = 0);
+	MappedFileSink(const MappedFileSink &) = delete;
+	MappedFileSink &operator=(const MappedFileSink &) = delete;
+	MappedFileSink(MappedFileSink &&other): MappedFileSink(){
+		*this = std::move(other);
+	}
+	MappedFileSink &operator=(MappedFileSink &&other);
+	~MappedFileSink();
+	size_t write(const void *src, size_t size) override;
+	void flush() override;
+	//Returns a pointer to at least size writable bytes past the end of the
+	//data written so far. The pointer is invalidated by the next call to
+	//prepare(), write() or close().
+	std::uint8_t *prepare(size_t size);
+	//Appends size bytes, previously filled in through prepare(), to the file.
+	void commit(size_t size);
+	size_t get_length() const{
+		return this->length;
+	}
+	void close();
+};
+
+}
@@ -227,6 +227,46 @@ digest::MD5 MD5::get_digest() noexcept{
 	return ret;
 }
 
+MD5::Midstate MD5::save_state() const noexcept{
+	Midstate ret;
+	memcpy(ret.state, this->state, sizeof(this->state));
+	ret.bitlen = this->bitlen;
+	ret.datalen = this->datalen;
+	memcpy(ret.data, this->data, sizeof(this->data));
+	return ret;
+}
+
+void MD5::load_state(const Midstate &state) noexcept{
+	memcpy(this->state, state.state, sizeof(this->state));
+	this->bitlen = state.bitlen;
+	this->datalen = state.datalen;
+	memcpy(this->data, state.data, sizeof(this->data));
+}
+
+std::vector<std::uint8_t> MD5::Midstate::serialize() const{
+	std::vector<std::uint8_t> ret;
+	ret.reserve(serialized_size);
+	detail::serialize_integers(ret, this->state, 4);
+	detail::serialize_integers(ret, &this->bitlen, 1);
+	detail::serialize_integers(ret, &this->datalen, 1);
+	detail::serialize_integers(ret, this->data, sizeof(this->data));
+	return ret;
+}
+
+MD5::Midstate MD5::Midstate::deserialize(const void *buffer, size_t size){
+	if (size != serialized_size)
+		throw detail::InvalidMidstateException();
+	Midstate ret;
+	auto src = (const std::uint8_t *)buffer;
+	src = detail::deserialize_integers(ret.state, 4, src);
+	src = detail::deserialize_integers(&ret.bitlen, 1, src);
+	src = detail::deserialize_integers(&ret.datalen, 1, src);
+	detail::deserialize_integers(ret.data, sizeof(ret.data), src);
+	if (ret.datalen >= sizeof(ret.data) || ret.bitlen % 512)
+		throw detail::InvalidMidstateException();
+	return ret;
+}
+
 }
 
 }
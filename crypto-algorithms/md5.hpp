@@ -6,6 +6,7 @@
 #include <array>
 #include <string>
 #include <vector>
+#include <type_traits>
 #include <sstream>
 
 namespace hash{
@@ -78,6 +79,21 @@ class MD5 : public HashAlgorithm{
 	
 	void transform() noexcept;
 public:
+	static const size_t block_size = 64;
+	typedef digest::MD5 digest_type;
+
+	//Snapshot of the hashing state (see hash.hpp).
+	struct Midstate{
+		std::uint32_t state[4];
+		std::uint64_t bitlen;
+		std::uint32_t datalen;
+		std::uint8_t data[64];
+		static const size_t serialized_size = sizeof(state) + sizeof(bitlen) + sizeof(datalen) + sizeof(data);
+		std::vector<std::uint8_t> serialize() const;
+		static Midstate deserialize(const void *, size_t);
+	};
+	static_assert(std::is_trivially_copyable<Midstate>::value, "Midstate must be trivially copyable");
+
 	MD5(){
 		this->MD5::reset();
 	}
@@ -86,6 +102,12 @@ public:
 	void reset() noexcept override;
 	void update(const void *buffer, size_t length) noexcept override;
 	digest::MD5 get_digest() noexcept;
+	Midstate save_state() const noexcept;
+	void load_state(const Midstate &) noexcept;
+	//See hash.hpp.
+	MD5 clone() const noexcept{
+		return *this;
+	}
 	static digest::MD5 compute(const void *buffer, size_t length) noexcept{
 		MD5 hash;
 		hash.update(buffer, length);
@@ -0,0 +1,148 @@
+#include "mirrored_ringbuffer.hpp"
+#include <stdexcept>
+#include <utility>
+#include <new>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include <atomic>
+#endif
+
+namespace{
+
+size_t allocation_granularity(){
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+#else
+	return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+size_t round_capacity(size_t capacity){
+	size_t ret = allocation_granularity();
+	while (ret < capacity){
+		if (ret > std::numeric_limits<size_t>::max() / 4)
+			throw std::bad_alloc();
+		ret *= 2;
+	}
+	return ret;
+}
+
+#ifndef _WIN32
+
+int create_shared_memory(size_t size){
+#ifdef __linux__
+	auto fd = memfd_create("MirroredRingBuffer", MFD_CLOEXEC);
+#else
+	static std::atomic<unsigned> counter;
+	auto name = "/MirroredRingBuffer." + std::to_string(getpid()) + "." + std::to_string(counter++);
+	auto fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd >= 0)
+		shm_unlink(name.c_str());
+#endif
+	if (fd < 0)
+		return fd;
+	if (ftruncate(fd, (off_t)size) < 0){
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+#endif
+
+}
+
+namespace utility{
+
+MirroredRingBuffer::MirroredRingBuffer(size_t capacity){
+	capacity = round_capacity(capacity);
+#ifdef _WIN32
+	auto size = (std::uint64_t)capacity;
+	//There's no way to atomically reserve an address range and map a view
+	//into it without the newer placeholder APIs, so find a free range and
+	//race other threads for it, retrying if someone else takes it first.
+	for (int attempt = 0; attempt < 16 && !this->data; attempt++){
+		auto section = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+		if (!section)
+			break;
+		auto base = (std::uint8_t *)VirtualAlloc(nullptr, capacity * 2, MEM_RESERVE, PAGE_NOACCESS);
+		if (!base){
+			CloseHandle(section);
+			break;
+		}
+		VirtualFree(base, 0, MEM_RELEASE);
+		auto first = MapViewOfFileEx(section, FILE_MAP_ALL_ACCESS, 0, 0, capacity, base);
+		auto second = first ? MapViewOfFileEx(section, FILE_MAP_ALL_ACCESS, 0, 0, capacity, base + capacity) : nullptr;
+		if (first && second){
+			this->data = base;
+			this->section = section;
+			break;
+		}
+		if (first)
+			UnmapViewOfFile(first);
+		CloseHandle(section);
+	}
+#else
+	auto fd = create_shared_memory(capacity);
+	if (fd >= 0){
+		auto base = mmap(nullptr, capacity * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base != MAP_FAILED){
+			auto first = mmap(base, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+			auto second = mmap((std::uint8_t *)base + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+			if (first != MAP_FAILED && second != MAP_FAILED)
+				this->data = (std::uint8_t *)base;
+			else
+				munmap(base, capacity * 2);
+		}
+		//The mappings keep their own reference to the memory.
+		close(fd);
+	}
+#endif
+	if (!this->data)
+		throw std::runtime_error("failed to create mirrored ring buffer");
+	this->capacity = capacity;
+	this->mask = capacity - 1;
+}
+
+MirroredRingBuffer &MirroredRingBuffer::operator=(MirroredRingBuffer &&other){
+	this->release();
+	this->data = std::exchange(other.data, nullptr);
+	this->capacity = std::exchange(other.capacity, 0);
+	this->mask = std::exchange(other.mask, 0);
+	this->head = std::exchange(other.head, 0);
+	this->tail = std::exchange(other.tail, 0);
+#ifdef _WIN32
+	this->section = std::exchange(other.section, nullptr);
+#endif
+	return *this;
+}
+
+MirroredRingBuffer::~MirroredRingBuffer(){
+	this->release();
+}
+
+void MirroredRingBuffer::release(){
+	if (!this->data)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(this->data);
+	UnmapViewOfFile(this->data + this->capacity);
+	CloseHandle(this->section);
+	this->section = nullptr;
+#else
+	munmap(this->data, this->capacity * 2);
+#endif
+	this->data = nullptr;
+	this->capacity = this->mask = this->head = this->tail = 0;
+}
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "ringbuffer.hpp"
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace utility{
+
+//A ring buffer whose storage is mapped twice, back to back, in virtual
+//memory, so that reading or writing past the end of the first mapping lands
+//at the start of the buffer. Every readable or writable region is therefore a
+//single contiguous span, and consumers never have to deal with blocks
+//straddling the wrap-around point. The capacity is always a power of two, so
+//positions are computed with a mask instead of a division.
+//Has the same interface as RingBuffer, so it can be used in its place.
+class MirroredRingBuffer{
+	std::uint8_t *data = nullptr;
+	size_t capacity = 0;
+	size_t mask = 0;
+	//Free-running counters. Only their difference and their low bits matter,
+	//so they're allowed to overflow.
+	size_t head = 0;
+	size_t tail = 0;
+#ifdef _WIN32
+	void *section = nullptr;
+#endif
+
+	void release();
+public:
+	MirroredRingBuffer() = default;
+	//The capacity is rounded up to a power of two that's also a multiple of
+	//the OS's allocation granularity.
+	explicit MirroredRingBuffer(size_t capacity);
+	MirroredRingBuffer(const MirroredRingBuffer &) = delete;
+	MirroredRingBuffer &operator=(const MirroredRingBuffer &) = delete;
+	MirroredRingBuffer(MirroredRingBuffer &&other){
+		*this = std::move(other);
+	}
+	MirroredRingBuffer &operator=(MirroredRingBuffer &&other);
+	~MirroredRingBuffer();
+	ConstSpan readable() const{
+		return { this->data + (this->head & this->mask), this->tail - this->head };
+	}
+	Span writable(){
+		return { this->data + (this->tail & this->mask), this->free() };
+	}
+	//Same as in RingBuffer, but the second span is always empty.
+	std::array<ConstSpan, 2> peek_readable() const{
+		return { this->readable(), ConstSpan() };
+	}
+	std::array<Span, 2> prepare_writable(){
+		return { this->writable(), Span() };
+	}
+	void consume(size_t size){
+		this->head += std::min(size, this->get_length());
+	}
+	void commit(size_t size){
+		this->tail += std::min(size, this->free());
+	}
+	size_t write(const void *src, size_t size){
+		auto span = this->writable();
+		size = std::min(size, span.size);
+		if (size)
+			memcpy(span.data, src, size);
+		this->tail += size;
+		return size;
+	}
+	size_t read(void *dst, size_t size){
+		auto span = this->readable();
+		size = std::min(size, span.size);
+		if (size)
+			memcpy(dst, span.data, size);
+		this->head += size;
+		return size;
+	}
+	template <typename Hash>
+	void update_hash(Hash &hash){
+		auto span = this->readable();
+		hash.update(span.data, span.size);
+	}
+	size_t write_to_sink(DataSink &sink, size_t max_bytes = std::numeric_limits<size_t>::max()){
+		auto span = this->readable();
+		auto size = std::min(span.size, max_bytes);
+		if (size)
+			sink.write(span.data, size);
+		this->head += size;
+		return size;
+	}
+	size_t read_from_source(DataSource &source, size_t max_bytes = std::numeric_limits<size_t>::max()){
+		size_t ret = 0;
+		while (true){
+			auto span = this->writable();
+			auto size = std::min(span.size, max_bytes - ret);
+			if (!size)
+				break;
+			auto read = source.read(span.data, size);
+			if (!read)
+				break;
+			this->tail += read;
+			ret += read;
+		}
+		return ret;
+	}
+	size_t free() const{
+		return this->capacity - this->get_length();
+	}
+	size_t get_length() const{
+		return this->tail - this->head;
+	}
+	size_t get_capacity() const{
+		return this->capacity;
+	}
+};
+
+}
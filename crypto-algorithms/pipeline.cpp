@@ -0,0 +1,224 @@
+#include "pipeline.hpp"
+#include "spsc_ringbuffer.hpp"
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace{
+
+typedef std::chrono::steady_clock clock_type;
+typedef utility::Pipeline::StageStatistics StageStatistics;
+
+double seconds_since(clock_type::time_point start){
+	return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+//Adds the time spent in a scope to a counter.
+class BusyTimer{
+	double *total;
+	clock_type::time_point start;
+public:
+	BusyTimer(double &total): total(&total), start(clock_type::now()){}
+	BusyTimer(const BusyTimer &) = delete;
+	BusyTimer &operator=(const BusyTimer &) = delete;
+	~BusyTimer(){
+		*this->total += seconds_since(this->start);
+	}
+};
+
+//State shared by all the workers of one run.
+class Execution{
+	std::atomic<bool> failed{false};
+	std::mutex mutex;
+	std::exception_ptr exception;
+	clock_type::time_point start = clock_type::now();
+public:
+	void fail(std::exception_ptr e){
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (!this->exception)
+			this->exception = e;
+		this->failed.store(true);
+	}
+	bool has_failed() const{
+		return this->failed.load();
+	}
+	double elapsed() const{
+		return seconds_since(this->start);
+	}
+	void rethrow(){
+		if (this->exception)
+			std::rethrow_exception(this->exception);
+	}
+};
+
+//Once the pipeline has failed, every worker throws away whatever is still
+//arriving, so that nothing upstream stays blocked on a full queue.
+void discard(utility::SpscRingBuffer &input){
+	while (input.wait_for_data(1))
+		input.consume(input.get_length());
+}
+
+void run_source(utility::DataSource &source, utility::SpscRingBuffer &output, StageStatistics &statistics, Execution &execution){
+	//Don't wake up for every byte the next stage frees.
+	const auto batch = std::max<size_t>(output.get_capacity() / 4, 1);
+	try{
+		while (!execution.has_failed()){
+			output.wait_for_free(batch);
+			size_t read;
+			{
+				BusyTimer timer(statistics.busy_seconds);
+				read = output.read_from_source(source);
+			}
+			if (!read)
+				break;
+			statistics.bytes_out += read;
+		}
+	}catch (...){
+		execution.fail(std::current_exception());
+	}
+	output.close();
+	statistics.wall_seconds = execution.elapsed();
+}
+
+//Moves everything the stage has ready into output, blocking while output is
+//full. Returns the number of bytes moved.
+template <typename Stage>
+size_t drain_stage(Stage &stage, utility::SpscRingBuffer &output, StageStatistics &statistics){
+	size_t ret = 0;
+	while (true){
+		auto available = stage.source->available();
+		if (available && !*available)
+			break;
+		output.wait_for_free(1);
+		size_t moved = 0;
+		bool done = false;
+		{
+			BusyTimer timer(statistics.busy_seconds);
+			for (auto &span : output.prepare_writable()){
+				if (!span.size)
+					continue;
+				auto read = stage.source->read(span.data, span.size);
+				moved += read;
+				if (read < span.size){
+					done = true;
+					break;
+				}
+			}
+		}
+		output.commit(moved);
+		statistics.bytes_out += moved;
+		ret += moved;
+		if (done)
+			break;
+	}
+	return ret;
+}
+
+template <typename Stage>
+void run_stage(Stage &stage, utility::SpscRingBuffer &input, utility::SpscRingBuffer &output, StageStatistics &statistics, Execution &execution){
+	try{
+		while (!execution.has_failed() && input.wait_for_data(1)){
+			for (auto &span : input.peek_readable()){
+				size_t offset = 0;
+				while (offset < span.size){
+					size_t written;
+					{
+						BusyTimer timer(statistics.busy_seconds);
+						written = stage.sink->write(span.data + offset, span.size - offset);
+					}
+					offset += written;
+					//The stage only refuses input when its output is full.
+					if (!drain_stage(stage, output, statistics) && !written)
+						throw std::runtime_error("pipeline stage " + stage.name + " stopped accepting data");
+				}
+				input.consume(span.size);
+				statistics.bytes_in += span.size;
+			}
+		}
+		if (!execution.has_failed()){
+			{
+				BusyTimer timer(statistics.busy_seconds);
+				stage.terminate();
+			}
+			drain_stage(stage, output, statistics);
+		}
+	}catch (...){
+		execution.fail(std::current_exception());
+	}
+	if (execution.has_failed())
+		discard(input);
+	output.close();
+	statistics.wall_seconds = execution.elapsed();
+}
+
+void run_sink(utility::DataSink &sink, utility::SpscRingBuffer &input, StageStatistics &statistics, Execution &execution){
+	try{
+		while (!execution.has_failed() && input.wait_for_data(1)){
+			BusyTimer timer(statistics.busy_seconds);
+			statistics.bytes_in += input.write_to_sink(sink);
+		}
+		if (!execution.has_failed()){
+			BusyTimer timer(statistics.busy_seconds);
+			sink.flush();
+		}
+	}catch (...){
+		execution.fail(std::current_exception());
+	}
+	if (execution.has_failed())
+		discard(input);
+	statistics.wall_seconds = execution.elapsed();
+}
+
+}
+
+namespace utility{
+
+double Pipeline::StageStatistics::throughput() const{
+	if (this->busy_seconds <= 0)
+		return 0;
+	return (this->bytes_in ? this->bytes_in : this->bytes_out) / this->busy_seconds;
+}
+
+void Pipeline::run(DataSink &sink){
+	const auto n = this->stages.size();
+	this->statistics.clear();
+	this->statistics.resize(n + 2);
+	this->statistics.front().name = "source";
+	for (size_t i = 0; i < n; i++)
+		this->statistics[i + 1].name = this->stages[i].name;
+	this->statistics.back().name = "sink";
+
+	std::vector<std::unique_ptr<SpscRingBuffer>> queues;
+	for (size_t i = 0; i <= n; i++)
+		queues.emplace_back(std::make_unique<SpscRingBuffer>(this->queue_capacity));
+
+	Execution execution;
+	std::vector<std::thread> threads;
+	threads.reserve(n + 1);
+	try{
+		threads.emplace_back([&](){
+			run_source(*this->source, *queues[0], this->statistics[0], execution);
+		});
+		for (size_t i = 0; i < n; i++){
+			threads.emplace_back([&, i](){
+				run_stage(this->stages[i], *queues[i], *queues[i + 1], this->statistics[i + 1], execution);
+			});
+		}
+	}catch (...){
+		//The last worker that did start has nobody reading its output.
+		execution.fail(std::current_exception());
+		if (!threads.empty())
+			discard(*queues[threads.size() - 1]);
+	}
+	if (threads.size() == n + 1)
+		run_sink(sink, *queues[n], this->statistics.back(), execution);
+	for (auto &thread : threads)
+		thread.join();
+	execution.rethrow();
+}
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "source_sink.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace utility{
+
+class SpscRingBuffer;
+
+namespace detail{
+
+template <typename T>
+auto call_terminate(T &stage, int) -> decltype(stage.terminate(), void()){
+	stage.terminate();
+}
+
+template <typename T>
+void call_terminate(T &, long){}
+
+}
+
+//Runs a chain of stages, each on its own thread, connected by bounded
+//SpscRingBuffers:
+//
+//    utility::Pipeline pipeline(source);
+//    pipeline.add(cipher, "encrypt").add(encoder, "base64");
+//    pipeline.run(sink);
+//
+//A stage is any object that's both a DataSink and a DataSource, such as a
+//CipherStream or a Base64Stream. When a queue fills up, the stage writing to
+//it blocks until the next one catches up, so memory use is bounded by the
+//queue capacity no matter how unevenly the stages perform. At the end of the
+//stream every stage that has a terminate() member gets it called, in order,
+//and the sink is flushed.
+//The stages, source and sink must not be used by anything else while the
+//pipeline is running.
+class Pipeline{
+public:
+	struct StageStatistics{
+		std::string name;
+		std::uint64_t bytes_in = 0;
+		std::uint64_t bytes_out = 0;
+		//Time spent inside the stage itself, excluding time spent waiting on
+		//its neighbors.
+		double busy_seconds = 0;
+		//Time from the start of the pipeline until the stage finished.
+		double wall_seconds = 0;
+		//Bytes consumed (or produced, for the source) per busy second.
+		double throughput() const;
+	};
+private:
+	struct Stage{
+		std::string name;
+		DataSink *sink;
+		DataSource *source;
+		std::function<void()> terminate;
+	};
+	DataSource *source;
+	std::vector<Stage> stages;
+	size_t queue_capacity;
+	std::vector<StageStatistics> statistics;
+public:
+	Pipeline(DataSource &source, size_t queue_capacity = 256 << 10)
+		: source(&source)
+		, queue_capacity(queue_capacity){}
+	Pipeline(const Pipeline &) = delete;
+	Pipeline &operator=(const Pipeline &) = delete;
+	template <typename T>
+	Pipeline &add(T &stage, std::string name = {}){
+		if (name.empty())
+			name = "stage " + std::to_string(this->stages.size() + 1);
+		this->stages.push_back({
+			std::move(name),
+			&stage,
+			&stage,
+			[&stage](){ detail::call_terminate(stage, 0); },
+		});
+		return *this;
+	}
+	//Pumps the whole source through every stage into sink, and returns once
+	//everything has been written and flushed. The sink runs on the calling
+	//thread. If any stage throws, the rest of the pipeline is shut down and
+	//the first exception is rethrown here.
+	void run(DataSink &sink);
+	//One entry for the source, one for each stage, and one for the sink, in
+	//that order. Only valid after run() has returned.
+	const std::vector<StageStatistics> &get_statistics() const{
+		return this->statistics;
+	}
+};
+
+}
@@ -0,0 +1,307 @@
+#include "poly1305.hpp"
+#include <cstring>
+#include <algorithm>
+
+namespace{
+
+std::uint32_t load32(const std::uint8_t *p){
+	return (std::uint32_t)p[0] | (std::uint32_t)p[1] << 8 | (std::uint32_t)p[2] << 16 | (std::uint32_t)p[3] << 24;
+}
+
+void store32(std::uint8_t *p, std::uint32_t x){
+	for (int i = 0; i < 4; i++)
+		p[i] = (std::uint8_t)(x >> (i * 8));
+}
+
+#ifdef CRYPTO_ALGORITHMS_POLY1305_64
+std::uint64_t load64(const std::uint8_t *p){
+	return (std::uint64_t)load32(p) | (std::uint64_t)load32(p + 4) << 32;
+}
+
+void store64(std::uint8_t *p, std::uint64_t x){
+	store32(p, (std::uint32_t)x);
+	store32(p + 4, (std::uint32_t)(x >> 32));
+}
+
+typedef unsigned __int128 u128;
+
+const std::uint64_t mask44 = ((std::uint64_t)1 << 44) - 1;
+const std::uint64_t mask42 = ((std::uint64_t)1 << 42) - 1;
+#else
+const std::uint32_t mask26 = (1 << 26) - 1;
+#endif
+
+}
+
+namespace hash{
+
+#ifdef CRYPTO_ALGORITHMS_POLY1305_64
+
+Poly1305::Poly1305(const void *void_key){
+	auto key = (const std::uint8_t *)void_key;
+	auto t0 = load64(key);
+	auto t1 = load64(key + 8);
+	//The clamped r, split into 44, 44 and 42 bits.
+	this->r[0] = t0 & 0xFFC0FFFFFFF;
+	this->r[1] = (t0 >> 44 | t1 << 20) & 0xFFFFFC0FFFF;
+	this->r[2] = (t1 >> 24) & 0x00FFFFFFC0F;
+	this->pad[0] = load64(key + 16);
+	this->pad[1] = load64(key + 24);
+}
+
+void Poly1305::process_blocks(const std::uint8_t *src, size_t blocks, bool final){
+	const std::uint64_t hibit = final ? 0 : (std::uint64_t)1 << 40;
+	auto r0 = this->r[0];
+	auto r1 = this->r[1];
+	auto r2 = this->r[2];
+	//2^130 = 5 (mod p), and the limbs above 2^130 are 4 bits short.
+	auto s1 = r1 * (5 << 2);
+	auto s2 = r2 * (5 << 2);
+	auto h0 = this->h[0];
+	auto h1 = this->h[1];
+	auto h2 = this->h[2];
+	for (; blocks--; src += block_size){
+		auto t0 = load64(src);
+		auto t1 = load64(src + 8);
+		h0 += t0 & mask44;
+		h1 += (t0 >> 44 | t1 << 20) & mask44;
+		h2 += (t1 >> 24 & mask42) | hibit;
+
+		auto d0 = (u128)h0 * r0 + (u128)h1 * s2 + (u128)h2 * s1;
+		auto d1 = (u128)h0 * r1 + (u128)h1 * r0 + (u128)h2 * s2;
+		auto d2 = (u128)h0 * r2 + (u128)h1 * r1 + (u128)h2 * r0;
+
+		auto c = (std::uint64_t)(d0 >> 44);
+		h0 = (std::uint64_t)d0 & mask44;
+		d1 += c;
+		c = (std::uint64_t)(d1 >> 44);
+		h1 = (std::uint64_t)d1 & mask44;
+		d2 += c;
+		c = (std::uint64_t)(d2 >> 42);
+		h2 = (std::uint64_t)d2 & mask42;
+		h0 += c * 5;
+		c = h0 >> 44;
+		h0 &= mask44;
+		h1 += c;
+	}
+	this->h[0] = h0;
+	this->h[1] = h1;
+	this->h[2] = h2;
+}
+
+#else
+
+Poly1305::Poly1305(const void *void_key){
+	auto key = (const std::uint8_t *)void_key;
+	//The clamped r, split into 26-bit limbs.
+	this->r[0] = load32(key + 0) & 0x3FFFFFF;
+	this->r[1] = load32(key + 3) >> 2 & 0x3FFFF03;
+	this->r[2] = load32(key + 6) >> 4 & 0x3FFC0FF;
+	this->r[3] = load32(key + 9) >> 6 & 0x3F03FFF;
+	this->r[4] = load32(key + 12) >> 8 & 0x00FFFFF;
+	for (int i = 0; i < 4; i++)
+		this->pad[i] = load32(key + 16 + i * 4);
+}
+
+void Poly1305::process_blocks(const std::uint8_t *src, size_t blocks, bool final){
+	const std::uint32_t hibit = final ? 0 : 1 << 24;
+	std::uint64_t r0 = this->r[0];
+	std::uint64_t r1 = this->r[1];
+	std::uint64_t r2 = this->r[2];
+	std::uint64_t r3 = this->r[3];
+	std::uint64_t r4 = this->r[4];
+	auto s1 = r1 * 5;
+	auto s2 = r2 * 5;
+	auto s3 = r3 * 5;
+	auto s4 = r4 * 5;
+	std::uint64_t h0 = this->h[0];
+	std::uint64_t h1 = this->h[1];
+	std::uint64_t h2 = this->h[2];
+	std::uint64_t h3 = this->h[3];
+	std::uint64_t h4 = this->h[4];
+	for (; blocks--; src += block_size){
+		h0 += load32(src + 0) & mask26;
+		h1 += load32(src + 3) >> 2 & mask26;
+		h2 += load32(src + 6) >> 4 & mask26;
+		h3 += load32(src + 9) >> 6 & mask26;
+		h4 += load32(src + 12) >> 8 | hibit;
+
+		auto d0 = h0 * r0 + h1 * s4 + h2 * s3 + h3 * s2 + h4 * s1;
+		auto d1 = h0 * r1 + h1 * r0 + h2 * s4 + h3 * s3 + h4 * s2;
+		auto d2 = h0 * r2 + h1 * r1 + h2 * r0 + h3 * s4 + h4 * s3;
+		auto d3 = h0 * r3 + h1 * r2 + h2 * r1 + h3 * r0 + h4 * s4;
+		auto d4 = h0 * r4 + h1 * r3 + h2 * r2 + h3 * r1 + h4 * r0;
+
+		auto c = d0 >> 26;
+		h0 = d0 & mask26;
+		d1 += c;
+		c = d1 >> 26;
+		h1 = d1 & mask26;
+		d2 += c;
+		c = d2 >> 26;
+		h2 = d2 & mask26;
+		d3 += c;
+		c = d3 >> 26;
+		h3 = d3 & mask26;
+		d4 += c;
+		c = d4 >> 26;
+		h4 = d4 & mask26;
+		h0 += c * 5;
+		c = h0 >> 26;
+		h0 &= mask26;
+		h1 += c;
+	}
+	this->h[0] = (std::uint32_t)h0;
+	this->h[1] = (std::uint32_t)h1;
+	this->h[2] = (std::uint32_t)h2;
+	this->h[3] = (std::uint32_t)h3;
+	this->h[4] = (std::uint32_t)h4;
+}
+
+#endif
+
+void Poly1305::update(const void *void_src, size_t size){
+	auto src = (const std::uint8_t *)void_src;
+	if (this->buffered){
+		auto n = std::min(size, block_size - this->buffered);
+		memcpy(this->buffer + this->buffered, src, n);
+		this->buffered += n;
+		src += n;
+		size -= n;
+		if (this->buffered < block_size)
+			return;
+		this->process_blocks(this->buffer, 1, false);
+		this->buffered = 0;
+	}
+	auto blocks = size / block_size;
+	this->process_blocks(src, blocks, false);
+	src += blocks * block_size;
+	size -= blocks * block_size;
+	if (size)
+		memcpy(this->buffer, src, size);
+	this->buffered = size;
+}
+
+Poly1305::tag_t Poly1305::finish(){
+	//A partial last block gets its high bit right after the data instead.
+	if (this->buffered){
+		this->buffer[this->buffered] = 1;
+		memset(this->buffer + this->buffered + 1, 0, block_size - this->buffered - 1);
+		this->process_blocks(this->buffer, 1, true);
+		this->buffered = 0;
+	}
+
+	tag_t ret;
+#ifdef CRYPTO_ALGORITHMS_POLY1305_64
+	auto h0 = this->h[0];
+	auto h1 = this->h[1];
+	auto h2 = this->h[2];
+
+	//Fully carry h.
+	auto c = h1 >> 44;
+	h1 &= mask44;
+	h2 += c;
+	c = h2 >> 42;
+	h2 &= mask42;
+	h0 += c * 5;
+	c = h0 >> 44;
+	h0 &= mask44;
+	h1 += c;
+	c = h1 >> 44;
+	h1 &= mask44;
+	h2 += c;
+	c = h2 >> 42;
+	h2 &= mask42;
+	h0 += c * 5;
+	c = h0 >> 44;
+	h0 &= mask44;
+	h1 += c;
+
+	//Compute h - p, and keep it if it didn't underflow, in constant time.
+	auto g0 = h0 + 5;
+	c = g0 >> 44;
+	g0 &= mask44;
+	auto g1 = h1 + c;
+	c = g1 >> 44;
+	g1 &= mask44;
+	auto g2 = h2 + c - ((std::uint64_t)1 << 42);
+	auto mask = (g2 >> 63) - 1;
+	h0 = (h0 & ~mask) | (g0 & mask);
+	h1 = (h1 & ~mask) | (g1 & mask);
+	h2 = (h2 & ~mask) | (g2 & mask);
+
+	//tag = h + pad (mod 2^128)
+	auto t0 = this->pad[0];
+	auto t1 = this->pad[1];
+	h0 += t0 & mask44;
+	c = h0 >> 44;
+	h0 &= mask44;
+	h1 += ((t0 >> 44 | t1 << 20) & mask44) + c;
+	c = h1 >> 44;
+	h1 &= mask44;
+	h2 += (t1 >> 24) + c;
+	h2 &= mask42;
+	store64(ret.data(), h0 | h1 << 44);
+	store64(ret.data() + 8, h1 >> 20 | h2 << 24);
+#else
+	auto h0 = this->h[0];
+	auto h1 = this->h[1];
+	auto h2 = this->h[2];
+	auto h3 = this->h[3];
+	auto h4 = this->h[4];
+
+	//Fully carry h.
+	auto c = h1 >> 26;
+	h1 &= mask26;
+	h2 += c;
+	c = h2 >> 26;
+	h2 &= mask26;
+	h3 += c;
+	c = h3 >> 26;
+	h3 &= mask26;
+	h4 += c;
+	c = h4 >> 26;
+	h4 &= mask26;
+	h0 += c * 5;
+	c = h0 >> 26;
+	h0 &= mask26;
+	h1 += c;
+
+	//Compute h - p, and keep it if it didn't underflow, in constant time.
+	auto g0 = h0 + 5;
+	c = g0 >> 26;
+	g0 &= mask26;
+	auto g1 = h1 + c;
+	c = g1 >> 26;
+	g1 &= mask26;
+	auto g2 = h2 + c;
+	c = g2 >> 26;
+	g2 &= mask26;
+	auto g3 = h3 + c;
+	c = g3 >> 26;
+	g3 &= mask26;
+	auto g4 = h4 + c - (1 << 26);
+	auto mask = (g4 >> 31) - 1;
+	h0 = (h0 & ~mask) | (g0 & mask);
+	h1 = (h1 & ~mask) | (g1 & mask);
+	h2 = (h2 & ~mask) | (g2 & mask);
+	h3 = (h3 & ~mask) | (g3 & mask);
+	h4 = (h4 & ~mask) | (g4 & mask);
+
+	//Pack into 32-bit words, then tag = h + pad (mod 2^128).
+	std::uint32_t words[] = {
+		h0 | h1 << 26,
+		h1 >> 6 | h2 << 20,
+		h2 >> 12 | h3 << 14,
+		h3 >> 18 | h4 << 8,
+	};
+	std::uint64_t f = 0;
+	for (int i = 0; i < 4; i++){
+		f = (std::uint64_t)words[i] + this->pad[i] + (f >> 32);
+		store32(ret.data() + i * 4, (std::uint32_t)f);
+	}
+#endif
+	return ret;
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+//Poly1305 uses 44-bit limbs and 128-bit products where the compiler has a
+//128-bit integer type, and 26-bit limbs otherwise. Define
+//CRYPTO_ALGORITHMS_POLY1305_32 to force the latter.
+#if defined(__SIZEOF_INT128__) && !defined(CRYPTO_ALGORITHMS_POLY1305_32)
+#define CRYPTO_ALGORITHMS_POLY1305_64 1
+#endif
+
+namespace hash{
+
+//The one-time authenticator from RFC 8439. A key must never be used for more
+//than one message.
+class Poly1305{
+public:
+	static const size_t key_size = 32;
+	static const size_t block_size = 16;
+	static const size_t tag_size = 16;
+	typedef std::array<std::uint8_t, tag_size> tag_t;
+private:
+#ifdef CRYPTO_ALGORITHMS_POLY1305_64
+	std::uint64_t r[3];
+	std::uint64_t h[3] = {};
+	std::uint64_t pad[2];
+#else
+	std::uint32_t r[5];
+	std::uint32_t h[5] = {};
+	std::uint32_t pad[4];
+#endif
+	std::uint8_t buffer[block_size];
+	size_t buffered = 0;
+
+	void process_blocks(const std::uint8_t *src, size_t blocks, bool final);
+public:
+	Poly1305(const void *key);
+	Poly1305(const std::array<std::uint8_t, key_size> &key): Poly1305(key.data()){}
+	Poly1305(const Poly1305 &) = default;
+	Poly1305 &operator=(const Poly1305 &) = default;
+	void update(const void *src, size_t size);
+	tag_t finish();
+	static tag_t compute(const void *key, const void *src, size_t size){
+		Poly1305 p(key);
+		p.update(src, size);
+		return p.finish();
+	}
+};
+
+}
@@ -7,9 +7,19 @@
 #include <cstring>
 #include <algorithm>
 #include <limits>
+#include <array>
 
 namespace utility{
 
+template <typename T>
+struct BasicSpan{
+	T *data = nullptr;
+	size_t size = 0;
+};
+
+typedef BasicSpan<std::uint8_t> Span;
+typedef BasicSpan<const std::uint8_t> ConstSpan;
+
 class RingBuffer{
 	std::vector<std::uint8_t> data;
 	size_t offset = 0;
@@ -53,12 +63,9 @@ class RingBuffer{
 	}
 	template <typename F>
 	void process(const F &f){
-		for (size_t offset = 0; offset < this->length;){
-			auto read_pos = this->offset % this->capacity;
-			auto read_size = std::min(this->capacity - read_pos, this->length - offset);
-			f(&this->data[read_pos], read_size);
-			offset += read_size;
-		}
+		for (auto &span : this->peek_readable())
+			if (span.size)
+				f(span.data, span.size);
 	}
 public:
 	RingBuffer() = default;
@@ -110,12 +117,54 @@ public:
 			return source.read(dst, size);
 		});
 	}
+	//Zero-copy access. peek_readable() returns the buffered data as up to two
+	//contiguous spans (the second one is empty unless the data wraps around),
+	//and consume() drops bytes from the front once they've been used.
+	//prepare_writable() returns the free space in the same way, and commit()
+	//appends bytes that have been written into it. A stage can therefore
+	//process data straight out of one buffer and into another. The spans are
+	//invalidated by any operation that modifies the buffer.
+	std::array<ConstSpan, 2> peek_readable() const{
+		std::array<ConstSpan, 2> ret;
+		if (!this->length)
+			return ret;
+		auto read_pos = this->offset % this->capacity;
+		auto first = std::min(this->capacity - read_pos, this->length);
+		ret[0] = { &this->data[read_pos], first };
+		ret[1] = { this->data.data(), this->length - first };
+		return ret;
+	}
+	void consume(size_t size){
+		size = std::min(size, this->length);
+		this->length -= size;
+		if (this->length)
+			this->offset = (this->offset + size) % this->capacity;
+		else
+			this->offset = 0;
+	}
+	std::array<Span, 2> prepare_writable(){
+		std::array<Span, 2> ret;
+		auto free = this->free();
+		if (!free)
+			return ret;
+		auto write_pos = (this->offset + this->length) % this->capacity;
+		auto first = std::min(this->capacity - write_pos, free);
+		ret[0] = { &this->data[write_pos], first };
+		ret[1] = { this->data.data(), free - first };
+		return ret;
+	}
+	void commit(size_t size){
+		this->length += std::min(size, this->free());
+	}
 	size_t free() const{
 		return this->capacity - this->length;
 	}
 	size_t get_length() const{
 		return this->length;
 	}
+	size_t get_capacity() const{
+		return this->capacity;
+	}
 };
 
 }
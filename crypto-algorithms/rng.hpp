@@ -86,12 +86,23 @@ public:
 };
 
 template <typename C>
-class BlockCipherRng : public BlockPrgn<C::block_size - 4>{
-	typedef uintptr_t T;
-	static const size_t state_size = (C::block_size + sizeof(T) - 1) / sizeof(T);
-	
+class BlockCipherRng : public Prng{
+	static const size_t block_size = C::block_size;
+	//To get the indistinguishability property, discard 32 bits per block.
+	static const size_t output_size = block_size - 4;
+	//Number of blocks generated per refill.
+	static const size_t batch_size = 64;
+	static const size_t buffer_size = batch_size * output_size;
+
 	C c;
-	T state[state_size];
+	//The counter, as a little endian integer.
+	typename C::block_t state;
+	std::uint8_t counters[batch_size * block_size];
+	//Leaves room for the 4 discarded bytes of the last block.
+	std::uint8_t buffer[buffer_size + 4];
+	size_t offset = 0;
+	size_t size = 0;
+
 	void increment_state(){
 		for (auto &s : this->state)
 			if (++s)
@@ -110,38 +121,59 @@ class BlockCipherRng : public BlockPrgn<C::block_size - 4>{
 		}
 		return ret;
 	}
-	void internal_get_bytes(void *dst) override{
-		auto block = (*this)();
-		//To get the indistinguishability property, discard 32 bits per block.
-		memcpy(dst, block.data(), C::block_size - 4);
-	}
-public:
-	BlockCipherRng(): c(typename C::key_t(random_array<C::key_t::size>())){
-		auto temp = random_array<sizeof(state)>();
-		memcpy(state, temp.data(), sizeof(state));
-	}
-	BlockCipherRng(const typename C::key_t &key, const typename C::block_t &initial_state = {}): c(key){
-		std::fill(this->state, this->state + state_size, 0);
-		size_t i = 0;
-		for (auto s : initial_state){
-			this->state[i / sizeof(T)] |= (T)s << (i % sizeof(T) * 8);
-			i++;
+	//Writes the truncated output of the next n blocks to dst, which must have
+	//room for n * output_size + 4 bytes. Each block is encrypted straight into
+	//place, and the bytes to be discarded get overwritten by the next block.
+	void generate(std::uint8_t *dst, size_t n){
+		for (size_t i = 0; i < n; i++){
+			memcpy(this->counters + i * block_size, this->state.data(), block_size);
+			this->increment_state();
 		}
+		for (size_t i = 0; i < n; i++)
+			this->c.encrypt_block(dst + i * output_size, this->counters + i * block_size);
 	}
+public:
+	BlockCipherRng(): c(typename C::key_t(random_array<C::key_t::size>())), state(random_array<block_size>()){}
+	BlockCipherRng(const typename C::key_t &key, const typename C::block_t &initial_state = {})
+		: c(key)
+		, state(initial_state){}
 	BlockCipherRng(const BlockCipherRng &) = default;
 	BlockCipherRng &operator=(const BlockCipherRng &) = default;
 	BlockCipherRng(BlockCipherRng &&) = default;
 	BlockCipherRng &operator=(BlockCipherRng &&) = default;
+	//Encrypts the next counter value, bypassing the output buffer.
 	typename C::block_t operator()(){
-		typename C::block_t ret;
-		size_t i = 0;
-		for (auto s : this->state)
-			for (size_t j = 0; j < sizeof(T); j++)
-				ret[i++] = (s >> (j * 8)) & 0xFF;
+		auto ret = this->c.encrypt_block(this->state);
 		this->increment_state();
-		ret = this->c.encrypt_block(ret);
 		return ret;
 	}
+	void get_bytes(void *void_dst, size_t size) override{
+		auto dst = (std::uint8_t *)void_dst;
+		//Drain whatever's left from the last refill first, so the output
+		//doesn't depend on how requests are split.
+		auto write_size = std::min(size, this->size);
+		memcpy(dst, this->buffer + this->offset, write_size);
+		this->offset += write_size;
+		this->size -= write_size;
+		dst += write_size;
+		size -= write_size;
+
+		//Large requests are generated directly into the destination.
+		while (size >= output_size + 4){
+			auto n = std::min((size - 4) / output_size, (size_t)batch_size);
+			this->generate(dst, n);
+			dst += n * output_size;
+			size -= n * output_size;
+		}
+
+		if (size){
+			this->generate(this->buffer, batch_size);
+			memcpy(dst, this->buffer, size);
+			this->offset = size;
+			this->size = buffer_size - size;
+		}
+	}
+	using Prng::get_bytes;
 };
 
 }
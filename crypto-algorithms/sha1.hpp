@@ -5,6 +5,7 @@
 #include <array>
 #include <string>
 #include <vector>
+#include <type_traits>
 #include <ostream>
 
 namespace hash{
@@ -79,6 +80,21 @@ class SHA1 : public HashAlgorithm{
 
 	void transform() noexcept;
 public:
+	static const size_t block_size = 64;
+	typedef digest::SHA1 digest_type;
+
+	//Snapshot of the hashing state (see hash.hpp).
+	struct Midstate{
+		std::uint32_t state[5];
+		std::uint64_t bitlen;
+		std::uint32_t datalen;
+		std::uint8_t data[64];
+		static const size_t serialized_size = sizeof(state) + sizeof(bitlen) + sizeof(datalen) + sizeof(data);
+		std::vector<std::uint8_t> serialize() const;
+		static Midstate deserialize(const void *, size_t);
+	};
+	static_assert(std::is_trivially_copyable<Midstate>::value, "Midstate must be trivially copyable");
+
 	SHA1(){
 		this->SHA1::reset();
 	}
@@ -87,6 +103,12 @@ public:
 	void reset() noexcept override;
 	void update(const void *buffer, size_t length) noexcept override;
 	digest::SHA1 get_digest() noexcept;
+	Midstate save_state() const noexcept;
+	void load_state(const Midstate &) noexcept;
+	//See hash.hpp.
+	SHA1 clone() const noexcept{
+		return *this;
+	}
 	static digest::SHA1 compute(const void *buffer, size_t length) noexcept{
 		SHA1 hash;
 		hash.update(buffer, length);
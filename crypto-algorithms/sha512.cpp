@@ -268,6 +268,40 @@ digest::SHA512 SHA512::get_digest() noexcept{
 	return ret;
 }
 
+SHA512::Midstate SHA512::save_state() const noexcept{
+	Midstate ret;
+	memcpy(ret.state, this->state, sizeof(this->state));
+	ret.count = this->count;
+	memcpy(ret.buf, this->buf, sizeof(this->buf));
+	return ret;
+}
+
+void SHA512::load_state(const Midstate &state) noexcept{
+	memcpy(this->state, state.state, sizeof(this->state));
+	this->count = state.count;
+	memcpy(this->buf, state.buf, sizeof(this->buf));
+}
+
+std::vector<std::uint8_t> SHA512::Midstate::serialize() const{
+	std::vector<std::uint8_t> ret;
+	ret.reserve(serialized_size);
+	detail::serialize_integers(ret, this->state, 8);
+	detail::serialize_integers(ret, &this->count, 1);
+	detail::serialize_integers(ret, this->buf, sizeof(this->buf));
+	return ret;
+}
+
+SHA512::Midstate SHA512::Midstate::deserialize(const void *buffer, size_t size){
+	if (size != serialized_size)
+		throw detail::InvalidMidstateException();
+	Midstate ret;
+	auto src = (const std::uint8_t *)buffer;
+	src = detail::deserialize_integers(ret.state, 8, src);
+	src = detail::deserialize_integers(&ret.count, 1, src);
+	detail::deserialize_integers(ret.buf, sizeof(ret.buf), src);
+	return ret;
+}
+
 }
 
 }
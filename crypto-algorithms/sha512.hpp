@@ -5,6 +5,7 @@
 #include <array>
 #include <string>
 #include <vector>
+#include <type_traits>
 #include <ostream>
 
 namespace hash{
@@ -78,6 +79,20 @@ class SHA512 : public HashAlgorithm{
 
 	void transform(const std::uint8_t block[128], std::uint64_t (&W)[80], std::uint64_t (&S)[8]) noexcept;
 public:
+	static const size_t block_size = 128;
+	typedef digest::SHA512 digest_type;
+
+	//Snapshot of the hashing state (see hash.hpp).
+	struct Midstate{
+		std::uint64_t state[8];
+		std::uint64_t count;
+		std::uint8_t buf[128];
+		static const size_t serialized_size = sizeof(state) + sizeof(count) + sizeof(buf);
+		std::vector<std::uint8_t> serialize() const;
+		static Midstate deserialize(const void *, size_t);
+	};
+	static_assert(std::is_trivially_copyable<Midstate>::value, "Midstate must be trivially copyable");
+
 	SHA512(){
 		this->SHA512::reset();
 	}
@@ -86,6 +101,12 @@ public:
 	void reset() noexcept override;
 	void update(const void *void_buffer, size_t length) noexcept override;
 	digest::SHA512 get_digest() noexcept;
+	Midstate save_state() const noexcept;
+	void load_state(const Midstate &) noexcept;
+	//See hash.hpp.
+	SHA512 clone() const noexcept{
+		return *this;
+	}
 	static digest::SHA512 compute(const void *buffer, size_t length) noexcept{
 		SHA512 hash;
 		hash.update(buffer, length);
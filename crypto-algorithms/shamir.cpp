@@ -1,6 +1,12 @@
 #include "shamir.hpp"
 #include "aes.hpp"
 #include "bignum.hpp"
+#include "chacha20.hpp"
+#include "cpu.hpp"
+#include <thread>
+#ifdef CRYPTO_ALGORITHMS_X86
+#include <immintrin.h>
+#endif
 
 std::uint32_t extended_euclidean(std::uint32_t a, std::uint32_t b){
 	std::uint32_t x0 = 1;
@@ -28,6 +34,140 @@ FiniteField32 FiniteField32::multiplicative_inverse() const{
 	return FiniteField32(extended_euclidean(this->n, P));
 }
 
+void FiniteField32::batch_inverse(FiniteField32 *values, size_t size){
+	//prefixes[i] is the product of the nonzero values before i.
+	std::vector<FiniteField32> prefixes(size);
+	FiniteField32 product = 1;
+	for (size_t i = 0; i < size; i++){
+		prefixes[i] = product;
+		if (reduce(values[i]))
+			product *= values[i];
+	}
+	auto inverse = product.multiplicative_inverse();
+	for (size_t i = size; i--;){
+		if (!reduce(values[i])){
+			values[i] = 0;
+			continue;
+		}
+		auto value = values[i];
+		values[i] = inverse * prefixes[i];
+		inverse *= value;
+	}
+}
+
+namespace{
+
+static_assert(sizeof(FiniteField32) == sizeof(std::uint32_t), "FiniteField32 must be laid out as a plain 32-bit integer!");
+
+//multiply_add() adds src[i] * c to dst[i], and horner_step() (Horner = true)
+//replaces dst[i] with dst[i] * c + src[i]. Neither needs reduced inputs:
+//(2^32 - 1)^2 + 2^32 - 1 still fits in the 64-bit intermediate.
+
+template <bool Horner>
+void kernel_scalar(std::uint32_t *dst, const std::uint32_t *src, std::uint32_t c, size_t size){
+	for (size_t i = 0; i < size; i++){
+		auto x = Horner ? dst[i] : src[i];
+		auto y = Horner ? src[i] : dst[i];
+		dst[i] = FiniteField32::reduce((std::uint64_t)x * c + y);
+	}
+}
+
+#ifdef CRYPTO_ALGORITHMS_X86
+
+//The vector kernels work on 64-bit lanes, so they handle the even and odd
+//elements separately and interleave them again at the end. The final
+//conditional subtraction of P is done without comparing: n < 2^32 + 25 is at
+//least P exactly when n + 5 carries into bit 32, in which case the result is
+//the low half of n + 5, and otherwise it's that minus 5.
+
+CRYPTO_ALGORITHMS_TARGET("sse2")
+__m128i reduce_sse2(__m128i n){
+	const auto low = _mm_set1_epi64x(0xFFFFFFFF);
+	const auto five = _mm_set1_epi64x(5);
+	n = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(n, 32), five), _mm_and_si128(n, low));
+	n = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(n, 32), five), _mm_and_si128(n, low));
+	n = _mm_add_epi64(n, five);
+	auto carry = _mm_srli_epi64(n, 32);
+	return _mm_sub_epi64(n, _mm_mul_epu32(_mm_xor_si128(carry, _mm_set1_epi64x(1)), five));
+}
+
+template <bool Horner>
+CRYPTO_ALGORITHMS_TARGET("sse2")
+size_t kernel_sse2(std::uint32_t *dst, const std::uint32_t *src, std::uint32_t c, size_t size){
+	const auto vc = _mm_set1_epi32((int)c);
+	const auto low = _mm_set1_epi64x(0xFFFFFFFF);
+	size_t ret = 0;
+	for (; size - ret >= 4; ret += 4){
+		auto d = _mm_loadu_si128((const __m128i *)(dst + ret));
+		auto s = _mm_loadu_si128((const __m128i *)(src + ret));
+		auto x = Horner ? d : s;
+		auto y = Horner ? s : d;
+		auto even = _mm_add_epi64(_mm_mul_epu32(x, vc), _mm_and_si128(y, low));
+		auto odd = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), vc), _mm_srli_epi64(y, 32));
+		even = _mm_and_si128(reduce_sse2(even), low);
+		odd = _mm_slli_epi64(reduce_sse2(odd), 32);
+		_mm_storeu_si128((__m128i *)(dst + ret), _mm_or_si128(even, odd));
+	}
+	return ret;
+}
+
+CRYPTO_ALGORITHMS_TARGET("avx2")
+__m256i reduce_avx2(__m256i n){
+	const auto low = _mm256_set1_epi64x(0xFFFFFFFF);
+	const auto five = _mm256_set1_epi64x(5);
+	n = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(n, 32), five), _mm256_and_si256(n, low));
+	n = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(n, 32), five), _mm256_and_si256(n, low));
+	n = _mm256_add_epi64(n, five);
+	auto carry = _mm256_srli_epi64(n, 32);
+	return _mm256_sub_epi64(n, _mm256_mul_epu32(_mm256_xor_si256(carry, _mm256_set1_epi64x(1)), five));
+}
+
+template <bool Horner>
+CRYPTO_ALGORITHMS_TARGET("avx2")
+size_t kernel_avx2(std::uint32_t *dst, const std::uint32_t *src, std::uint32_t c, size_t size){
+	const auto vc = _mm256_set1_epi32((int)c);
+	const auto low = _mm256_set1_epi64x(0xFFFFFFFF);
+	size_t ret = 0;
+	for (; size - ret >= 8; ret += 8){
+		auto d = _mm256_loadu_si256((const __m256i *)(dst + ret));
+		auto s = _mm256_loadu_si256((const __m256i *)(src + ret));
+		auto x = Horner ? d : s;
+		auto y = Horner ? s : d;
+		auto even = _mm256_add_epi64(_mm256_mul_epu32(x, vc), _mm256_and_si256(y, low));
+		auto odd = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), vc), _mm256_srli_epi64(y, 32));
+		auto result = _mm256_blend_epi32(reduce_avx2(even), _mm256_slli_epi64(reduce_avx2(odd), 32), 0xAA);
+		_mm256_storeu_si256((__m256i *)(dst + ret), result);
+	}
+	return ret;
+}
+
+#endif
+
+template <bool Horner>
+struct Kernels{
+	static constexpr auto scalar = kernel_scalar<Horner>;
+#ifdef CRYPTO_ALGORITHMS_X86
+	static constexpr auto sse_feature = &utility::cpu::Features::sse2;
+	static constexpr auto sse = kernel_sse2<Horner>;
+	static constexpr auto avx2 = kernel_avx2<Horner>;
+#endif
+};
+
+template <bool Horner>
+void process(FiniteField32 *dst, const FiniteField32 *src, FiniteField32 c, size_t size){
+	utility::cpu::run_kernels<Kernels<Horner>>((std::uint32_t *)dst, (const std::uint32_t *)src, (std::uint32_t)c, size);
+}
+
+}
+
+void FiniteField32::multiply_add(FiniteField32 *dst, const FiniteField32 *src, FiniteField32 c, size_t size){
+	process<false>(dst, src, c, size);
+}
+
+void FiniteField32::horner_step(FiniteField32 *dst, const FiniteField32 *src, FiniteField32 c, size_t size){
+	process<true>(dst, src, c, size);
+}
+
 FiniteField32 FiniteField32::pow(std::uint32_t n){
 	FiniteField32 ret = 1;
 	auto multiplier = *this;
@@ -133,6 +273,43 @@ Polynomial Polynomial::lagrange_polynomial(const std::vector<std::pair<FiniteFie
 	return ret;
 }
 
+std::vector<FiniteField32> lagrange_weights(const std::vector<FiniteField32> &unreduced_x){
+	//Deserialized shares can have x >= P, which would alias a smaller x and
+	//get past the duplicate check.
+	std::vector<FiniteField32> x;
+	x.reserve(unreduced_x.size());
+	for (auto xi : unreduced_x){
+		x.push_back(FiniteField32::reduce((std::uint32_t)xi));
+		if (!(std::uint32_t)x.back())
+			throw std::runtime_error("invalid share x coordinate");
+	}
+	std::vector<FiniteField32> denominators;
+	denominators.reserve(x.size());
+	for (size_t i = 0; i < x.size(); i++){
+		FiniteField32 denominator = 1;
+		for (size_t j = 0; j < x.size(); j++){
+			if (i == j)
+				continue;
+			if (x[i] == x[j])
+				throw std::runtime_error("duplicate shares");
+			denominator *= x[j] - x[i];
+		}
+		denominators.push_back(denominator);
+	}
+	FiniteField32::batch_inverse(denominators.data(), denominators.size());
+
+	std::vector<FiniteField32> ret;
+	ret.reserve(x.size());
+	for (size_t i = 0; i < x.size(); i++){
+		FiniteField32 numerator = 1;
+		for (size_t j = 0; j < x.size(); j++)
+			if (i != j)
+				numerator *= x[j];
+		ret.push_back(numerator * denominators[i]);
+	}
+	return ret;
+}
+
 using arithmetic::arbitrary::BigNum;
 
 size_t u64_to_size(std::uint64_t n){
@@ -141,33 +318,63 @@ size_t u64_to_size(std::uint64_t n){
 	return (size_t)n;
 }
 
-std::uint64_t size_to_u64(size_t n){
-	if (n > std::numeric_limits<std::uint64_t>::max())
-		throw std::bad_cast();
-	return (size_t)n;
+void SecretFragmenter::write(const void *void_src, size_t size, std::vector<FiniteField32> &dst){
+	auto src = (const std::uint8_t *)void_src;
+	dst.reserve(dst.size() + (this->bits + size * 8) / 31);
+	this->size += size;
+	for (size_t i = 0; i < size; i++){
+		this->accumulator |= (std::uint64_t)src[i] << this->bits;
+		this->bits += 8;
+		if (this->bits >= 31){
+			dst.emplace_back((std::uint32_t)(this->accumulator & 0x7FFFFFFF));
+			this->accumulator >>= 31;
+			this->bits -= 31;
+		}
+	}
 }
 
-std::vector<FiniteField32> fragment_secret(const std::string &secret){
-	typedef BigNum Z;
-
-	auto size = size_to_u64(secret.size());
+void SecretFragmenter::finish(std::vector<FiniteField32> &dst){
+	std::uint8_t padding[chunk_bytes] = { 0x80 };
+	this->write(padding, chunk_bytes - this->size % chunk_bytes, dst);
+}
 
-	Z n(secret.data(), secret.size());
+void SecretDefragmenter::write(const FiniteField32 *src, size_t size, std::string &dst){
+	for (size_t i = 0; i < size; i++){
+		this->accumulator |= (std::uint64_t)((std::uint32_t)src[i] & 0x7FFFFFFF) << this->bits;
+		this->bits += 31;
+		while (this->bits >= 8){
+			this->pending.push_back((char)(this->accumulator & 0xFF));
+			this->accumulator >>= 8;
+			this->bits -= 8;
+		}
+	}
+	const auto hold = SecretFragmenter::chunk_bytes;
+	if (this->pending.size() > hold * 2){
+		auto n = this->pending.size() - hold;
+		dst.append(this->pending, 0, n);
+		this->pending.erase(0, n);
+	}
+}
 
-	n <<= 64;
-	n += size;
+void SecretDefragmenter::finish(std::string &dst){
+	auto end = this->pending.find_last_not_of('\0');
+	if (end != this->pending.npos && (std::uint8_t)this->pending[end] == 0x80 && this->pending.size() - end <= SecretFragmenter::chunk_bytes)
+		this->pending.resize(end);
+	dst += this->pending;
+	this->pending.clear();
+}
 
+std::vector<FiniteField32> fragment_secret(const std::string &secret){
 	std::vector<FiniteField32> ret;
-	Z P = FiniteField32::P;
-	while (!!n){
-		ret.emplace_back((n % P).convert_to<std::uint32_t>());
-		n /= P;
-	}
-
+	SecretFragmenter fragmenter;
+	fragmenter.write(secret.data(), secret.size(), ret);
+	fragmenter.finish(ret);
 	return ret;
 }
 
-std::string defragment_secret(const std::vector<FiniteField32> &fragments){
+namespace{
+
+std::string legacy_defragment_secret(const std::vector<FiniteField32> &fragments){
 	typedef BigNum Z;
 
 	Z n;
@@ -192,29 +399,149 @@ std::string defragment_secret(const std::vector<FiniteField32> &fragments){
 	return ret;
 }
 
-std::string recover_secret(const std::vector<ShamirShare> &shares){
+}
+
+std::string defragment_secret(const std::vector<FiniteField32> &fragments, std::uint8_t version){
+	if (version == ShamirShare::legacy_version)
+		return legacy_defragment_secret(fragments);
+	std::string ret;
+	SecretDefragmenter defragmenter;
+	defragmenter.write(fragments.data(), fragments.size(), ret);
+	defragmenter.finish(ret);
+	return ret;
+}
+
+namespace{
+
+//Fragments shared or recovered together, so that the intermediate values stay
+//in the L1 cache.
+const size_t block_size = 1 << 10;
+//Secrets with fewer fragments per thread than this aren't worth the cost of
+//starting the threads.
+const size_t min_fragments_per_thread = 1 << 14;
+
+unsigned thread_count(unsigned threads){
+	if (!threads)
+		threads = std::max(std::thread::hardware_concurrency(), 1U);
+	return threads;
+}
+
+//Calls f(offset, size) for every block of n fragments, spread across threads.
+template <typename F>
+void for_each_block(size_t n, unsigned threads, const F &f){
+	const auto blocks = (n + block_size - 1) / block_size;
+	threads = thread_count(threads);
+	threads = (unsigned)std::max<size_t>(std::min<size_t>(threads, n / min_fragments_per_thread), 1);
+	auto worker = [&](size_t first){
+		for (auto i = first; i < blocks; i += threads){
+			auto offset = i * block_size;
+			f(offset, std::min(block_size, n - offset));
+		}
+	};
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < threads; i++)
+		workers.emplace_back(worker, i);
+	worker(0);
+	for (auto &t : workers)
+		t.join();
+}
+
+//Draws the random coefficients for a block of fragments. Coefficient k of
+//fragment i goes in dst[k * size + i], so that evaluation runs along
+//contiguous arrays.
+void generate_coefficients(FiniteField32 *dst, size_t count, csprng::Prng &rng){
+	rng.get_bytes(dst, count * sizeof(FiniteField32));
+	for (size_t i = 0; i < count; i++){
+		while (dst[i] >= FiniteField32::P){
+			std::uint32_t n;
+			rng.get(n);
+			dst[i] = n;
+		}
+	}
+}
+
+//Computes y[j][i] for n fragments, from polynomials with the fragments as
+//constant terms, evaluated at x[j]. first is the index of the first fragment
+//in the whole secret.
+void evaluate(const std::vector<FiniteField32 *> &y, const std::vector<FiniteField32> &x, const FiniteField32 *fragments, size_t n, std::uint64_t first, std::uint32_t threshold, const std::array<std::uint8_t, 32> &seed, unsigned threads){
+	const size_t degree = threshold - 1;
+	for_each_block(n, threads, [&](size_t offset, size_t size){
+		//Every block draws from its own stream, so the result doesn't depend
+		//on how the blocks are spread across threads.
+		csprng::ChaCha20Rng::nonce_t nonce;
+		for (size_t i = 0; i < nonce.size(); i++)
+			nonce[i] = (std::uint8_t)((first + offset) >> (i * 8));
+		csprng::ChaCha20Rng rng(seed, nonce);
+		std::vector<FiniteField32> coefficients(degree * size);
+		generate_coefficients(coefficients.data(), coefficients.size(), rng);
+
+		//Horner's rule, one coefficient at a time across the whole block.
+		for (size_t j = 0; j < y.size(); j++){
+			auto dst = y[j] + offset;
+			std::copy(coefficients.begin() + (degree - 1) * size, coefficients.begin() + degree * size, dst);
+			for (auto k = degree - 1; k--;)
+				FiniteField32::horner_step(dst, coefficients.data() + k * size, x[j], size);
+			FiniteField32::horner_step(dst, fragments + offset, x[j], size);
+		}
+	});
+}
+
+//dst[i] = sum(weights[j] * y[j][i]) for n fragments.
+void recover_fragments(FiniteField32 *dst, const std::vector<const FiniteField32 *> &y, const std::vector<FiniteField32> &weights, size_t n, unsigned threads){
+	for_each_block(n, threads, [&](size_t offset, size_t size){
+		std::fill(dst + offset, dst + offset + size, 0);
+		for (size_t j = 0; j < y.size(); j++)
+			FiniteField32::multiply_add(dst + offset, y[j] + offset, weights[j], size);
+	});
+}
+
+}
+
+namespace detail{
+
+void evaluate_shares(std::vector<ShamirShare> &shares, const std::vector<FiniteField32> &fragments, std::uint32_t threshold, const std::array<std::uint8_t, 32> &seed, unsigned threads){
+	std::vector<FiniteField32 *> y;
+	std::vector<FiniteField32> x;
+	for (auto &share : shares){
+		share.y.resize(fragments.size());
+		y.push_back(share.y.data());
+		x.push_back(share.x);
+	}
+	evaluate(y, x, fragments.data(), fragments.size(), 0, threshold, seed, threads);
+}
+
+}
+
+std::string recover_secret(const std::vector<ShamirShare> &shares, unsigned threads){
 	if (shares.size() < 2)
 		throw std::runtime_error("invalid parameters");
 
 	auto &digest = shares.front().secret_digest;
+	auto version = shares.front().version;
 	for (size_t i = 1; i < shares.size(); i++){
 		if (shares[i].secret_digest != digest)
 			throw std::runtime_error("shares belong to non-matching secrets");
+		if (shares[i].version != version)
+			throw std::runtime_error("shares have different versions");
 	}
 
 	auto n = shares.front().y.size();
-	std::vector<FiniteField32> recovered;
-	recovered.reserve(n);
-	std::vector<std::pair<FiniteField32, FiniteField32>> solutions;
-	solutions.reserve(shares.size());
-	for (size_t i = 0; i < n; i++){
-		solutions.clear();
-		for (auto &share : shares)
-			solutions.emplace_back(share.x, share.y[i]);
-		recovered.emplace_back(Polynomial::lagrange_polynomial(solutions).eval(0));
+	std::vector<FiniteField32> x;
+	std::vector<const FiniteField32 *> y;
+	for (auto &share : shares){
+		if (share.y.size() != n)
+			throw std::runtime_error("shares have different lengths");
+		x.push_back(share.x);
+		y.push_back(share.y.data());
 	}
+	//The x coordinates are the same for every fragment, so each fragment is
+	//just a weighted sum of the shares' y coordinates.
+	auto weights = lagrange_weights(x);
+
+	std::vector<FiniteField32> recovered(n);
+	recover_fragments(recovered.data(), y, weights, n, threads);
 
-	return defragment_secret(recovered);
+	return defragment_secret(recovered, version);
 }
 
 namespace {
@@ -237,16 +564,33 @@ void serialize_u32(std::vector<std::uint8_t> &dst, std::uint32_t src){
 
 }
 
+//Current shares are laid out as
+//
+//    version (1 byte) | secret digest (32 bytes) | x (4 bytes) | y (4 bytes each)
+//
+//Legacy shares lack the version byte, so the two can be told apart by their
+//length modulo 4.
 ShamirShare::ShamirShare(const std::vector<std::uint8_t> &buffer){
 	const auto n1 = hash::digest::SHA256::size;
 	const auto n2 = sizeof(std::uint32_t);
-	if (buffer.size() < n1 + n2 * 2 || (buffer.size() - n1) % n2 != 0)
+	size_t offset = 0;
+	if (buffer.size() % n2 == 1){
+		this->version = buffer[0];
+		if (this->version == legacy_version || this->version > current_version)
+			throw std::runtime_error("unsupported Shamir share version");
+		offset = 1;
+	}else
+		this->version = legacy_version;
+	if (buffer.size() < offset + n1 + n2 * 2 || (buffer.size() - offset - n1) % n2 != 0)
 		throw std::runtime_error("invalid serialized Shamir share");
 	hash::digest::SHA256::digest_t temp;
-	memcpy(temp.data(), buffer.data(), n1);
+	memcpy(temp.data(), buffer.data() + offset, n1);
 	this->secret_digest = temp;
-	this->x = deserialize_u32(buffer.data() + n1);
-	for (size_t i = n1 + n2; i < buffer.size(); i += n2)
+	offset += n1;
+	this->x = deserialize_u32(buffer.data() + offset);
+	offset += n2;
+	this->y.reserve((buffer.size() - offset) / n2);
+	for (size_t i = offset; i < buffer.size(); i += n2)
 		this->y.push_back(deserialize_u32(buffer.data() + i));
 }
 
@@ -254,7 +598,9 @@ std::vector<std::uint8_t> ShamirShare::serialize() const{
 	const auto n1 = hash::digest::SHA256::size;
 	const auto n2 = sizeof(std::uint32_t);
 	std::vector<std::uint8_t> ret;
-	ret.reserve(n1 + n2 * (1 + this->y.size()));
+	ret.reserve(1 + n1 + n2 * (1 + this->y.size()));
+	if (this->version != legacy_version)
+		ret.push_back(this->version);
 	for (auto b : this->secret_digest.to_array())
 		ret.push_back(b);
 	serialize_u32(ret, this->x);
@@ -262,3 +608,249 @@ std::vector<std::uint8_t> ShamirShare::serialize() const{
 		serialize_u32(ret, y);
 	return ret;
 }
+
+namespace{
+
+void serialize_u64(std::vector<std::uint8_t> &dst, std::uint64_t src){
+	serialize_u32(dst, (std::uint32_t)src);
+	serialize_u32(dst, (std::uint32_t)(src >> 32));
+}
+
+std::uint64_t deserialize_u64(const std::uint8_t *src){
+	return deserialize_u32(src) | (std::uint64_t)deserialize_u32(src + 4) << 32;
+}
+
+const size_t header_size = 1 + 4 + 4;
+const size_t chunk_header_size = 8 + 4;
+
+hash::digest::SHA256 chunk_digest(std::uint32_t x, const std::uint8_t *chunk, size_t size){
+	std::uint8_t temp[4];
+	for (int i = 0; i < 4; i++)
+		temp[i] = (std::uint8_t)(x >> (i * 8));
+	hash::algorithm::SHA256 hash;
+	hash.update(temp, sizeof(temp));
+	hash.update(chunk, size);
+	return hash.get_digest();
+}
+
+}
+
+ShareWriter::ShareWriter(utility::DataSink &sink, FiniteField32 x, std::uint32_t chunk_size)
+		: sink(&sink)
+		, x(x)
+		, chunk_size(chunk_size){
+	if (!chunk_size || chunk_size > max_chunk_size)
+		throw std::runtime_error("invalid parameters");
+	this->pending.reserve(chunk_size);
+	this->buffer.push_back((std::uint8_t)ShamirShare::chunked_version);
+	serialize_u32(this->buffer, this->x);
+	serialize_u32(this->buffer, this->chunk_size);
+	utility::write_fully(*this->sink, this->buffer.data(), this->buffer.size());
+}
+
+void ShareWriter::write_chunk(const FiniteField32 *src, size_t size, const hash::digest::SHA256 *secret_digest){
+	this->buffer.clear();
+	serialize_u64(this->buffer, this->index++);
+	serialize_u32(this->buffer, (std::uint32_t)size);
+	for (size_t i = 0; i < size; i++)
+		serialize_u32(this->buffer, src[i]);
+	if (secret_digest){
+		auto &array = secret_digest->to_array();
+		this->buffer.insert(this->buffer.end(), array.begin(), array.end());
+	}
+	auto digest = chunk_digest(this->x, this->buffer.data(), this->buffer.size());
+	this->buffer.insert(this->buffer.end(), digest.to_array().begin(), digest.to_array().end());
+	utility::write_fully(*this->sink, this->buffer.data(), this->buffer.size());
+}
+
+void ShareWriter::write(const FiniteField32 *src, size_t size){
+	while (size){
+		if (this->pending.empty() && size >= this->chunk_size){
+			this->write_chunk(src, this->chunk_size);
+			src += this->chunk_size;
+			size -= this->chunk_size;
+			continue;
+		}
+		auto n = std::min(size, this->chunk_size - this->pending.size());
+		this->pending.insert(this->pending.end(), src, src + n);
+		src += n;
+		size -= n;
+		if (this->pending.size() == this->chunk_size){
+			this->write_chunk(this->pending.data(), this->pending.size());
+			this->pending.clear();
+		}
+	}
+}
+
+void ShareWriter::finish(const hash::digest::SHA256 &secret_digest){
+	if (this->pending.size()){
+		this->write_chunk(this->pending.data(), this->pending.size());
+		this->pending.clear();
+	}
+	this->write_chunk(nullptr, 0, &secret_digest);
+	this->sink->flush();
+}
+
+ShareReader::ShareReader(utility::DataSource &source): source(&source){
+	std::uint8_t header[header_size];
+	utility::read_exactly(source, header, sizeof(header));
+	if (header[0] != ShamirShare::chunked_version)
+		throw std::runtime_error("unsupported Shamir share version");
+	this->x = deserialize_u32(header + 1);
+	this->chunk_size = deserialize_u32(header + 5);
+	if (!this->chunk_size || this->chunk_size > ShareWriter::max_chunk_size)
+		throw std::runtime_error("invalid serialized Shamir share");
+}
+
+bool ShareReader::read_chunk(std::vector<FiniteField32> &dst){
+	dst.clear();
+	if (this->finished)
+		return false;
+	const auto n1 = hash::digest::SHA256::size;
+	this->buffer.resize(chunk_header_size);
+	utility::read_exactly(*this->source, this->buffer.data(), chunk_header_size);
+	auto index = deserialize_u64(this->buffer.data());
+	auto count = deserialize_u32(this->buffer.data() + 8);
+	if (index != this->index++)
+		throw std::runtime_error("Shamir share chunks are out of order");
+	if (count > this->chunk_size || (count && this->short_chunk_seen))
+		throw std::runtime_error("invalid serialized Shamir share");
+
+	//The end of the share has the secret's digest instead of data.
+	auto body = count ? (size_t)count * 4 : n1;
+	this->buffer.resize(chunk_header_size + body + n1);
+	utility::read_exactly(*this->source, this->buffer.data() + chunk_header_size, body + n1);
+	auto digest = chunk_digest(this->x, this->buffer.data(), chunk_header_size + body);
+	if (memcmp(digest.to_array().data(), this->buffer.data() + chunk_header_size + body, n1))
+		throw std::runtime_error("Shamir share chunk is corrupt");
+
+	auto data = this->buffer.data() + chunk_header_size;
+	if (!count){
+		hash::digest::SHA256::digest_t temp;
+		memcpy(temp.data(), data, n1);
+		this->secret_digest = temp;
+		this->finished = true;
+		return false;
+	}
+	this->short_chunk_seen = count < this->chunk_size;
+	dst.reserve(count);
+	for (size_t i = 0; i < count; i++)
+		dst.push_back(deserialize_u32(data + i * 4));
+	return true;
+}
+
+namespace detail{
+
+void share_secret(utility::DataSource &secret, const std::vector<utility::DataSink *> &shares, std::uint32_t threshold, const std::array<std::uint8_t, 32> &seed, unsigned threads){
+	std::vector<ShareWriter> writers;
+	std::vector<FiniteField32> x;
+	for (std::uint32_t i = 0; i < shares.size(); i++){
+		x.emplace_back(i + 1);
+		writers.emplace_back(*shares[i], x.back());
+	}
+	const size_t chunk_size = ShareWriter::default_chunk_size;
+	//A chunk's worth of fragments per thread. The coefficients only depend
+	//on the fragments' positions, so the shares come out the same whatever
+	//the batch size.
+	const size_t batch_size = chunk_size * thread_count(threads);
+	std::vector<std::vector<FiniteField32>> y(shares.size(), std::vector<FiniteField32>(batch_size));
+	std::vector<FiniteField32 *> pointers;
+	for (auto &v : y)
+		pointers.push_back(v.data());
+
+	SecretFragmenter fragmenter;
+	hash::algorithm::SHA256 hash;
+	std::vector<FiniteField32> fragments;
+	std::uint64_t first = 0;
+	auto flush = [&](size_t n){
+		evaluate(pointers, x, fragments.data(), n, first, threshold, seed, threads);
+		for (size_t i = 0; i < writers.size(); i++)
+			writers[i].write(pointers[i], n);
+		fragments.erase(fragments.begin(), fragments.begin() + n);
+		first += n;
+	};
+
+	std::vector<std::uint8_t> buffer(SecretFragmenter::chunk_bytes * (chunk_size / SecretFragmenter::chunk_elements));
+	while (true){
+		auto read = secret.read(buffer.data(), buffer.size());
+		if (!read)
+			break;
+		hash.update(buffer.data(), read);
+		fragmenter.write(buffer.data(), read, fragments);
+		while (fragments.size() >= batch_size)
+			flush(batch_size);
+	}
+	fragmenter.finish(fragments);
+	while (fragments.size())
+		flush(std::min(fragments.size(), batch_size));
+
+	auto digest = hash.get_digest();
+	for (auto &writer : writers)
+		writer.finish(digest);
+}
+
+}
+
+void recover_secret(const std::vector<utility::DataSource *> &shares, utility::DataSink &secret, unsigned threads){
+	if (shares.size() < 2)
+		throw std::runtime_error("invalid parameters");
+	std::vector<ShareReader> readers;
+	std::vector<FiniteField32> x;
+	for (auto source : shares){
+		readers.emplace_back(*source);
+		x.push_back(readers.back().get_x());
+		if (readers.back().get_chunk_size() != readers.front().get_chunk_size())
+			throw std::runtime_error("shares have different chunk sizes");
+	}
+	auto weights = lagrange_weights(x);
+
+	//A chunk per thread from every share is recovered at once.
+	const auto batch_chunks = thread_count(threads);
+	std::vector<FiniteField32> chunk;
+	std::vector<std::vector<FiniteField32>> batches(shares.size());
+	std::vector<const FiniteField32 *> y(shares.size());
+	std::vector<FiniteField32> recovered;
+	SecretDefragmenter defragmenter;
+	hash::algorithm::SHA256 hash;
+	std::string output;
+	auto write = [&](){
+		hash.update(output.data(), output.size());
+		utility::write_fully(secret, output.data(), output.size());
+		output.clear();
+	};
+	for (bool more = true; more;){
+		for (auto &batch : batches)
+			batch.clear();
+		for (unsigned i = 0; i < batch_chunks && more; i++){
+			size_t size = 0;
+			for (size_t j = 0; j < readers.size(); j++){
+				auto read = readers[j].read_chunk(chunk);
+				if (!j){
+					more = read;
+					size = chunk.size();
+				}else if (read != more || chunk.size() != size)
+					throw std::runtime_error("shares have different lengths");
+				batches[j].insert(batches[j].end(), chunk.begin(), chunk.end());
+			}
+		}
+		auto n = batches.front().size();
+		if (!n)
+			continue;
+		for (size_t i = 0; i < batches.size(); i++)
+			y[i] = batches[i].data();
+		recovered.resize(n);
+		recover_fragments(recovered.data(), y, weights, n, threads);
+		defragmenter.write(recovered.data(), n, output);
+		write();
+	}
+	defragmenter.finish(output);
+	write();
+	secret.flush();
+
+	auto &digest = readers.front().get_secret_digest();
+	for (auto &reader : readers)
+		if (reader.get_secret_digest() != digest)
+			throw std::runtime_error("shares belong to non-matching secrets");
+	if (hash.get_digest() != digest)
+		throw std::runtime_error("recovered secret doesn't match its digest");
+}
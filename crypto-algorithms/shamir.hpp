@@ -2,8 +2,10 @@
 
 #include "rng.hpp"
 #include "sha256.hpp"
+#include "source_sink.hpp"
 #include <vector>
 #include <string>
+#include <array>
 #include <cstdint>
 
 class FiniteField32{
@@ -11,11 +13,20 @@ class FiniteField32{
 public:
 	static constexpr std::uint64_t P = 4294967291;
 
+	//Reduces any 64-bit number modulo P without dividing. Since P = 2^32 - 5,
+	//2^32 = 5 (mod P), so the high half can be multiplied by 5 and folded
+	//into the low half. After two folds the result is below 2^32 + 25.
+	static std::uint32_t reduce(std::uint64_t n){
+		n = (n >> 32) * 5 + (n & 0xFFFFFFFF);
+		n = (n >> 32) * 5 + (n & 0xFFFFFFFF);
+		return (std::uint32_t)(n >= P ? n - P : n);
+	}
+
 	FiniteField32(std::uint32_t n = 0) : n(n){}
 	FiniteField32(const FiniteField32 &) = default;
 	FiniteField32 &operator=(const FiniteField32 &) = default;
 	FiniteField32 operator+(const FiniteField32 &other) const{
-		return FiniteField32(((std::uint64_t)this->n + (std::uint64_t)other.n) % P);
+		return reduce((std::uint64_t)this->n + (std::uint64_t)other.n);
 	}
 	FiniteField32 &operator+=(const FiniteField32 &other){
 		*this = *this + other;
@@ -29,7 +40,7 @@ public:
 		return *this;
 	}
 	FiniteField32 operator*(const FiniteField32 &other) const{
-		return FiniteField32(((std::uint64_t)this->n * (std::uint64_t)other.n) % P);
+		return reduce((std::uint64_t)this->n * (std::uint64_t)other.n);
 	}
 	FiniteField32 &operator*=(const FiniteField32 &other){
 		*this = *this * other;
@@ -39,9 +50,22 @@ public:
 		return *this * other.multiplicative_inverse();
 	}
 	FiniteField32 operator-() const{
-		return P - this->n;
+		auto n = reduce(this->n);
+		return n ? (std::uint32_t)(P - n) : 0;
 	}
+	//The inverse of 0 is taken to be 0.
 	FiniteField32 multiplicative_inverse() const;
+	//Inverts every element with a single multiplicative_inverse() and three
+	//multiplications per element (Montgomery's trick). Zeros stay zero.
+	static void batch_inverse(FiniteField32 *values, size_t size);
+
+	//Bulk operations over arrays, vectorized with SSE2 or AVX2 where the
+	//processor allows.
+
+	//dst[i] += c * src[i]
+	static void multiply_add(FiniteField32 *dst, const FiniteField32 *src, FiniteField32 c, size_t size);
+	//dst[i] = c * dst[i] + src[i], one step of Horner's rule.
+	static void horner_step(FiniteField32 *dst, const FiniteField32 *src, FiniteField32 c, size_t size);
 	operator std::uint32_t() const{
 		return this->n;
 	}
@@ -77,8 +101,46 @@ public:
 	static Polynomial lagrange_polynomial(const std::vector<std::pair<FiniteField32, FiniteField32>> &roots);
 };
 
+//Packs a byte stream into field elements, 31 bits at a time, so that every
+//element is below P and every 31 bytes become exactly 8 elements. The end of
+//the stream is marked with a 0x80 byte followed by zeroes up to the next
+//multiple of 31 bytes, so the length never needs to be known in advance.
+class SecretFragmenter{
+	std::uint64_t accumulator = 0;
+	unsigned bits = 0;
+	std::uint64_t size = 0;
+public:
+	static const size_t chunk_bytes = 31;
+	static const size_t chunk_elements = 8;
+	void write(const void *src, size_t size, std::vector<FiniteField32> &dst);
+	void finish(std::vector<FiniteField32> &dst);
+};
+
+//The inverse of SecretFragmenter. Holds back the last 31 bytes it decodes,
+//since it can't tell the padding from the data until it has seen the end. If
+//the padding is malformed, as happens when too few shares are combined, the
+//data is returned as is.
+class SecretDefragmenter{
+	std::uint64_t accumulator = 0;
+	unsigned bits = 0;
+	std::string pending;
+public:
+	void write(const FiniteField32 *src, size_t size, std::string &dst);
+	void finish(std::string &dst);
+};
+
 class ShamirShare{
 public:
+	//Version 0 shares stored the secret as a single base-P number, which took
+	//quadratic time to convert. They have no version byte when serialized,
+	//and can still be recovered.
+	static const std::uint8_t legacy_version = 0;
+	static const std::uint8_t current_version = 1;
+	//Shares too big to hold in memory are written in chunks by ShareWriter,
+	//and can only be read back by ShareReader.
+	static const std::uint8_t chunked_version = 2;
+
+	std::uint8_t version = current_version;
 	hash::digest::SHA256 secret_digest;
 	FiniteField32 x;
 	std::vector<FiniteField32> y;
@@ -92,10 +154,28 @@ public:
 	std::vector<std::uint8_t> serialize() const;
 };
 
+//The values of the Lagrange basis polynomials for the given x coordinates at
+//zero, so that the polynomial through (x[i], y[i]) has the value
+//sum(weights[i] * y[i]) at zero. Throws if two x coordinates are equal
+//modulo P, or if one is 0 modulo P.
+std::vector<FiniteField32> lagrange_weights(const std::vector<FiniteField32> &x);
+
 std::vector<FiniteField32> fragment_secret(const std::string &secret);
+std::string defragment_secret(const std::vector<FiniteField32> &fragments, std::uint8_t version = ShamirShare::current_version);
+
+namespace detail{
+
+//Fills in the y coordinates of the shares, whose x coordinates must already
+//be set, from polynomials with the fragments as constant terms and random
+//coefficients generated from the seed.
+void evaluate_shares(std::vector<ShamirShare> &shares, const std::vector<FiniteField32> &fragments, std::uint32_t threshold, const std::array<std::uint8_t, 32> &seed, unsigned threads);
+
+}
 
+//Fragments are shared in parallel. Passing 0 threads uses one thread per
+//hardware thread, but small secrets are always shared on a single thread.
 template <typename C>
-std::vector<ShamirShare> share_secret(const std::string &secret, std::uint32_t shares, std::uint32_t threshold, csprng::BlockCipherRng<C> &rng){
+std::vector<ShamirShare> share_secret(const std::string &secret, std::uint32_t shares, std::uint32_t threshold, csprng::BlockCipherRng<C> &rng, unsigned threads = 0){
 	if (shares < 2 || threshold < 2 || threshold > shares)
 		throw std::runtime_error("invalid parameters");
 
@@ -107,25 +187,103 @@ std::vector<ShamirShare> share_secret(const std::string &secret, std::uint32_t s
 		ret[i].secret_digest = digest;
 		ret[i].x = i + 1;
 	}
-	auto fragmented = fragment_secret(secret);
-	std::vector<std::pair<FiniteField32, FiniteField32>> solutions;
-	solutions.reserve(threshold);
-	for (auto fragment : fragmented){
-		solutions.clear();
-		solutions.emplace_back(0, fragment);
-		for (std::uint32_t i = 1; i < threshold; i++){
-			std::uint32_t n;
-			do
-				rng.get(n);
-			while (n >= FiniteField32::P);
-			solutions.emplace_back((std::uint32_t)solutions.size(), n);
-		}
-		auto poly = Polynomial::lagrange_polynomial(solutions);
-
-		for (auto &s : ret)
-			ret[(std::uint32_t)s.x - 1].y.emplace_back(poly.eval(s.x));
-	}
+	//The coefficients come from generators seeded from rng, so that threads
+	//can draw them independently.
+	std::array<std::uint8_t, 32> seed;
+	rng.get_bytes(seed.data(), seed.size());
+	detail::evaluate_shares(ret, fragment_secret(secret), threshold, seed, threads);
 	return ret;
 }
 
-std::string recover_secret(const std::vector<ShamirShare> &shares);
+//Fragments are recovered in parallel. Passing 0 threads uses one thread per
+//hardware thread, but small secrets are always recovered on a single thread.
+std::string recover_secret(const std::vector<ShamirShare> &shares, unsigned threads = 0);
+
+//Chunked shares are laid out as
+//
+//    version (1 byte) | x (4 bytes) | chunk size (4 bytes)
+//
+//followed by chunks of
+//
+//    index (8 bytes) | count (4 bytes) | y (4 bytes each) | digest (32 bytes)
+//
+//where the digest is the SHA-256 of x and the rest of the chunk. It is not
+//keyed, so it only catches accidental corruption and truncation; anyone can
+//recompute it for a chunk they have tampered with. Every chunk
+//holds chunk size fragments, except that the last one with data may hold
+//fewer. The share ends with a chunk with a count of 0, and the secret's
+//digest in place of y.
+class ShareWriter{
+	utility::DataSink *sink;
+	std::uint32_t x;
+	std::uint32_t chunk_size;
+	std::uint64_t index = 0;
+	std::vector<FiniteField32> pending;
+	std::vector<std::uint8_t> buffer;
+
+	void write_chunk(const FiniteField32 *src, size_t size, const hash::digest::SHA256 *secret_digest = nullptr);
+public:
+	static const std::uint32_t default_chunk_size = 1 << 14;
+	static const std::uint32_t max_chunk_size = 1 << 24;
+
+	ShareWriter(utility::DataSink &sink, FiniteField32 x, std::uint32_t chunk_size = default_chunk_size);
+	ShareWriter(const ShareWriter &) = delete;
+	ShareWriter &operator=(const ShareWriter &) = delete;
+	ShareWriter(ShareWriter &&) = default;
+	ShareWriter &operator=(ShareWriter &&) = default;
+	void write(const FiniteField32 *src, size_t size);
+	void finish(const hash::digest::SHA256 &secret_digest);
+};
+
+class ShareReader{
+	utility::DataSource *source;
+	FiniteField32 x;
+	std::uint32_t chunk_size;
+	std::uint64_t index = 0;
+	bool finished = false;
+	bool short_chunk_seen = false;
+	hash::digest::SHA256 secret_digest;
+	std::vector<std::uint8_t> buffer;
+public:
+	//Reads the header.
+	ShareReader(utility::DataSource &source);
+	ShareReader(const ShareReader &) = delete;
+	ShareReader &operator=(const ShareReader &) = delete;
+	ShareReader(ShareReader &&) = default;
+	ShareReader &operator=(ShareReader &&) = default;
+	FiniteField32 get_x() const{
+		return this->x;
+	}
+	std::uint32_t get_chunk_size() const{
+		return this->chunk_size;
+	}
+	//Replaces the contents of dst with the next chunk. Returns false at the
+	//end of the share, after which get_secret_digest() is valid. Throws if the
+	//chunk is corrupt, out of order, or truncated.
+	bool read_chunk(std::vector<FiniteField32> &dst);
+	const hash::digest::SHA256 &get_secret_digest() const{
+		return this->secret_digest;
+	}
+};
+
+namespace detail{
+
+void share_secret(utility::DataSource &secret, const std::vector<utility::DataSink *> &shares, std::uint32_t threshold, const std::array<std::uint8_t, 32> &seed, unsigned threads);
+
+}
+
+//Streaming versions, which only hold a chunk of each share in memory at a
+//time. Each sink receives a chunked share.
+template <typename C>
+void share_secret(utility::DataSource &secret, const std::vector<utility::DataSink *> &shares, std::uint32_t threshold, csprng::BlockCipherRng<C> &rng, unsigned threads = 0){
+	if (shares.size() < 2 || threshold < 2 || threshold > shares.size())
+		throw std::runtime_error("invalid parameters");
+	std::array<std::uint8_t, 32> seed;
+	rng.get_bytes(seed.data(), seed.size());
+	detail::share_secret(secret, shares, threshold, seed, threads);
+}
+
+//The sources are read in lockstep, a chunk at a time. The secret is only
+//checked against its digest at the end, so if this throws, whatever was
+//written to the sink must be discarded.
+void recover_secret(const std::vector<utility::DataSource *> &shares, utility::DataSink &secret, unsigned threads = 0);
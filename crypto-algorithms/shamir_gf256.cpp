@@ -0,0 +1,181 @@
+#include "shamir_gf256.hpp"
+#include <stdexcept>
+#include <cstring>
+
+namespace{
+
+//Amount of secret processed at a time by the streaming functions.
+const size_t block_size = 64 << 10;
+
+void check_parameters(std::uint32_t shares, std::uint32_t threshold){
+	if (shares < 2 || shares > 255 || threshold < 2 || threshold > shares)
+		throw std::runtime_error("invalid parameters");
+}
+
+//Computes size bytes of every share from size bytes of the secret. Share i is
+//the value at x = i + 1 of a polynomial of degree threshold - 1 with random
+//coefficients and the secret as its constant term, evaluated with Horner's
+//rule.
+void share_block(const std::uint8_t *secret, size_t size, std::uint8_t * const *shares, std::uint32_t share_count, std::uint32_t threshold, std::vector<std::uint8_t> &coefficients, csprng::Prng &rng){
+	if (!size)
+		return;
+	const auto degree = threshold - 1;
+	coefficients.resize(degree * size);
+	rng.get_bytes(coefficients.data(), coefficients.size());
+	for (std::uint32_t i = 0; i < share_count; i++){
+		auto x = (std::uint8_t)(i + 1);
+		auto y = shares[i];
+		memcpy(y, coefficients.data() + (degree - 1) * size, size);
+		for (auto j = degree - 1; j--;)
+			gf256::multiply_xor(y, coefficients.data() + j * size, x, size);
+		gf256::multiply_xor(y, secret, x, size);
+	}
+}
+
+//The Lagrange basis polynomials evaluated at 0, so that the secret is the
+//sum of the shares weighted by these.
+std::vector<std::uint8_t> lagrange_weights(const std::vector<std::uint8_t> &xs){
+	std::vector<std::uint8_t> ret;
+	ret.reserve(xs.size());
+	for (size_t i = 0; i < xs.size(); i++){
+		std::uint8_t numerator = 1;
+		std::uint8_t denominator = 1;
+		for (size_t j = 0; j < xs.size(); j++){
+			if (i == j)
+				continue;
+			if (xs[i] == xs[j])
+				throw std::runtime_error("duplicate shares");
+			numerator = gf256::multiply(numerator, xs[j]);
+			denominator = gf256::multiply(denominator, xs[i] ^ xs[j]);
+		}
+		ret.push_back(gf256::divide(numerator, denominator));
+	}
+	return ret;
+}
+
+void recover_block(std::uint8_t *secret, const std::uint8_t * const *shares, const std::vector<std::uint8_t> &weights, size_t size){
+	memset(secret, 0, size);
+	for (size_t i = 0; i < weights.size(); i++)
+		gf256::multiply_add(secret, shares[i], weights[i], size);
+}
+
+}
+
+namespace gf256{
+
+Share::Share(const std::vector<std::uint8_t> &buffer){
+	if (buffer.empty() || !buffer.front())
+		throw std::runtime_error("invalid serialized GF(2^8) Shamir share");
+	this->x = buffer.front();
+	this->y.assign(buffer.begin() + 1, buffer.end());
+}
+
+std::vector<std::uint8_t> Share::serialize() const{
+	std::vector<std::uint8_t> ret;
+	ret.reserve(1 + this->y.size());
+	ret.push_back(this->x);
+	ret.insert(ret.end(), this->y.begin(), this->y.end());
+	return ret;
+}
+
+std::vector<Share> share_secret(const void *secret, size_t size, std::uint32_t shares, std::uint32_t threshold, csprng::Prng &rng){
+	check_parameters(shares, threshold);
+	std::vector<Share> ret(shares);
+	std::vector<std::uint8_t *> outputs(shares);
+	for (std::uint32_t i = 0; i < shares; i++){
+		ret[i].x = (std::uint8_t)(i + 1);
+		ret[i].y.resize(size);
+		outputs[i] = ret[i].y.data();
+	}
+	std::vector<std::uint8_t> coefficients;
+	auto src = (const std::uint8_t *)secret;
+	for (size_t offset = 0; offset < size; offset += block_size){
+		auto n = std::min(block_size, size - offset);
+		share_block(src + offset, n, outputs.data(), shares, threshold, coefficients, rng);
+		for (auto &p : outputs)
+			p += n;
+	}
+	return ret;
+}
+
+std::string recover_secret(const std::vector<Share> &shares){
+	if (shares.size() < 2)
+		throw std::runtime_error("invalid parameters");
+	std::vector<std::uint8_t> xs;
+	std::vector<const std::uint8_t *> inputs;
+	auto size = shares.front().y.size();
+	for (auto &share : shares){
+		if (share.y.size() != size)
+			throw std::runtime_error("shares have different lengths");
+		xs.push_back(share.x);
+		inputs.push_back(share.y.data());
+	}
+	auto weights = lagrange_weights(xs);
+	std::string ret(size, 0);
+	if (size)
+		recover_block((std::uint8_t *)&ret[0], inputs.data(), weights, size);
+	return ret;
+}
+
+void share_secret(utility::DataSource &secret, const std::vector<utility::DataSink *> &shares, std::uint32_t threshold, csprng::Prng &rng){
+	auto share_count = (std::uint32_t)shares.size();
+	check_parameters(share_count, threshold);
+	for (std::uint32_t i = 0; i < share_count; i++){
+		std::uint8_t x = (std::uint8_t)(i + 1);
+		utility::write_fully(*shares[i], &x, 1);
+	}
+
+	std::vector<std::uint8_t> input(block_size);
+	std::vector<std::uint8_t> output(block_size * share_count);
+	std::vector<std::uint8_t *> outputs(share_count);
+	std::vector<std::uint8_t> coefficients;
+	while (true){
+		auto n = utility::read_fully(secret, input.data(), block_size);
+		if (!n)
+			break;
+		for (std::uint32_t i = 0; i < share_count; i++)
+			outputs[i] = output.data() + i * n;
+		share_block(input.data(), n, outputs.data(), share_count, threshold, coefficients, rng);
+		for (std::uint32_t i = 0; i < share_count; i++)
+			utility::write_fully(*shares[i], outputs[i], n);
+	}
+	for (auto sink : shares)
+		sink->flush();
+}
+
+void recover_secret(const std::vector<utility::DataSource *> &shares, utility::DataSink &secret){
+	if (shares.size() < 2)
+		throw std::runtime_error("invalid parameters");
+	std::vector<std::uint8_t> xs(shares.size());
+	for (size_t i = 0; i < shares.size(); i++)
+		if (!utility::read_fully(*shares[i], &xs[i], 1) || !xs[i])
+			throw std::runtime_error("invalid serialized GF(2^8) Shamir share");
+	auto weights = lagrange_weights(xs);
+
+	//Read every share in lockstep.
+	std::vector<std::uint8_t> input(block_size * shares.size());
+	std::vector<const std::uint8_t *> inputs(shares.size());
+	std::vector<std::uint8_t> output(block_size);
+	while (true){
+		auto n = utility::read_fully(*shares[0], input.data(), block_size);
+		for (size_t i = 1; i < shares.size(); i++){
+			if (utility::read_fully(*shares[i], input.data() + i * block_size, n) != n)
+				throw std::runtime_error("shares have different lengths");
+		}
+		if (!n){
+			//The first share may be the shortest.
+			std::uint8_t extra;
+			for (size_t i = 1; i < shares.size(); i++)
+				if (utility::read_fully(*shares[i], &extra, 1))
+					throw std::runtime_error("shares have different lengths");
+			break;
+		}
+		for (size_t i = 0; i < shares.size(); i++)
+			inputs[i] = input.data() + i * block_size;
+		recover_block(output.data(), inputs.data(), weights, n);
+		utility::write_fully(secret, output.data(), n);
+	}
+	secret.flush();
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "gf256.hpp"
+#include "rng.hpp"
+#include "source_sink.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Shamir's secret sharing over GF(2^8), with every byte of the secret shared
+//independently. Much faster than the FiniteField32 scheme in shamir.hpp, and
+//each share is exactly one byte longer than the secret: its x coordinate,
+//followed by one y coordinate per byte of the secret. At most 255 shares can
+//be made. Unlike ShamirShare, nothing in a share identifies the secret, so
+//combining shares from different secrets, or too few shares, silently
+//recovers garbage.
+namespace gf256{
+
+class Share{
+public:
+	std::uint8_t x = 0;
+	std::vector<std::uint8_t> y;
+
+	Share() = default;
+	Share(const std::vector<std::uint8_t> &);
+	Share(const Share &) = default;
+	Share &operator=(const Share &) = default;
+	Share(Share &&) = default;
+	Share &operator=(Share &&) = default;
+	std::vector<std::uint8_t> serialize() const;
+};
+
+std::vector<Share> share_secret(const void *secret, size_t size, std::uint32_t shares, std::uint32_t threshold, csprng::Prng &rng);
+inline std::vector<Share> share_secret(const std::string &secret, std::uint32_t shares, std::uint32_t threshold, csprng::Prng &rng){
+	return share_secret(secret.data(), secret.size(), shares, threshold, rng);
+}
+std::string recover_secret(const std::vector<Share> &shares);
+
+//Streaming versions, which never hold more than a block of the secret in
+//memory. Each sink receives a serialized share. The sources must be
+//positioned at the start of serialized shares.
+void share_secret(utility::DataSource &secret, const std::vector<utility::DataSink *> &shares, std::uint32_t threshold, csprng::Prng &rng);
+void recover_secret(const std::vector<utility::DataSource *> &shares, utility::DataSink &secret);
+
+}
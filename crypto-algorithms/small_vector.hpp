@@ -0,0 +1,286 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace utility{
+
+//Hands out blocks in power of two sizes, and keeps freed blocks in per-thread
+//free lists for reuse instead of returning them to the heap. Blocks may be
+//freed by a different thread than the one that allocated them.
+template <typename T>
+class PoolAllocator{
+	//Free lists for blocks of 2^i elements.
+	static const size_t classes = sizeof(size_t) * 8;
+	//Blocks kept per class. Any more are returned to the heap.
+	static const size_t max_free_blocks = 64;
+
+	struct FreeBlock{
+		FreeBlock *next;
+	};
+
+	struct FreeLists{
+		FreeBlock *heads[classes] = {};
+		size_t counts[classes] = {};
+
+		FreeLists() = default;
+		FreeLists(const FreeLists &) = delete;
+		FreeLists &operator=(const FreeLists &) = delete;
+		~FreeLists(){
+			for (auto head : this->heads){
+				while (head){
+					auto next = head->next;
+					::operator delete(head);
+					head = next;
+				}
+			}
+		}
+	};
+
+	static FreeLists &free_lists(){
+		thread_local FreeLists ret;
+		return ret;
+	}
+	static size_t size_class(size_t n){
+		size_t ret = 0;
+		while (((size_t)1 << ret) < n)
+			ret++;
+		return ret;
+	}
+public:
+	typedef T value_type;
+
+	PoolAllocator() = default;
+	template <typename T2>
+	PoolAllocator(const PoolAllocator<T2> &){}
+
+	//Rounds a request up to the size of the block that would be returned, so
+	//that callers can use all of it.
+	static size_t round_up(size_t n){
+		return (size_t)1 << size_class(n);
+	}
+	T *allocate(size_t n){
+		auto c = size_class(n);
+		auto &lists = free_lists();
+		if (auto block = lists.heads[c]){
+			lists.heads[c] = block->next;
+			lists.counts[c]--;
+			return (T *)block;
+		}
+		return (T *)::operator new(std::max(sizeof(T) << c, sizeof(FreeBlock)));
+	}
+	void deallocate(T *p, size_t n){
+		auto c = size_class(n);
+		auto &lists = free_lists();
+		if (lists.counts[c] >= max_free_blocks){
+			::operator delete(p);
+			return;
+		}
+		auto block = (FreeBlock *)p;
+		block->next = lists.heads[c];
+		lists.heads[c] = block;
+		lists.counts[c]++;
+	}
+	template <typename T2>
+	bool operator==(const PoolAllocator<T2> &) const{
+		return true;
+	}
+	template <typename T2>
+	bool operator!=(const PoolAllocator<T2> &) const{
+		return false;
+	}
+};
+
+//A vector of trivially copyable elements that keeps up to N of them inside
+//the object itself, and only goes to the allocator for more.
+template <typename T, size_t N, typename Allocator = std::allocator<T>>
+class SmallVector{
+	static_assert(std::is_trivially_copyable<T>::value, "SmallVector only supports trivially copyable types!");
+	static_assert(N > 0, "SmallVector needs some inline storage!");
+
+	T *elements;
+	size_t count = 0;
+	size_t allocated = N;
+	T buffer[N];
+
+	bool is_inline() const{
+		return this->elements == this->buffer;
+	}
+	void release(){
+		if (!this->is_inline())
+			Allocator().deallocate(this->elements, this->allocated);
+		this->elements = this->buffer;
+		this->allocated = N;
+	}
+	//Takes other's heap block if it has one, and copies its elements
+	//otherwise. Leaves other empty.
+	void steal(SmallVector &other) noexcept{
+		if (other.is_inline()){
+			this->elements = this->buffer;
+			this->allocated = N;
+			memcpy(this->buffer, other.buffer, other.count * sizeof(T));
+		}else{
+			this->elements = other.elements;
+			this->allocated = other.allocated;
+			other.elements = other.buffer;
+			other.allocated = N;
+		}
+		this->count = other.count;
+		other.count = 0;
+	}
+	static size_t round_up(size_t n){
+		if constexpr (std::is_same<Allocator, PoolAllocator<T>>::value)
+			return PoolAllocator<T>::round_up(n);
+		else
+			return n;
+	}
+public:
+	typedef T value_type;
+	typedef T *iterator;
+	typedef const T *const_iterator;
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+	SmallVector(): elements(buffer){}
+	SmallVector(size_t n, const T &value = T()): elements(buffer){
+		this->resize(n, value);
+	}
+	SmallVector(const SmallVector &other): elements(buffer){
+		*this = other;
+	}
+	SmallVector(SmallVector &&other) noexcept{
+		this->steal(other);
+	}
+	~SmallVector(){
+		this->release();
+	}
+	SmallVector &operator=(const SmallVector &other){
+		if (this == &other)
+			return *this;
+		this->count = 0;
+		this->reserve(other.count);
+		memcpy(this->elements, other.elements, other.count * sizeof(T));
+		this->count = other.count;
+		return *this;
+	}
+	SmallVector &operator=(SmallVector &&other) noexcept{
+		if (this == &other)
+			return *this;
+		this->release();
+		this->steal(other);
+		return *this;
+	}
+
+	size_t size() const{
+		return this->count;
+	}
+	bool empty() const{
+		return !this->count;
+	}
+	size_t capacity() const{
+		return this->allocated;
+	}
+	T *data(){
+		return this->elements;
+	}
+	const T *data() const{
+		return this->elements;
+	}
+	T &operator[](size_t i){
+		return this->elements[i];
+	}
+	const T &operator[](size_t i) const{
+		return this->elements[i];
+	}
+	T &front(){
+		return this->elements[0];
+	}
+	const T &front() const{
+		return this->elements[0];
+	}
+	T &back(){
+		return this->elements[this->count - 1];
+	}
+	const T &back() const{
+		return this->elements[this->count - 1];
+	}
+	iterator begin(){
+		return this->elements;
+	}
+	iterator end(){
+		return this->elements + this->count;
+	}
+	const_iterator begin() const{
+		return this->elements;
+	}
+	const_iterator end() const{
+		return this->elements + this->count;
+	}
+	reverse_iterator rbegin(){
+		return reverse_iterator(this->end());
+	}
+	reverse_iterator rend(){
+		return reverse_iterator(this->begin());
+	}
+	const_reverse_iterator rbegin() const{
+		return const_reverse_iterator(this->end());
+	}
+	const_reverse_iterator rend() const{
+		return const_reverse_iterator(this->begin());
+	}
+
+	void reserve(size_t n){
+		if (n <= this->allocated)
+			return;
+		n = round_up(std::max(n, this->allocated * 2));
+		auto p = Allocator().allocate(n);
+		memcpy(p, this->elements, this->count * sizeof(T));
+		this->release();
+		this->elements = p;
+		this->allocated = n;
+	}
+	void resize(size_t n, const T &value = T()){
+		this->reserve(n);
+		if (n > this->count)
+			std::fill(this->elements + this->count, this->elements + n, value);
+		this->count = n;
+	}
+	void clear(){
+		this->count = 0;
+	}
+	void push_back(const T &value){
+		//value may be one of the elements, so it's copied before growing.
+		auto copy = value;
+		this->reserve(this->count + 1);
+		this->elements[this->count++] = copy;
+	}
+	void pop_back(){
+		this->count--;
+	}
+	iterator insert(const_iterator position, size_t n, const T &value){
+		auto offset = position - this->elements;
+		auto copy = value;
+		this->reserve(this->count + n);
+		auto p = this->elements + offset;
+		memmove(p + n, p, (this->count - offset) * sizeof(T));
+		std::fill(p, p + n, copy);
+		this->count += n;
+		return p;
+	}
+	iterator erase(const_iterator first, const_iterator last){
+		auto offset = first - this->elements;
+		auto n = last - first;
+		auto p = this->elements + offset;
+		memmove(p, p + n, (this->count - offset - n) * sizeof(T));
+		this->count -= n;
+		return p;
+	}
+};
+
+}
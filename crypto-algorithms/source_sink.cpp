@@ -1,5 +1,6 @@
 #include "source_sink.hpp"
 #include "ringbuffer.hpp"
+#include <stdexcept>
 
 namespace utility{
 
@@ -8,6 +9,34 @@ DataSource &DataSource::operator>>(DataSink &sink){
 	return *this;
 }
 
+size_t read_fully(DataSource &source, void *void_dst, size_t size){
+	auto dst = (std::uint8_t *)void_dst;
+	size_t ret = 0;
+	while (ret < size){
+		auto read = source.read(dst + ret, size - ret);
+		if (!read)
+			break;
+		ret += read;
+	}
+	return ret;
+}
+
+void read_exactly(DataSource &source, void *dst, size_t size){
+	if (read_fully(source, dst, size) != size)
+		throw std::runtime_error("unexpected end of data");
+}
+
+void write_fully(DataSink &sink, const void *void_src, size_t size){
+	auto src = (const std::uint8_t *)void_src;
+	while (size){
+		auto written = sink.write(src, size);
+		if (!written)
+			throw std::runtime_error("failed to write data");
+		src += written;
+		size -= written;
+	}
+}
+
 DataSink &DataSink::operator<<(DataSource &source){
 	RingBuffer buffer(128 << 10);
 	bool ok = true;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "hash.hpp"
 #include <iostream>
 #include <memory>
 #include <cstdint>
@@ -29,6 +30,14 @@ public:
 	virtual DataSink &operator<<(DataSource &);
 };
 
+//Reads until dst is full or the source runs out. Returns the number of bytes
+//read, which is less than size only at the end of the data.
+size_t read_fully(DataSource &, void *dst, size_t size);
+//The same, but a short read throws.
+void read_exactly(DataSource &, void *dst, size_t size);
+//Throws if the sink stops accepting data.
+void write_fully(DataSink &, const void *src, size_t size);
+
 class StdDataSource : public DataSource{
 	std::unique_ptr<std::istream> stream;
 public:
@@ -82,4 +91,50 @@ public:
 	}
 };
 
+//Tee adapters that feed every span passing through them to a hash, without
+//buffering it anywhere. Hash can be any type with an
+//update(const void *, size_t) member, including
+//asymmetric::Ed25519::ProgressiveVerifier.
+
+template <typename Hash = hash::algorithm::HashAlgorithm>
+class HashingSink : public DataSink{
+	DataSink *sink;
+	Hash *hash;
+public:
+	//Hashes the data and forwards it to sink.
+	HashingSink(DataSink &sink, Hash &hash): sink(&sink), hash(&hash){}
+	//Hashes the data and discards it.
+	HashingSink(Hash &hash): sink(nullptr), hash(&hash){}
+	HashingSink(const HashingSink &) = default;
+	HashingSink &operator=(const HashingSink &) = default;
+	size_t write(const void *src, size_t size) override{
+		if (this->sink)
+			size = this->sink->write(src, size);
+		this->hash->update(src, size);
+		return size;
+	}
+	void flush() override{
+		if (this->sink)
+			this->sink->flush();
+	}
+};
+
+template <typename Hash = hash::algorithm::HashAlgorithm>
+class HashingSource : public DataSource{
+	DataSource *source;
+	Hash *hash;
+public:
+	HashingSource(DataSource &source, Hash &hash): source(&source), hash(&hash){}
+	HashingSource(const HashingSource &) = default;
+	HashingSource &operator=(const HashingSource &) = default;
+	size_t read(void *dst, size_t size) override{
+		auto ret = this->source->read(dst, size);
+		this->hash->update(dst, ret);
+		return ret;
+	}
+	std::optional<size_t> available() const override{
+		return this->source->available();
+	}
+};
+
 }
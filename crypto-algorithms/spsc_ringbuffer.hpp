@@ -0,0 +1,272 @@
+#pragma once
+
+#include "ringbuffer.hpp"
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utility{
+
+//A ring buffer that can be shared by exactly one producer thread and one
+//consumer thread without locking. The producer only ever calls the write
+//side (write(), prepare_writable()/commit(), read_from_source(), close()) and
+//the consumer only the read side (read(), peek_readable()/consume(),
+//write_to_sink()). Data becomes visible to the consumer once per commit, so
+//writing in large batches keeps cross-core traffic down.
+//
+//Every operation has a non-blocking form, which transfers as much as it can
+//right away, and the wait_*() functions block until the other side makes
+//progress. Blocking waits spin briefly and then sleep, and the other side
+//only pays for a wakeup when somebody is actually sleeping.
+class SpscRingBuffer{
+	static const size_t cache_line = 64;
+	static const int spin_count = 256;
+
+	std::vector<std::uint8_t> data;
+	size_t capacity = 0;
+	size_t mask = 0;
+
+	//Each index is written only by its owner, and lives on its own cache line
+	//together with the owner's cached copy of the other index, so the two
+	//threads don't invalidate each other's lines on every operation.
+	alignas(cache_line) std::atomic<size_t> head{0};
+	size_t cached_tail = 0;
+	alignas(cache_line) std::atomic<size_t> tail{0};
+	size_t cached_head = 0;
+	alignas(cache_line) std::atomic<bool> closed{false};
+	std::atomic<int> sleepers{0};
+	std::mutex mutex;
+	std::condition_variable condition;
+
+	void wake(){
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!this->sleepers.load(std::memory_order_relaxed))
+			return;
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->condition.notify_all();
+	}
+	template <typename F>
+	void wait(const F &ready){
+		for (int i = 0; i < spin_count; i++){
+			if (ready())
+				return;
+			std::this_thread::yield();
+		}
+		std::unique_lock<std::mutex> lock(this->mutex);
+		this->sleepers.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		while (!ready())
+			this->condition.wait(lock);
+		this->sleepers.fetch_sub(1, std::memory_order_relaxed);
+	}
+	//The other side's index is only reloaded when the cached copy says there
+	//isn't enough room or data.
+	size_t readable_size(size_t needed = 1){
+		auto head = this->head.load(std::memory_order_relaxed);
+		if (this->cached_tail - head < needed)
+			this->cached_tail = this->tail.load(std::memory_order_acquire);
+		return this->cached_tail - head;
+	}
+	size_t writable_size(size_t needed = 1){
+		auto tail = this->tail.load(std::memory_order_relaxed);
+		if (this->capacity - (tail - this->cached_head) < needed)
+			this->cached_head = this->head.load(std::memory_order_acquire);
+		return this->capacity - (tail - this->cached_head);
+	}
+public:
+	//The capacity is rounded up to a power of two.
+	explicit SpscRingBuffer(size_t capacity){
+		this->capacity = 1;
+		while (this->capacity < capacity)
+			this->capacity *= 2;
+		this->mask = this->capacity - 1;
+		this->data.resize(this->capacity);
+	}
+	SpscRingBuffer(const SpscRingBuffer &) = delete;
+	SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+	SpscRingBuffer(SpscRingBuffer &&) = delete;
+	SpscRingBuffer &operator=(SpscRingBuffer &&) = delete;
+
+	//Producer side.
+
+	std::array<Span, 2> prepare_writable(){
+		std::array<Span, 2> ret;
+		auto free = this->writable_size();
+		auto write_pos = this->tail.load(std::memory_order_relaxed) & this->mask;
+		auto first = std::min(this->capacity - write_pos, free);
+		ret[0] = { this->data.data() + write_pos, first };
+		ret[1] = { this->data.data(), free - first };
+		return ret;
+	}
+	//Publishes size bytes written through prepare_writable().
+	void commit(size_t size){
+		size = std::min(size, this->writable_size(size));
+		if (!size)
+			return;
+		this->tail.store(this->tail.load(std::memory_order_relaxed) + size, std::memory_order_release);
+		this->wake();
+	}
+	size_t write(const void *vsrc, size_t size){
+		auto src = (const std::uint8_t *)vsrc;
+		size_t ret = 0;
+		for (auto &span : this->prepare_writable()){
+			auto n = std::min(span.size, size - ret);
+			if (n)
+				memcpy(span.data, src + ret, n);
+			ret += n;
+		}
+		this->commit(ret);
+		return ret;
+	}
+	size_t read_from_source(DataSource &source, size_t max_bytes = std::numeric_limits<size_t>::max()){
+		size_t ret = 0;
+		for (auto &span : this->prepare_writable()){
+			auto n = std::min(span.size, max_bytes - ret);
+			if (!n)
+				break;
+			auto read = source.read(span.data, n);
+			ret += read;
+			if (read < n)
+				break;
+		}
+		this->commit(ret);
+		return ret;
+	}
+	//Blocks until at least size bytes can be written.
+	void wait_for_free(size_t size){
+		size = std::min(size, this->capacity);
+		this->wait([this, size](){ return this->writable_size(size) >= size; });
+	}
+	//Writes the entire buffer, blocking as needed.
+	void write_all(const void *vsrc, size_t size){
+		auto src = (const std::uint8_t *)vsrc;
+		while (size){
+			this->wait_for_free(1);
+			auto written = this->write(src, size);
+			src += written;
+			size -= written;
+		}
+	}
+	//Marks the end of the data. The consumer will see the buffer as finished
+	//once it has read everything written before this call.
+	void close(){
+		this->closed.store(true, std::memory_order_release);
+		this->wake();
+	}
+
+	//Consumer side.
+
+	std::array<ConstSpan, 2> peek_readable(){
+		std::array<ConstSpan, 2> ret;
+		auto length = this->readable_size();
+		auto read_pos = this->head.load(std::memory_order_relaxed) & this->mask;
+		auto first = std::min(this->capacity - read_pos, length);
+		ret[0] = { this->data.data() + read_pos, first };
+		ret[1] = { this->data.data(), length - first };
+		return ret;
+	}
+	//Releases size bytes read through peek_readable() back to the producer.
+	void consume(size_t size){
+		size = std::min(size, this->readable_size(size));
+		if (!size)
+			return;
+		this->head.store(this->head.load(std::memory_order_relaxed) + size, std::memory_order_release);
+		this->wake();
+	}
+	size_t read(void *vdst, size_t size){
+		auto dst = (std::uint8_t *)vdst;
+		size_t ret = 0;
+		for (auto &span : this->peek_readable()){
+			auto n = std::min(span.size, size - ret);
+			if (n)
+				memcpy(dst + ret, span.data, n);
+			ret += n;
+		}
+		this->consume(ret);
+		return ret;
+	}
+	size_t write_to_sink(DataSink &sink, size_t max_bytes = std::numeric_limits<size_t>::max()){
+		size_t ret = 0;
+		for (auto &span : this->peek_readable()){
+			auto n = std::min(span.size, max_bytes - ret);
+			if (!n)
+				break;
+			sink.write(span.data, n);
+			ret += n;
+		}
+		this->consume(ret);
+		return ret;
+	}
+	//Blocks until at least size bytes can be read or the producer has closed
+	//the buffer. Returns false if the buffer was closed before that many bytes
+	//became available.
+	bool wait_for_data(size_t size){
+		size = std::min(size, this->capacity);
+		this->wait([this, size](){
+			return this->readable_size(size) >= size || this->closed.load(std::memory_order_acquire);
+		});
+		return this->readable_size(size) >= size;
+	}
+	//True once the producer has closed the buffer and everything has been
+	//read.
+	bool finished(){
+		return this->closed.load(std::memory_order_acquire) && !this->readable_size();
+	}
+
+	//Either side. The values are only a snapshot when the other side is
+	//active.
+
+	size_t free() const{
+		return this->capacity - this->get_length();
+	}
+	size_t get_length() const{
+		return this->tail.load(std::memory_order_acquire) - this->head.load(std::memory_order_acquire);
+	}
+	size_t get_capacity() const{
+		return this->capacity;
+	}
+};
+
+//Adapters that let the producer write into an SpscRingBuffer as a DataSink,
+//and the consumer read from it as a DataSource, so that existing stages can
+//be connected across threads. Both block as needed.
+
+class SpscBufferSink : public DataSink{
+	SpscRingBuffer *buffer;
+public:
+	SpscBufferSink(SpscRingBuffer &buffer): buffer(&buffer){}
+	size_t write(const void *src, size_t size) override{
+		this->buffer->write_all(src, size);
+		return size;
+	}
+	//Signals end of stream to the consumer.
+	void close(){
+		this->buffer->close();
+	}
+};
+
+class SpscBufferSource : public DataSource{
+	SpscRingBuffer *buffer;
+public:
+	SpscBufferSource(SpscRingBuffer &buffer): buffer(&buffer){}
+	//Blocks until some data is available. Returns 0 only at the end of the
+	//stream.
+	size_t read(void *dst, size_t size) override{
+		if (!size)
+			return 0;
+		this->buffer->wait_for_data(1);
+		return this->buffer->read(dst, size);
+	}
+	std::optional<size_t> available() const override{
+		return this->buffer->get_length();
+	}
+};
+
+}
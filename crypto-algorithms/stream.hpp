@@ -3,49 +3,67 @@
 #include "block.hpp"
 #include "source_sink.hpp"
 #include "ringbuffer.hpp"
+#include <array>
 
 namespace symmetric{
 
 namespace stream{
 
-template <typename Cipher>
-class CipherStream : public utility::DataSource, public utility::DataSink{
+//Buffers its input and transforms it a whole number of blocks at a time.
+//Buffer may be utility::RingBuffer or utility::MirroredRingBuffer. With the
+//latter, blocks never straddle the end of a buffer.
+template <size_t BlockSize, typename Buffer = utility::RingBuffer>
+class BlockStream : public utility::DataSource, public utility::DataSink{
 protected:
-	using block_t = typename Cipher::block_t;
-	Cipher c;
-	bool encrypt;
-	block_t iv;
-	utility::RingBuffer input_buffer;
-	utility::RingBuffer output_buffer;
+	Buffer input_buffer;
+	Buffer output_buffer;
 
 	void process_all(){
-		const auto bs = Cipher::block_size;
-		block_t block;
+		const auto bs = BlockSize;
 		while (true){
-			auto ilength = this->input_buffer.get_length();
-			if (ilength < bs)
-				break;
-			auto olength = this->output_buffer.free();
-			if (olength < bs)
+			//Process as many whole blocks as possible straight from the input
+			//buffer into the output buffer.
+			auto input = this->input_buffer.peek_readable()[0];
+			auto output = this->output_buffer.prepare_writable()[0];
+			auto blocks = std::min(input.size, output.size) / bs;
+			if (blocks){
+				this->process(output.data, input.data, blocks);
+				this->input_buffer.consume(blocks * bs);
+				this->output_buffer.commit(blocks * bs);
+				continue;
+			}
+
+			//The next block straddles the end of one of the buffers.
+			if (this->input_buffer.get_length() < bs || this->output_buffer.free() < bs)
 				break;
+			std::array<std::uint8_t, BlockSize> block;
 			this->input_buffer.read(block.data(), bs);
-			block = this->process(block);
+			this->process(block.data(), block.data(), 1);
 			this->output_buffer.write(block.data(), bs);
 		}
 	}
-	virtual block_t process(const block_t &) = 0;
+	//Processes a run of whole blocks. dst may be equal to src.
+	virtual void process(std::uint8_t *dst, const std::uint8_t *src, size_t blocks) = 0;
+	//Processes whatever is left in the input buffer, which is less than a
+	//block, as a truncated block. For use by stream ciphers.
+	void process_tail(){
+		this->process_all();
+		if (!this->input_buffer.get_length())
+			return;
+		std::array<std::uint8_t, BlockSize> block;
+		auto read = this->input_buffer.read(block.data(), block.size());
+		this->process(block.data(), block.data(), 1);
+		this->output_buffer.write(block.data(), read);
+	}
 public:
-	CipherStream(const Cipher &c, const block_t &iv, bool encrypt)
-		: c(c)
-		, encrypt(encrypt)
-		, iv(iv)
-		, input_buffer(128 << 10)
+	BlockStream()
+		: input_buffer(128 << 10)
 		, output_buffer(128 << 10){}
-	virtual ~CipherStream() = 0;
-	CipherStream(const CipherStream &) = delete;
-	CipherStream &operator=(const CipherStream &) = delete;
-	CipherStream(CipherStream &&other) = delete;
-	CipherStream &operator=(CipherStream &&other) = delete;
+	virtual ~BlockStream() = 0;
+	BlockStream(const BlockStream &) = delete;
+	BlockStream &operator=(const BlockStream &) = delete;
+	BlockStream(BlockStream &&other) = delete;
+	BlockStream &operator=(BlockStream &&other) = delete;
 	size_t write(const void *vsrc, size_t size) override{
 		auto src = (const std::uint8_t *)vsrc;
 		size_t ret = 0;
@@ -82,38 +100,54 @@ public:
 	virtual void terminate(){}
 };
 
-template <typename Cipher>
-CipherStream<Cipher>::~CipherStream(){}
+template <size_t BlockSize, typename Buffer>
+BlockStream<BlockSize, Buffer>::~BlockStream(){}
 
-template <typename Cipher>
-class CtrCipherStream : public CipherStream<Cipher>{
+template <typename Cipher, typename Buffer = utility::RingBuffer>
+class CipherStream : public BlockStream<Cipher::block_size, Buffer>{
+protected:
+	using block_t = typename Cipher::block_t;
+	Cipher c;
+	bool encrypt;
+	block_t iv;
+public:
+	CipherStream(const Cipher &c, const block_t &iv, bool encrypt)
+		: c(c)
+		, encrypt(encrypt)
+		, iv(iv){}
+	virtual ~CipherStream() = 0;
+};
+
+template <typename Cipher, typename Buffer>
+CipherStream<Cipher, Buffer>::~CipherStream(){}
+
+template <typename Cipher, typename Buffer = utility::RingBuffer>
+class CtrCipherStream : public CipherStream<Cipher, Buffer>{
 	std::uint64_t state = 0;
-	typename Cipher::block_t process(const typename Cipher::block_t &input) override{
-		auto ret = this->iv;
-		auto s = this->state++;
-		for (size_t i = 0; i < Cipher::block_size && s; i++){
-			ret[i] ^= s & 0xFF;
-			s >>= 8;
+	void process(std::uint8_t *dst, const std::uint8_t *src, size_t blocks) override{
+		const auto bs = Cipher::block_size;
+		for (size_t block = 0; block < blocks; block++){
+			auto ret = this->iv;
+			auto s = this->state++;
+			for (size_t i = 0; i < bs && s; i++){
+				ret[i] ^= s & 0xFF;
+				s >>= 8;
+			}
+			ret = this->c.encrypt_block(ret);
+			for (size_t i = 0; i < bs; i++)
+				dst[i] = ret[i] ^ src[i];
+			dst += bs;
+			src += bs;
 		}
-		ret = this->c.encrypt_block(ret);
-		for (size_t i = 0; i < Cipher::block_size; i++)
-			ret[i] ^= input[i];
-		return ret;
 	}
 public:
-	CtrCipherStream(const Cipher &c, const typename Cipher::block_t &iv, bool encrypt): CipherStream<Cipher>(c, iv, encrypt){}
+	CtrCipherStream(const Cipher &c, const typename Cipher::block_t &iv, bool encrypt): CipherStream<Cipher, Buffer>(c, iv, encrypt){}
 	CtrCipherStream(const CtrCipherStream &) = delete;
 	CtrCipherStream &operator=(const CtrCipherStream &) = delete;
 	CtrCipherStream(CtrCipherStream &&other) = delete;
 	CtrCipherStream &operator=(CtrCipherStream &&other) = delete;
 	void terminate() override{
-		this->process_all();
-		if (!this->input_buffer.get_length())
-			return;
-		typename Cipher::block_t ret;
-		auto read = this->input_buffer.read(ret.data(), ret.size());
-		ret = this->process(ret);
-		this->output_buffer.write(ret.data(), read);
+		this->process_tail();
 	}
 };
 
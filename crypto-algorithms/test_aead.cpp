@@ -0,0 +1,239 @@
+#include "test_aead.hpp"
+#include "gcm.hpp"
+#include "chacha20_poly1305.hpp"
+#include "aes.hpp"
+#include "test_utility.hpp"
+#include "hex.hpp"
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace{
+
+void aead_assert(bool condition, const char *string){
+	if (condition)
+		return;
+	throw std::runtime_error((std::string)"Failed test: " + string);
+}
+
+#define assert2(x) aead_assert(x, #x)
+
+std::vector<std::uint8_t> from_hex(const char *s){
+	std::vector<std::uint8_t> ret(strlen(s) / 2);
+	if (!utility::hex_decode(ret.data(), s, ret.size()))
+		throw utility::InvalidHexException();
+	return ret;
+}
+
+std::vector<std::uint8_t> make_data(size_t size){
+	std::vector<std::uint8_t> ret(size);
+	for (size_t i = 0; i < size; i++)
+		ret[i] = (std::uint8_t)(i * 89 + 5);
+	return ret;
+}
+
+template <size_t N>
+std::array<std::uint8_t, N> array_from_hex(const char *s){
+	return utility::hex_string_to_buffer<N>(s);
+}
+
+//RFC 8439, section 2.5.2.
+void test_poly1305(){
+	auto key = from_hex("85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b");
+	const char message[] = "Cryptographic Forum Research Group";
+	const char *expected = "a8061dc1305136c6c22b8baf0c0127a9";
+	assert2(utility::buffer_to_hex_string(hash::Poly1305::compute(key.data(), message, sizeof(message) - 1)) == expected);
+	for (size_t split = 0; split < sizeof(message); split++){
+		hash::Poly1305 mac(key.data());
+		mac.update(message, split);
+		mac.update(message + split, sizeof(message) - 1 - split);
+		assert2(utility::buffer_to_hex_string(mac.finish()) == expected);
+	}
+}
+
+//Checks the one-shot functions against a known answer, then checks that
+//tampering is detected, and that streaming gives the same results.
+template <typename Aead>
+void test_aead_vector(const Aead &aead, const char *nonce_string, const char *aad_string, const char *plaintext_string, const char *ciphertext_string, const char *tag_string){
+	auto nonce = array_from_hex<std::tuple_size<typename Aead::nonce_t>::value>(nonce_string);
+	auto aad = from_hex(aad_string);
+	auto plaintext = from_hex(plaintext_string);
+	auto expected = from_hex(ciphertext_string);
+	auto expected_tag = array_from_hex<Aead::tag_size>(tag_string);
+	auto size = plaintext.size();
+
+	std::vector<std::uint8_t> ciphertext(size);
+	auto tag = aead.encrypt(ciphertext.data(), plaintext.data(), size, nonce, aad.data(), aad.size());
+	assert2(ciphertext == expected);
+	assert2(tag == expected_tag);
+
+	std::vector<std::uint8_t> decrypted(size);
+	assert2(aead.decrypt(decrypted.data(), ciphertext.data(), size, nonce, tag, aad.data(), aad.size()));
+	assert2(decrypted == plaintext);
+
+	//In place.
+	decrypted = ciphertext;
+	assert2(aead.decrypt(decrypted.data(), decrypted.data(), size, nonce, tag, aad.data(), aad.size()));
+	assert2(decrypted == plaintext);
+
+	auto bad_tag = tag;
+	bad_tag[5] ^= 0x10;
+	assert2(!aead.decrypt(decrypted.data(), ciphertext.data(), size, nonce, bad_tag, aad.data(), aad.size()));
+	assert2(decrypted == std::vector<std::uint8_t>(size));
+	if (size){
+		auto bad_ciphertext = ciphertext;
+		bad_ciphertext[size / 2] ^= 1;
+		assert2(!aead.decrypt(decrypted.data(), bad_ciphertext.data(), size, nonce, tag, aad.data(), aad.size()));
+	}
+	if (aad.size()){
+		auto bad_aad = aad;
+		bad_aad[0] ^= 1;
+		assert2(!aead.decrypt(decrypted.data(), ciphertext.data(), size, nonce, tag, bad_aad.data(), bad_aad.size()));
+	}
+
+	//Associated data and message in uneven pieces.
+	for (size_t step = 1; step <= 17; step += 4){
+		typename Aead::Context context(aead, nonce, true);
+		for (size_t i = 0; i < aad.size(); i += step)
+			context.add_aad(aad.data() + i, std::min(step, aad.size() - i));
+		std::vector<std::uint8_t> actual(size);
+		for (size_t i = 0; i < size; i += step)
+			context.process(actual.data() + i, plaintext.data() + i, std::min(step, size - i));
+		assert2(actual == expected);
+		assert2(context.finish() == expected_tag);
+	}
+
+	symmetric::stream::AeadStream<Aead> stream(aead, nonce, false, aad.data(), aad.size());
+	assert2(stream.write(ciphertext.data(), size) == size);
+	assert2(stream.read(decrypted.data(), size) == size);
+	assert2(decrypted == plaintext);
+	assert2(stream.verify(tag));
+
+	bool thrown = false;
+	try{
+		typename Aead::Context context(aead, nonce, true);
+		context.process(ciphertext.data(), plaintext.data(), size);
+		context.add_aad(aad.data(), aad.size());
+	}catch (std::runtime_error &){
+		thrown = true;
+	}
+	assert2(thrown);
+
+	//A finished context can't be used again.
+	typename Aead::Context finished(aead, nonce, false);
+	finished.add_aad(aad.data(), aad.size());
+	finished.process(decrypted.data(), ciphertext.data(), size);
+	assert2(finished.verify(tag));
+	std::function<void()> after_finish[] = {
+		[&](){ finished.finish(); },
+		[&](){ finished.verify(tag); },
+		[&](){ finished.process(decrypted.data(), ciphertext.data(), size); },
+		[&](){ finished.add_aad(aad.data(), aad.size()); },
+	};
+	for (auto &f : after_finish){
+		thrown = false;
+		try{
+			f();
+		}catch (std::runtime_error &){
+			thrown = true;
+		}
+		assert2(thrown);
+	}
+}
+
+//Long messages, to exercise the chunking and the vectorized kernels. The
+//expected tags were computed with the scalar code.
+template <typename Aead>
+void test_aead_long(const Aead &aead, std::vector<typename Aead::tag_t> &tags){
+	typename Aead::nonce_t nonce = {};
+	nonce[0] = 1;
+	auto aad = make_data(1000);
+	size_t i = 0;
+	for (size_t size : { 63, 64, 65, 4095, 4096, 4097, 100000 }){
+		auto plaintext = make_data(size);
+		std::vector<std::uint8_t> ciphertext(size);
+		auto tag = aead.encrypt(ciphertext.data(), plaintext.data(), size, nonce, aad.data(), i * 100);
+		if (i < tags.size())
+			assert2(tag == tags[i]);
+		else
+			tags.push_back(tag);
+		std::vector<std::uint8_t> decrypted(size);
+		assert2(aead.decrypt(decrypted.data(), ciphertext.data(), size, nonce, tag, aad.data(), i * 100));
+		assert2(decrypted == plaintext);
+		i++;
+	}
+}
+
+void test_chacha20_poly1305(){
+	//RFC 8439, section 2.8.2.
+	symmetric::ChaCha20Poly1305 aead("808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f");
+	test_aead_vector(
+		aead,
+		"070000004041424344454647",
+		"50515253c0c1c2c3c4c5c6c7",
+		//"Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it."
+		"4c616469657320616e642047656e746c656d656e206f662074686520636c6173"
+		"73206f66202739393a204966204920636f756c64206f6666657220796f75206f"
+		"6e6c79206f6e652074697020666f7220746865206675747572652c2073756e73"
+		"637265656e20776f756c642062652069742e",
+		"d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+		"3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+		"92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+		"3ff4def08e4b7a9de576d26586cec64b6116",
+		"1ae10b594f09e26a7e902ecbd0600691"
+	);
+}
+
+//Test cases 2, 4 and 16 from McGrew and Viega, "The Galois/Counter Mode of
+//Operation".
+void test_gcm(){
+	symmetric::Gcm<symmetric::Aes<128>> zero(symmetric::Aes<128>::key_t{});
+	test_aead_vector(zero, "000000000000000000000000", "", "00000000000000000000000000000000", "0388dace60b6a392f328c2b971b2fe78", "ab6e47d42cec13bdf53a67b21257bddf");
+
+	const char *plaintext =
+		"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+		"1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39";
+	const char *aad = "feedfacedeadbeeffeedfacedeadbeefabaddad2";
+	symmetric::Gcm<symmetric::Aes<128>> aes128("feffe9928665731c6d6a8f9467308308");
+	test_aead_vector(
+		aes128,
+		"cafebabefacedbaddecaf888",
+		aad,
+		plaintext,
+		"42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+		"21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091",
+		"5bc94fbc3221a5db94fae95ae7121a47"
+	);
+	symmetric::Gcm<symmetric::Aes<256>> aes256("feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308");
+	test_aead_vector(
+		aes256,
+		"cafebabefacedbaddecaf888",
+		aad,
+		plaintext,
+		"522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+		"8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662",
+		"76fc6ece0f4e1768cddf8853bb2d551b"
+	);
+}
+
+}
+
+void test_aead(){
+	test_poly1305();
+
+	symmetric::ChaCha20Poly1305 chacha("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f");
+	symmetric::Gcm<symmetric::Aes<256>> gcm("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f");
+	std::vector<symmetric::ChaCha20Poly1305::tag_t> chacha_tags;
+	std::vector<symmetric::Gcm<symmetric::Aes<256>>::tag_t> gcm_tags;
+
+	//The scalar code runs first and computes the expected long tags.
+	for_each_feature_set([&](){
+		test_chacha20_poly1305();
+		test_gcm();
+		test_aead_long(chacha, chacha_tags);
+		test_aead_long(gcm, gcm_tags);
+	});
+	std::cout << "AEAD implementations passed the test!\n";
+}
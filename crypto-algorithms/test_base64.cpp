@@ -2,6 +2,7 @@
 #include "base64.hpp"
 #include "rng.hpp"
 #include "aes.hpp"
+#include "test_utility.hpp"
 
 static void test_base64_sanity(){
 	const char * const seed = "4981a79c10b27bc32fcd024ccab3fa25cee961e9498ea559ea35d2207db238c6";
@@ -20,7 +21,142 @@ static void test_base64_sanity(){
 		throw std::runtime_error("base64 failed sanity check; incorrect decoded content");
 }
 
+//Feeds the streaming encoder and decoder in odd sized pieces, so that groups
+//straddle the ends of their ring buffers.
+template <typename Variant>
+static void test_base64_chunked(){
+	std::vector<std::uint8_t> input_data(100003);
+	for (size_t i = 0; i < input_data.size(); i++)
+		input_data[i] = (std::uint8_t)(i * 7 + i / 13);
+	auto expected = utility::BasicBase64Encoder<Variant>::encode(input_data);
+
+	utility::BasicBase64Encoder<Variant> encoder;
+	utility::BasicBase64Decoder<Variant> decoder;
+	std::string encoded;
+	std::vector<std::uint8_t> decoded;
+	char buffer[1009];
+	auto pump = [&](){
+		while (auto n = encoder.read(buffer, sizeof(buffer))){
+			encoded.append(buffer, n);
+			for (size_t written = 0; written < n;)
+				written += decoder.write(buffer + written, n - written);
+			while (auto m = decoder.read(buffer, sizeof(buffer)))
+				decoded.insert(decoded.end(), buffer, buffer + m);
+		}
+	};
+	for (size_t i = 0; i < input_data.size();){
+		i += encoder.write(input_data.data() + i, std::min<size_t>(1013, input_data.size() - i));
+		pump();
+	}
+	encoder.terminate();
+	pump();
+	decoder.terminate();
+	while (auto m = decoder.read(buffer, sizeof(buffer)))
+		decoded.insert(decoded.end(), buffer, buffer + m);
+
+	if (encoded != expected)
+		throw std::runtime_error("base64 failed chunked test; streaming encoder doesn't match one-shot encoder");
+	if (decoded != input_data)
+		throw std::runtime_error("base64 failed chunked test; incorrect decoded content");
+}
+
+//Straightforward bit-at-a-time encoder to check the fast paths against.
+template <typename Variant>
+static std::string reference_base64(const std::vector<std::uint8_t> &data){
+	std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+	alphabet += Variant::alphabet == utility::Base64Alphabet::standard ? "+/" : "-_";
+	std::string characters;
+	std::uint32_t accumulator = 0;
+	int bits = 0;
+	for (auto b : data){
+		accumulator = accumulator << 8 | b;
+		for (bits += 8; bits >= 6; bits -= 6)
+			characters += alphabet[(accumulator >> (bits - 6)) & 63];
+	}
+	if (bits)
+		characters += alphabet[(accumulator << (6 - bits)) & 63];
+	while (Variant::padding && characters.size() % 4)
+		characters += '=';
+	if (!Variant::line_length)
+		return characters;
+	std::string ret;
+	for (size_t i = 0; i < characters.size(); i += Variant::line_length){
+		if (i)
+			ret += "\r\n";
+		ret += characters.substr(i, Variant::line_length);
+	}
+	return ret;
+}
+
+template <typename Variant>
+static void test_base64_variant(){
+	//Every length around the widths of the vector kernels, and every
+	//character of the alphabet in every position.
+	std::vector<std::uint8_t> data;
+	for (size_t size = 0; size < 300; size++){
+		auto expected = reference_base64<Variant>(data);
+		if (utility::BasicBase64Encoder<Variant>::encode(data) != expected)
+			throw std::runtime_error("base64 failed bulk test; incorrect encoding");
+		if (utility::BasicBase64Decoder<Variant>::decode(expected) != data)
+			throw std::runtime_error("base64 failed bulk test; incorrect decoding");
+		data.push_back((std::uint8_t)(size * 97 + 13));
+	}
+
+	//Invalid input must be rejected no matter where in a vector it falls,
+	//including characters from the other alphabet.
+	auto encoded = utility::BasicBase64Encoder<Variant>::encode(data);
+	const char invalid[] = { '*', (char)0xC1, '.', Variant::alphabet == utility::Base64Alphabet::standard ? '_' : '/' };
+	for (size_t i = 0; i < 100; i++){
+		auto copy = encoded;
+		copy[i] = invalid[i % sizeof(invalid)];
+		bool thrown = false;
+		try{
+			utility::BasicBase64Decoder<Variant>::decode(copy);
+		}catch (std::runtime_error &){
+			thrown = true;
+		}
+		if (!thrown)
+			throw std::runtime_error("base64 failed bulk test; invalid character was accepted");
+	}
+}
+
+static void test_base64_vectors(){
+	const char * const vectors[][2] = {
+		{ "", "" },
+		{ "f", "Zg==" },
+		{ "fo", "Zm8=" },
+		{ "foo", "Zm9v" },
+		{ "foob", "Zm9vYg==" },
+		{ "fooba", "Zm9vYmE=" },
+		{ "foobar", "Zm9vYmFy" },
+	};
+	for (auto &v : vectors){
+		if (utility::Base64Encoder::encode(v[0], strlen(v[0])) != v[1])
+			throw std::runtime_error("base64 failed test vector; incorrect encoding");
+		auto decoded = utility::Base64Decoder::decode(v[1]);
+		if (std::string(decoded.begin(), decoded.end()) != v[0])
+			throw std::runtime_error("base64 failed test vector; incorrect decoding");
+	}
+
+	test_base64_variant<utility::Base64Standard>();
+	test_base64_variant<utility::Base64Unpadded>();
+	test_base64_variant<utility::Base64Url>();
+	test_base64_variant<utility::Base64UrlUnpadded>();
+	test_base64_variant<utility::Base64Mime>();
+
+	//MIME decoders must cope with bare LFs too.
+	auto decoded = utility::Base64MimeDecoder::decode("Zm9v\nYmFy\r\n");
+	if (std::string(decoded.begin(), decoded.end()) != "foobar")
+		throw std::runtime_error("base64 failed MIME test; incorrect decoding");
+}
+
 void test_base64(){
-	test_base64_sanity();
+	for_each_feature_set([](){
+		test_base64_vectors();
+		test_base64_sanity();
+		test_base64_chunked<utility::Base64Standard>();
+		test_base64_chunked<utility::Base64UrlUnpadded>();
+		test_base64_chunked<utility::Base64Mime>();
+	});
 	std::cout << "Base64 passed the test!\n";
 }
@@ -1,7 +1,11 @@
 #include "fixed.hpp"
 #include "arbitrary.hpp"
+#include "small_vector.hpp"
 #include <iostream>
+#include <vector>
 #include <exception>
+#include <random>
+#include <cstdint>
 
 
 namespace {
@@ -237,6 +241,212 @@ namespace arbitrary{
 
 using arithmetic::arbitrary::BigNum;
 
+template <typename Allocator>
+void test_small_vector(){
+	typedef utility::SmallVector<int, 4, Allocator> V;
+	V v;
+	for (int i = 0; i < 100; i++){
+		v.push_back(i);
+		if (v.size() != (size_t)i + 1 || v.back() != i || v.front() != 0)
+			throw std::runtime_error("SmallVector failed push_back test");
+	}
+	v.erase(v.begin() + 10, v.begin() + 20);
+	v.insert(v.begin() + 5, 3, -1);
+	std::vector<int> expected;
+	for (int i = 0; i < 100; i++)
+		if (i < 10 || i >= 20)
+			expected.push_back(i);
+	expected.insert(expected.begin() + 5, 3, -1);
+	if (!std::equal(v.begin(), v.end(), expected.begin(), expected.end()))
+		throw std::runtime_error("SmallVector failed insert/erase test");
+
+	//Copies and moves, both inline and spilled.
+	for (size_t n : { 3, 50 }){
+		V a(n, 7);
+		V b = a;
+		V c = std::move(a);
+		a = b;
+		b = std::move(c);
+		c = V(1, 1);
+		if (a.size() != n || b.size() != n || c.size() != 1 || a[n - 1] != 7 || b[0] != 7 || c[0] != 1)
+			throw std::runtime_error("SmallVector failed copy/move test");
+	}
+}
+
+//Numbers much bigger than the inline storage.
+void test_large_numbers(){
+	auto a = (BigNum(1) << 700) + 12345;
+	auto b = (BigNum(1) << 300) - 1;
+	auto square = (a + b) * (a + b);
+	if (square != a * a + a * b * 2 + b * b)
+		throw std::runtime_error("Bignum (arbitrary) failed large multiplication test");
+	if (square / (a + b) != a + b || !!(square % (a + b)))
+		throw std::runtime_error("Bignum (arbitrary) failed large division test");
+	if ((square >> 1000) << 1000 != square - square % (BigNum(1) << 1000))
+		throw std::runtime_error("Bignum (arbitrary) failed large shift test");
+}
+
+BigNum random_bignum(std::mt19937 &rng, size_t bytes){
+	std::vector<std::uint8_t> buffer(bytes);
+	for (auto &i : buffer)
+		i = (std::uint8_t)rng();
+	return buffer;
+}
+
+void test_multiply_accumulate(){
+	std::mt19937 rng(42);
+	for (int i = 0; i < 100; i++){
+		auto a = random_bignum(rng, 1 + rng() % 120);
+		auto b = random_bignum(rng, 1 + rng() % 120);
+		auto c = random_bignum(rng, 1 + rng() % 120);
+		auto product = a * b;
+		//Division doesn't go through the multiplication code.
+		if (!!a && (product / a != b || !!(product % a)))
+			throw std::runtime_error("Bignum (arbitrary) failed multiplication test");
+		auto d = c;
+		d.mul_add(a, b);
+		if (d != c + product)
+			throw std::runtime_error("Bignum (arbitrary) failed mul_add test");
+		d.sub_mul(a, b);
+		if (d != c)
+			throw std::runtime_error("Bignum (arbitrary) failed sub_mul test");
+		d = a;
+		d.mul_add(d, d);
+		if (d != a + a * a)
+			throw std::runtime_error("Bignum (arbitrary) failed aliased mul_add test");
+	}
+
+	//Temporaries are reused, and moved-from numbers can be assigned to.
+	BigNum a = 1000;
+	auto b = a + BigNum(1) + BigNum(2) + a;
+	auto c = std::move(b);
+	b = (c << 3) >> 1;
+	if (b != 8012 || c != 2003 || (BigNum(5) - 3) * 2 != 4)
+		throw std::runtime_error("Bignum (arbitrary) failed move test");
+}
+
+void test_signed_arithmetic(){
+	using arithmetic::arbitrary::SignedBigNum;
+	for (int x = -6; x <= 6; x++){
+		for (int y = -6; y <= 6; y++){
+			if (SignedBigNum(x) + SignedBigNum(y) != SignedBigNum(x + y) || SignedBigNum(x) - SignedBigNum(y) != SignedBigNum(x - y))
+				throw std::runtime_error("SignedBigNum failed addition test");
+			for (int z = -6; z <= 6; z++){
+				SignedBigNum a = z;
+				a.mul_add(x, y);
+				SignedBigNum b = z;
+				b.sub_mul(x, y);
+				if (a != SignedBigNum(z + x * y) || b != SignedBigNum(z - x * y))
+					throw std::runtime_error("SignedBigNum failed mul_add/sub_mul test");
+			}
+		}
+	}
+}
+
+void test_mod_context(){
+	using arithmetic::arbitrary::SignedBigNum;
+	using arithmetic::arbitrary::ModContext;
+	std::mt19937 rng(7);
+	const BigNum moduli[] = {
+		BigNum::from_hex_string("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFC2F"),
+		BigNum::from_hex_string("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEBAAEDCE6AF48A03BBFD25E8CD0364141"),
+		(BigNum(1) << 127) - 1,
+		97,
+	};
+	for (auto &modulus : moduli){
+		ModContext m(modulus);
+		for (int i = 0; i < 50; i++){
+			auto a = random_bignum(rng, 32) % modulus;
+			auto b = random_bignum(rng, 32) % modulus;
+			BigNum x;
+			m.mul_mod(x, a, b);
+			if (x != a * b % modulus)
+				throw std::runtime_error("ModContext failed mul_mod test");
+			x = a;
+			m.sqr_mod(x, x);
+			if (x != a * a % modulus)
+				throw std::runtime_error("ModContext failed sqr_mod test");
+			m.add_mod(x, a, b);
+			if (x != (a + b) % modulus)
+				throw std::runtime_error("ModContext failed add_mod test");
+			x = b;
+			m.sub_mod(x, a, x);
+			if (x != (a + modulus - b) % modulus)
+				throw std::runtime_error("ModContext failed sub_mod test");
+			m.neg_mod(x, a);
+			m.add_mod(x, x, a);
+			if (!!x)
+				throw std::runtime_error("ModContext failed neg_mod test");
+			if (!!a){
+				m.inv_mod(x, a);
+				m.mul_mod(x, x, a);
+				if (x != 1)
+					throw std::runtime_error("ModContext failed inv_mod test");
+			}
+			SignedBigNum negative = a;
+			negative.invert_sign();
+			if (m.residue(negative) != (modulus - a) % modulus)
+				throw std::runtime_error("ModContext failed residue test");
+			//Wider than the square of the modulus.
+			x = a * b * b;
+			m.reduce(x);
+			if (x != a * b * b % modulus)
+				throw std::runtime_error("ModContext failed reduce test");
+		}
+	}
+}
+
+template <typename F>
+bool throws(F &&f){
+	try{
+		f();
+	}catch (std::runtime_error &){
+		return true;
+	}
+	return false;
+}
+
+void test_mod_inverse(){
+	using arithmetic::arbitrary::SignedBigNum;
+	std::mt19937 rng(11);
+	const BigNum moduli[] = {
+		BigNum::from_hex_string("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFC2F"),
+		BigNum::from_hex_string("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEBAAEDCE6AF48A03BBFD25E8CD0364141"),
+		(BigNum(1) << 256) - 189,
+		(BigNum(1) << 127) - 1,
+		97,
+	};
+	for (auto &modulus : moduli){
+		for (int i = 0; i < 50; i++){
+			auto a = random_bignum(rng, 32) % modulus;
+			if (i == 0)
+				a = 1;
+			else if (i == 1)
+				a = modulus - 1;
+			if (!a)
+				continue;
+			if (a * a.mod_inverse(modulus) % modulus != 1)
+				throw std::runtime_error("Bignum (arbitrary) failed mod_inverse test");
+			if (a * a.mod_inverse_ct(modulus) % modulus != 1)
+				throw std::runtime_error("Bignum (arbitrary) failed mod_inverse_ct test");
+			if ((a + modulus).mod_inverse_ct(modulus) != a.mod_inverse(modulus))
+				throw std::runtime_error("Bignum (arbitrary) failed unreduced mod_inverse_ct test");
+			SignedBigNum signed_a = a, signed_modulus = modulus;
+			if (signed_a.mod_inverse_ct(signed_modulus) != a.mod_inverse_ct(modulus) || (-signed_a).mod_inverse_ct(signed_modulus) != (modulus - a).mod_inverse_ct(modulus))
+				throw std::runtime_error("SignedBigNum failed mod_inverse_ct test");
+		}
+		if (!!BigNum(0).mod_inverse_ct(modulus) || !!modulus.mod_inverse_ct(modulus) || !!(modulus * 2).mod_inverse_ct(modulus))
+			throw std::runtime_error("Bignum (arbitrary) failed mod_inverse_ct of zero test");
+	}
+	if (!throws([](){ BigNum(5).mod_inverse(15); }) || !throws([](){ BigNum(0).mod_inverse(7); }))
+		throw std::runtime_error("Bignum (arbitrary) inverted a value without an inverse");
+	if (!throws([](){ BigNum(3).mod_inverse_ct(16); }) || !throws([](){ BigNum(3).mod_inverse_ct((BigNum(1) << 257) - 1); }))
+		throw std::runtime_error("Bignum (arbitrary) failed mod_inverse_ct modulus test");
+	SignedBigNum minus_two = -2;
+	if (minus_two.mod_inverse(SignedBigNum(7)) != 3 || minus_two.mod_inverse_ct(SignedBigNum(7)) != 3)
+		throw std::runtime_error("SignedBigNum failed mod_inverse test");
+}
+
 void test_addition(const BigNum &a, const BigNum &b, const BigNum &c){
 	if (a + b != c)
 		throw std::exception();
@@ -469,6 +679,13 @@ void test_arbitrary_bignum(){
 	arbitrary::test_multiplication2();
 	arbitrary::test_division();
 	arbitrary::test_modulo();
+	arbitrary::test_small_vector<std::allocator<int>>();
+	arbitrary::test_small_vector<utility::PoolAllocator<int>>();
+	arbitrary::test_large_numbers();
+	arbitrary::test_multiply_accumulate();
+	arbitrary::test_signed_arithmetic();
+	arbitrary::test_mod_context();
+	arbitrary::test_mod_inverse();
 
 	std::cout << "Bignum (arbitrary) implementation passed the test!\n";
 }
@@ -0,0 +1,163 @@
+#include "test_chacha20.hpp"
+#include "chacha20.hpp"
+#include "test_utility.hpp"
+#include "hex.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace{
+
+void chacha20_assert(bool condition, const char *string){
+	if (condition)
+		return;
+	throw std::runtime_error((std::string)"Failed test: " + string);
+}
+
+#define assert2(x) chacha20_assert(x, #x)
+
+typedef symmetric::ChaCha20 ChaCha20;
+
+const char * const key = "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f";
+
+ChaCha20::nonce_t nonce_from_string(const char *s){
+	return utility::hex_string_to_buffer<12>(s);
+}
+
+std::vector<std::uint8_t> make_data(size_t size){
+	std::vector<std::uint8_t> ret(size);
+	for (size_t i = 0; i < size; i++)
+		ret[i] = (std::uint8_t)(i * 167 + 13);
+	return ret;
+}
+
+//RFC 8439, sections 2.3.2, 2.4.2 and A.1.
+void test_chacha20_vectors(){
+	ChaCha20 block(key, nonce_from_string("000000090000004a00000000"), 1);
+	assert2(utility::buffer_to_hex_string(block()) ==
+		"10f1e7e4d13b5915500fdd1fa32071c4c7d1f4c733c068030422aa9ac3d46c4e"
+		"d2826446079faa0914c2d705d98b02a2b5129cd1de164eb9cbd083e8a2503c4e");
+	assert2(block.get_counter() == 2);
+
+	ChaCha20 zero(ChaCha20::key_t(), {});
+	assert2(utility::buffer_to_hex_string(zero()) ==
+		"76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7"
+		"da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586");
+
+	const char plaintext[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+	const char expected[] =
+		"6e2e359a2568f98041ba0728dd0d6981e97e7aec1d4360c20a27afccfd9fae0b"
+		"f91b65c5524733ab8f593dabcd62b3571639d624e65152ab8f530c359f0861d8"
+		"07ca0dbf500d6a6156a38e088a22b65e52bc514d16ccf806818ce91ab7793736"
+		"5af90bbf74a35be6b40b8eedf2785e42874d";
+	symmetric::stream::ChaCha20Stream<> stream(key, nonce_from_string("000000000000004a00000000"), 1);
+	stream.write(plaintext, sizeof(plaintext) - 1);
+	stream.terminate();
+	std::vector<std::uint8_t> ciphertext(sizeof(plaintext));
+	ciphertext.resize(stream.read(ciphertext.data(), ciphertext.size()));
+	assert2(utility::buffer_to_hex_string(ciphertext) == expected);
+}
+
+//The vectorized kernels must agree with the scalar code for every length and
+//alignment, and regardless of how the stream is split up.
+void test_chacha20_kernels(const std::vector<std::uint8_t> &expected){
+	auto nonce = nonce_from_string("000000000000004a00000000");
+	auto data = make_data(expected.size());
+	for (size_t blocks = 0; blocks <= 20; blocks++){
+		ChaCha20 c(key, nonce, 1);
+		std::vector<std::uint8_t> actual(blocks * 64 + 1);
+		c.process(actual.data() + 1, data.data(), blocks);
+		assert2(std::equal(actual.begin() + 1, actual.end(), expected.begin()));
+		assert2(c.get_counter() == 1 + blocks);
+	}
+
+	symmetric::stream::ChaCha20Stream<> stream(key, nonce, 1);
+	std::vector<std::uint8_t> actual;
+	for (size_t i = 0, n = 1; i < data.size(); n = n * 5 % 997 + 1){
+		auto write_size = std::min(n, data.size() - i);
+		stream.write(data.data() + i, write_size);
+		i += write_size;
+		std::uint8_t buffer[1024];
+		while (auto read = stream.read(buffer, sizeof(buffer)))
+			actual.insert(actual.end(), buffer, buffer + read);
+	}
+	stream.terminate();
+	std::uint8_t buffer[64];
+	while (auto read = stream.read(buffer, sizeof(buffer)))
+		actual.insert(actual.end(), buffer, buffer + read);
+	assert2(actual == expected);
+
+	//Decryption is the same operation.
+	ChaCha20 c(key, nonce, 1);
+	auto copy = expected;
+	c.process(copy.data(), copy.data(), copy.size() / 64);
+	assert2(std::equal(copy.begin(), copy.end() - copy.size() % 64, data.begin()));
+}
+
+void test_chacha20_limits(){
+	ChaCha20 c(key, {}, 0xFFFFFFFE);
+	std::uint8_t buffer[64 * 3];
+	bool thrown = false;
+	try{
+		c.keystream(buffer, 3);
+	}catch (std::runtime_error &){
+		thrown = true;
+	}
+	assert2(thrown);
+	c.keystream(buffer, 2);
+	thrown = false;
+	try{
+		c.keystream(buffer, 1);
+	}catch (std::runtime_error &){
+		thrown = true;
+	}
+	assert2(thrown);
+}
+
+void test_chacha20_rng(){
+	csprng::ChaCha20Rng::nonce_t rng_nonce = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	ChaCha20::nonce_t nonce = { 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+	const size_t size = 100000;
+	std::vector<std::uint8_t> expected(size / 64 * 64 + 64);
+	ChaCha20(key, nonce).keystream(expected.data(), expected.size() / 64);
+	expected.resize(size);
+
+	csprng::ChaCha20Rng bulk(key, rng_nonce);
+	assert2(bulk.get_bytes(size) == expected);
+
+	csprng::ChaCha20Rng split(key, rng_nonce);
+	std::vector<std::uint8_t> actual(size);
+	for (size_t i = 0, n = 1; i < size; n = n * 7 % 1031 + 1){
+		auto write_size = std::min(n, size - i);
+		split.get_bytes(actual.data() + i, write_size);
+		i += write_size;
+	}
+	assert2(actual == expected);
+
+	csprng::ChaCha20Rng a, b;
+	assert2(a.get_bytes(64) != b.get_bytes(64));
+}
+
+}
+
+void test_chacha20(){
+	//The first pass runs the scalar code, which computes the output the
+	//vectorized kernels are checked against.
+	std::vector<std::uint8_t> expected;
+	for_each_feature_set([&expected](){
+		if (expected.empty()){
+			expected.resize(20 * 64 + 37);
+			auto data = make_data(expected.size());
+			symmetric::stream::ChaCha20Stream<> stream(key, nonce_from_string("000000000000004a00000000"), 1);
+			stream.write(data.data(), data.size());
+			stream.terminate();
+			stream.read(expected.data(), expected.size());
+		}
+		test_chacha20_vectors();
+		test_chacha20_kernels(expected);
+		test_chacha20_limits();
+		test_chacha20_rng();
+	});
+	std::cout << "ChaCha20 passed the test!\n";
+}
@@ -3,6 +3,7 @@
 #include "rng.hpp"
 #include "aes.hpp"
 #include "testutils.hpp"
+#include "source_sink.hpp"
 #include <iostream>
 
 struct test_case{
@@ -157,6 +158,16 @@ static void test_progressive(){
 		if (verifier.finish())
 			throw std::runtime_error("Ed25519 (progressive) failed signature verification (2)");
 	}
+	{
+		auto rng = testutils::init_rng();
+		auto data = rng.get_bytes(data_size);
+		ProgressiveVerifier verifier(signature, public_key);
+		utility::HashingSink<ProgressiveVerifier> sink(verifier);
+		for (size_t i = 0; i < data_size; i += buffer_size)
+			sink.write(data.data() + i, buffer_size);
+		if (!verifier.finish())
+			throw std::runtime_error("Ed25519 (progressive) failed signature verification (3)");
+	}
 }
 
 void test_ed25519(){
@@ -0,0 +1,88 @@
+#include "test_hex.hpp"
+#include "hex.hpp"
+#include "test_utility.hpp"
+#include "fixed.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace{
+
+void hex_assert(bool condition, const char *string){
+	if (condition)
+		return;
+	throw std::runtime_error((std::string)"Failed test: " + string);
+}
+
+#define assert2(x) hex_assert(x, #x)
+
+//Every length around the widths of the vector kernels.
+void test_hex_round_trip(){
+	std::vector<std::uint8_t> data;
+	for (size_t size = 0; size < 200; size++){
+		std::string expected;
+		for (auto b : data){
+			expected += "0123456789abcdef"[b >> 4];
+			expected += "0123456789abcdef"[b & 15];
+		}
+		assert2(utility::buffer_to_hex_string(data) == expected);
+
+		std::vector<std::uint8_t> decoded(size);
+		assert2(utility::hex_decode(decoded.data(), expected.data(), size));
+		assert2(decoded == data);
+
+		//Upper case decodes the same.
+		for (auto &c : expected)
+			c = (char)toupper(c);
+		std::fill(decoded.begin(), decoded.end(), 0);
+		assert2(utility::hex_decode(decoded.data(), expected.data(), size));
+		assert2(decoded == data);
+
+		data.push_back((std::uint8_t)(size * 151 + 7));
+	}
+}
+
+void test_hex_errors(){
+	std::vector<std::uint8_t> data(100);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = (std::uint8_t)(i * 29);
+	auto hex = utility::buffer_to_hex_string(data);
+	const char invalid[] = { 'g', 'G', '/', ':', '@', '`', ' ', (char)0xC6 };
+	for (size_t i = 0; i < hex.size(); i++){
+		auto copy = hex;
+		copy[i] = invalid[i % sizeof(invalid)];
+		size_t position = 0;
+		assert2(!utility::hex_decode(data.data(), copy.data(), data.size(), &position));
+		assert2(position == i);
+	}
+
+	bool thrown = false;
+	try{
+		utility::hex_string_to_buffer<2>("12x4");
+	}catch (utility::InvalidHexException &){
+		thrown = true;
+	}
+	assert2(thrown);
+}
+
+void test_hex_numbers(){
+	assert2(utility::hex_number_to_bytes("", 0).empty());
+	assert2(utility::hex_number_to_bytes("123", 3) == std::vector<std::uint8_t>({ 0x23, 0x01 }));
+	const char *s = "DEADBEEF 0badf00d";
+	assert2(utility::hex_number_to_bytes(s, strlen(s)) == std::vector<std::uint8_t>({ 0x0D, 0xF0, 0xAD, 0x0B, 0xEF, 0xBE, 0xAD, 0xDE }));
+	//Digits that don't fit in a fixed size number are dropped from the top.
+	typedef arithmetic::fixed::BigNum<32, std::uint32_t> N;
+	assert2(N::from_hex_string(s) == N(0x0BADF00D));
+}
+
+}
+
+void test_hex(){
+	for_each_feature_set([](){
+		test_hex_round_trip();
+		test_hex_errors();
+		test_hex_numbers();
+	});
+	std::cout << "Hex passed the test!\n";
+}
@@ -0,0 +1,86 @@
+#include "test_hmac.hpp"
+#include "hmac.hpp"
+#include "md5.hpp"
+#include "sha1.hpp"
+#include "sha256.hpp"
+#include "sha512.hpp"
+#include "hex.hpp"
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace{
+
+template <typename Algorithm>
+void test_hmac(const std::string &key, const std::string &data, const char *expected, const char *name){
+	std::string actual = hash::HMAC<Algorithm>::compute(key, data);
+	if (actual != expected){
+		std::stringstream stream;
+		stream << "Failed test: HMAC-" << name << "(" << data << ") != " << expected << "\nActual: " << actual;
+		throw std::runtime_error(stream.str());
+	}
+
+	//The incremental interface must agree with the one-shot one, and must be
+	//reusable after get_digest().
+	hash::HMAC<Algorithm> mac(key);
+	for (int i = 0; i < 2; i++){
+		auto half = data.size() / 2;
+		mac.update(data.data(), half);
+		mac.update(data.data() + half, data.size() - half);
+		actual = mac.get_digest();
+		if (actual != expected)
+			throw std::runtime_error((std::string)"Failed test: incremental HMAC-" + name + " doesn't match one-shot HMAC");
+	}
+}
+
+void test_hkdf(){
+	std::string ikm(22, '\x0b');
+	std::string salt;
+	for (char i = 0; i < 13; i++)
+		salt.push_back(i);
+	std::string info;
+	for (int i = 0xF0; i < 0xFA; i++)
+		info.push_back((char)i);
+
+	auto okm = utility::buffer_to_hex_string(hash::HKDF<hash::algorithm::SHA256>::derive(salt, ikm, info, 42));
+	const char * const expected = "3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf34007208d5b887185865";
+	if (okm != expected)
+		throw std::runtime_error("Failed test: HKDF-SHA256 RFC 5869 test case 1\nActual: " + okm);
+}
+
+template <typename Algorithm>
+void test_pbkdf2(const std::string &password, const std::string &salt, std::uint32_t iterations, size_t size, const char *expected, const char *name){
+	hash::PBKDF2<Algorithm> kdf(password);
+	for (unsigned threads : { 1, 4 }){
+		auto actual = utility::buffer_to_hex_string(kdf.derive(size, salt, iterations, threads));
+		if (actual != expected){
+			std::stringstream stream;
+			stream << "Failed test: PBKDF2-HMAC-" << name << "(" << password << ", " << salt << ", " << iterations << ") with " << threads << " threads != " << expected << "\nActual: " << actual;
+			throw std::runtime_error(stream.str());
+		}
+	}
+}
+
+}
+
+void test_hmac(){
+	using namespace hash::algorithm;
+	const std::string long_key(131, '\xAA');
+	const std::string long_key_data = "Test Using Larger Than Block-Size Key - Hash Key First";
+	test_hmac<MD5>("Jefe", "what do ya want for nothing?", "750c783e6ab0b503eaa86e310a5db738", "MD5");
+	test_hmac<SHA1>("Jefe", "what do ya want for nothing?", "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79", "SHA1");
+	test_hmac<SHA256>(std::string(20, '\x0B'), "Hi There", "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7", "SHA256");
+	test_hmac<SHA256>(long_key, long_key_data, "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54", "SHA256");
+	test_hmac<SHA512>("Jefe", "what do ya want for nothing?", "164b7a7bfcf819e2e395fbe73b56e0a387bd64222e831fd610270cd7ea2505549758bf75c05a994a6d034f65f8f0e6fdcaeab1a34d4a6b4b636e070a38bce737", "SHA512");
+	test_hmac<SHA512>(long_key, long_key_data, "80b24263c7c1a3ebb71493c1dd7be8b49b46d1f41b4aeec1121b013783f8f3526b56d037e05f2598bd0fd2215d6a1e5295e64f73f63f0aec8b915a985d786598", "SHA512");
+
+	test_hkdf();
+
+	test_pbkdf2<SHA1>("password", "salt", 2, 20, "ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957", "SHA1");
+	test_pbkdf2<SHA256>("password", "salt", 1, 32, "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b", "SHA256");
+	test_pbkdf2<SHA256>("password", "salt", 4096, 32, "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a", "SHA256");
+	test_pbkdf2<SHA256>("passwordPASSWORDpassword", "saltSALTsaltSALTsaltSALTsaltSALTsalt", 4096, 40, "348c89dbcbd32b2f32d814b8116e84cf2b17347ebc1800181c4e2a1fb8dd53e1c635518c7dac47e9", "SHA256");
+	test_pbkdf2<SHA512>("password", "salt", 1000, 150, "afe6c5530785b6cc6b1c6453384731bd5ee432ee549fd42fb6695779ad8a1c5bf59de69c48f774efc4007d5298f9033c0241d5ab69305e7b64eceeb8d834cfec6afdec3c1c23982a121f2d4be008889378a49a0dfb104f0d2856e38f44271cdaf6de434196647bc5673cd6c148611ced6e9003b65879feccc89226ecc5e22090795445cc7314fcf414878a42ffd39cd3b90dcd41e065", "SHA512");
+
+	std::cout << "HMAC, HKDF and PBKDF2 implementations passed the test!\n";
+}
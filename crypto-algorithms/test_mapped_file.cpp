@@ -0,0 +1,66 @@
+#include "test_mapped_file.hpp"
+#include "mapped_file.hpp"
+#include "sha256.hpp"
+#include "testutils.hpp"
+#include <iostream>
+#include <filesystem>
+#include <stdexcept>
+
+namespace{
+
+void test_round_trip(const std::filesystem::path &path){
+	auto rng = testutils::init_rng();
+	//Large enough to force the sink to grow its mapping a few times.
+	auto data = rng.get_bytes((3 << 20) + 12345);
+
+	{
+		utility::MappedFileSink sink(path);
+		const size_t chunk = 100000;
+		size_t i = 0;
+		for (; i + chunk < data.size() / 2; i += chunk)
+			sink.write(data.data() + i, chunk);
+		auto rest = data.size() - i;
+		auto dst = sink.prepare(rest);
+		memcpy(dst, data.data() + i, rest);
+		sink.commit(rest);
+	}
+
+	if (std::filesystem::file_size(path) != data.size())
+		throw std::runtime_error("MappedFileSink wrote a file of the wrong size");
+
+	utility::MappedFileSource source(path);
+	if (source.available().value() != data.size() || memcmp(source.data(), data.data(), data.size()))
+		throw std::runtime_error("MappedFileSource doesn't match the data written by MappedFileSink");
+
+	//Hash straight off the mapping.
+	hash::algorithm::SHA256 hash;
+	utility::HashingSink<hash::algorithm::SHA256> hashing_sink(hash);
+	source >> hashing_sink;
+	if (source.size() || hash.get_digest() != hash::algorithm::SHA256::compute(data.data(), data.size()))
+		throw std::runtime_error("hashing over a MappedFileSource produced the wrong digest");
+}
+
+void test_empty(const std::filesystem::path &path){
+	{
+		utility::MappedFileSink sink(path);
+	}
+	utility::MappedFileSource source(path);
+	std::uint8_t buffer[16];
+	if (source.size() || source.read(buffer, sizeof(buffer)))
+		throw std::runtime_error("MappedFileSource read data from an empty file");
+}
+
+}
+
+void test_mapped_file(){
+	auto path = std::filesystem::temp_directory_path() / "crypto_algorithms_test_mapped_file.bin";
+	try{
+		test_round_trip(path);
+		test_empty(path);
+	}catch (std::exception &){
+		std::filesystem::remove(path);
+		throw;
+	}
+	std::filesystem::remove(path);
+	std::cout << "Memory-mapped files passed the test!\n";
+}
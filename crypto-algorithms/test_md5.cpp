@@ -1,4 +1,5 @@
 #include "md5.hpp"
+#include "test_utility.hpp"
 #include <array>
 #include <sstream>
 #include <cstring>
@@ -38,5 +39,6 @@ void test_md5(){
 	test_md5("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz34567", "fa94b73a6f072a0239b52acacfbcf9fa");
 	test_md5("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz345678901234", "bd201eae17f29568927414fa326f1267");
 	test_md5("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz34567890123", "80063db1e6b70a2e91eac903f0e46b85");
+	test_midstate<hash::algorithm::MD5>("MD5");
 	std::cout << "MD5 implementation passed the test!\n";
 }
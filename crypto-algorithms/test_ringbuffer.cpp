@@ -0,0 +1,161 @@
+#include "test_ringbuffer.hpp"
+#include "ringbuffer.hpp"
+#include "mirrored_ringbuffer.hpp"
+#include "spsc_ringbuffer.hpp"
+#include <thread>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace{
+
+void ringbuffer_assert(bool condition, const char *string){
+	if (condition)
+		return;
+	throw std::runtime_error((std::string)"Failed test: " + string);
+}
+
+#define assert2(x) ringbuffer_assert(x, #x)
+
+template <typename RingBuffer>
+void test_spans(RingBuffer &buffer){
+	const auto capacity = buffer.get_capacity();
+	std::vector<std::uint8_t> expected;
+	std::uint8_t next = 0;
+
+	//Move the data around the buffer in odd sized steps so that it wraps
+	//around many times.
+	for (int i = 0; i < 1000; i++){
+		auto writable = buffer.prepare_writable();
+		assert2(writable[0].size + writable[1].size == buffer.free());
+		size_t written = 0;
+		for (auto &span : writable){
+			for (size_t j = 0; j < span.size && written < 37; j++, written++){
+				span.data[j] = next;
+				expected.push_back(next++);
+			}
+		}
+		buffer.commit(written);
+
+		auto readable = buffer.peek_readable();
+		assert2(readable[0].size + readable[1].size == buffer.get_length());
+		assert2(buffer.get_length() == expected.size());
+		size_t k = 0;
+		for (auto &span : readable)
+			for (size_t j = 0; j < span.size; j++)
+				assert2(span.data[j] == expected[k++]);
+
+		auto consumed = std::min<size_t>(buffer.get_length(), i % 3 ? 29 : 41);
+		buffer.consume(consumed);
+		expected.erase(expected.begin(), expected.begin() + consumed);
+	}
+
+	//The copying interface must agree with the span interface.
+	std::vector<std::uint8_t> temp(buffer.get_length());
+	assert2(buffer.read(temp.data(), temp.size()) == expected.size());
+	assert2(temp == expected);
+	assert2(buffer.free() == capacity);
+}
+
+void test_mirrored_ringbuffer(){
+	utility::MirroredRingBuffer buffer(1000);
+	auto capacity = buffer.get_capacity();
+	assert2(capacity >= 1000 && !(capacity & (capacity - 1)));
+
+	//Fill the buffer so that the data wraps around, and check that it's still
+	//seen as a single span, and that both mappings see the same memory.
+	std::vector<std::uint8_t> temp(capacity);
+	for (size_t i = 0; i < capacity; i++)
+		temp[i] = (std::uint8_t)(i * 31);
+	assert2(buffer.write(temp.data(), capacity / 2 + 3) == capacity / 2 + 3);
+	buffer.consume(capacity / 2 + 3);
+	assert2(buffer.write(temp.data(), capacity) == capacity);
+	auto readable = buffer.peek_readable();
+	assert2(readable[0].size == capacity && !readable[1].size);
+	assert2(!memcmp(readable[0].data, temp.data(), capacity));
+	buffer.consume(capacity);
+
+	test_spans(buffer);
+}
+
+std::uint8_t spsc_pattern(size_t i){
+	return (std::uint8_t)(i * 13 + i / 1021);
+}
+
+//Streams a few megabytes from one thread to another, mixing every kind of
+//write and read, and checks that every byte arrives in order.
+void test_spsc_ringbuffer(){
+	const size_t size = 3 << 20;
+	utility::SpscRingBuffer buffer(4000);
+	assert2(buffer.get_capacity() == 4096);
+
+	std::thread producer([&buffer](){
+		std::vector<std::uint8_t> temp(1500);
+		size_t i = 0;
+		for (int round = 0; i < size; round++){
+			auto n = std::min<size_t>(size - i, 1 + round % temp.size());
+			for (size_t j = 0; j < n; j++)
+				temp[j] = spsc_pattern(i + j);
+			switch (round % 3){
+				case 0:
+					buffer.write_all(temp.data(), n);
+					break;
+				case 1:
+					n = buffer.write(temp.data(), n);
+					if (!n)
+						buffer.wait_for_free(1);
+					break;
+				case 2:
+					{
+						buffer.wait_for_free(n);
+						size_t written = 0;
+						for (auto &span : buffer.prepare_writable())
+							for (size_t j = 0; j < span.size && written < n; j++)
+								span.data[j] = temp[written++];
+						buffer.commit(written);
+					}
+					break;
+			}
+			i += n;
+		}
+		buffer.close();
+	});
+
+	utility::SpscBufferSource source(buffer);
+	std::vector<std::uint8_t> temp(997);
+	size_t i = 0;
+	bool ok = true;
+	for (int round = 0; ; round++){
+		size_t n;
+		if (round % 2){
+			n = source.read(temp.data(), temp.size());
+			if (!n)
+				break;
+			for (size_t j = 0; j < n; j++)
+				ok &= temp[j] == spsc_pattern(i + j);
+		}else{
+			if (!buffer.wait_for_data(100) && buffer.finished())
+				break;
+			n = 0;
+			for (auto &span : buffer.peek_readable())
+				for (size_t j = 0; j < span.size; j++, n++)
+					ok &= span.data[j] == spsc_pattern(i + n);
+			buffer.consume(n);
+		}
+		i += n;
+	}
+	producer.join();
+	assert2(ok);
+	assert2(i == size);
+}
+
+}
+
+void test_ringbuffer(){
+	utility::RingBuffer buffer(256);
+	test_spans(buffer);
+	test_mirrored_ringbuffer();
+	test_spsc_ringbuffer();
+	std::cout << "RingBuffer passed the test!\n";
+}
@@ -1,10 +1,21 @@
 #include "rng.hpp"
+#include "thread_local_rng.hpp"
+#include "ed25519.hpp"
 #include "aes.hpp"
 #include "twofish.hpp"
 #include "hex.hpp"
 #include "sha256.hpp"
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <cstring>
+#include <thread>
+#include <set>
+#include <atomic>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 
 template <typename C>
 static void basic_test_rng(const char *seed, const char *iv, const char *expected_digest, const char *cipher){
@@ -23,10 +34,131 @@ static void basic_test_rng(const char *seed, const char *iv, const char *expecte
 	}
 }
 
+//The output must not depend on how it's requested, and must match the
+//truncated blocks returned by operator().
+template <typename C>
+static void bulk_test_rng(const char *seed, const char *iv, const char *cipher){
+	const size_t size = 100000;
+	const size_t output_size = C::block_size - 4;
+	csprng::BlockCipherRng<C> reference(seed, C::block_from_string(iv));
+	std::vector<std::uint8_t> expected(size);
+	for (size_t i = 0; i < size; i += output_size){
+		auto block = reference();
+		memcpy(expected.data() + i, block.data(), std::min(output_size, size - i));
+	}
+
+	csprng::BlockCipherRng<C> bulk(seed, C::block_from_string(iv));
+	if (bulk.get_bytes(size) != expected)
+		throw std::runtime_error(std::string("BlockCipherRng bulk output is wrong with ") + cipher);
+
+	csprng::BlockCipherRng<C> split(seed, C::block_from_string(iv));
+	std::vector<std::uint8_t> actual(size);
+	for (size_t i = 0, n = 1; i < size; n = n * 7 % 1031 + 1){
+		auto write_size = std::min(n, size - i);
+		split.get_bytes(actual.data() + i, write_size);
+		i += write_size;
+	}
+	if (actual != expected)
+		throw std::runtime_error(std::string("BlockCipherRng output depends on the request sizes with ") + cipher);
+}
+
+static void test_thread_local_rng(){
+	auto &rng = csprng::ThreadLocalRng::get();
+	typedef std::array<std::uint8_t, 32> sample_t;
+
+	//Every thread must get its own stream.
+	const size_t threads = 8;
+	std::vector<sample_t> samples(threads);
+	{
+		std::vector<std::thread> pool;
+		for (size_t i = 0; i < threads; i++)
+			pool.emplace_back([&rng, &samples, i](){ samples[i] = rng.get_bytes_fixed<32>(); });
+		for (auto &t : pool)
+			t.join();
+	}
+	samples.push_back(rng.get_bytes_fixed<32>());
+	if (std::set<sample_t>(samples.begin(), samples.end()).size() != samples.size())
+		throw std::runtime_error("ThreadLocalRng gave two threads the same stream");
+
+	//Requests that span several reseeds.
+	auto interval = csprng::ThreadLocalRng::reseed_interval();
+	csprng::ThreadLocalRng::set_reseed_interval(100);
+	auto a = rng.get_bytes(1000);
+	auto b = rng.get_bytes(1000);
+	csprng::ThreadLocalRng::set_reseed_interval(interval);
+	if (a == b || std::vector<std::uint8_t>(a.begin(), a.begin() + 100) == std::vector<std::uint8_t>(a.begin() + 100, a.begin() + 200))
+		throw std::runtime_error("ThreadLocalRng repeated itself across reseeds");
+
+	//Usable wherever a Prng is.
+	auto key = asymmetric::Ed25519::PrivateKey::generate(rng);
+	if (key == asymmetric::Ed25519::PrivateKey::generate(rng))
+		throw std::runtime_error("ThreadLocalRng generated the same key twice");
+
+#ifndef _WIN32
+	//Parent and child must diverge after a fork.
+	int fds[2];
+	if (pipe(fds))
+		throw std::runtime_error("pipe() failed");
+	auto pid = fork();
+	if (pid < 0)
+		throw std::runtime_error("fork() failed");
+	if (!pid){
+		auto child = rng.get_bytes_fixed<32>();
+		auto written = write(fds[1], child.data(), child.size());
+		_exit(written == (ssize_t)child.size() ? 0 : 1);
+	}
+	close(fds[1]);
+	auto parent = rng.get_bytes_fixed<32>();
+	sample_t child;
+	auto read_size = read(fds[0], child.data(), child.size());
+	close(fds[0]);
+	int status;
+	waitpid(pid, &status, 0);
+	if (read_size != (ssize_t)child.size())
+		throw std::runtime_error("ThreadLocalRng fork test failed to communicate with the child");
+	if (parent == child)
+		throw std::runtime_error("ThreadLocalRng produced the same bytes in parent and child after fork()");
+
+	//Forking while another thread is seeding itself from the master must not
+	//leave the child deadlocked.
+	std::atomic<bool> stop(false);
+	std::thread seeder([&rng, &stop](){
+		while (!stop){
+			csprng::ThreadLocalRng::reseed();
+			rng.get_bytes_fixed<32>();
+		}
+	});
+	bool deadlocked = false;
+	for (int i = 0; i < 20 && !deadlocked; i++){
+		auto pid = fork();
+		if (pid < 0){
+			stop = true;
+			seeder.join();
+			throw std::runtime_error("fork() failed");
+		}
+		if (!pid){
+			alarm(10);
+			rng.get_bytes_fixed<32>();
+			_exit(0);
+		}
+		int status;
+		waitpid(pid, &status, 0);
+		deadlocked = !WIFEXITED(status) || WEXITSTATUS(status);
+	}
+	stop = true;
+	seeder.join();
+	if (deadlocked)
+		throw std::runtime_error("ThreadLocalRng deadlocked in a child forked while another thread was seeding");
+#endif
+}
+
 void test_rng(){
 	const char * const seed = "4981a79c10b27bc32fcd024ccab3fa25cee961e9498ea559ea35d2207db238c6";
 	const char * const iv = "1d03d849cd296e6062c3211c14f657de";
 	basic_test_rng<symmetric::Aes<256>>(seed, iv, "92fffe422f2ad00369eadcd09943d47aea7b69b12edb4c81bde6b6ac7c62fad2", "AES-256");
 	basic_test_rng<symmetric::Twofish<256>>(seed, iv, "839fc32045e548b266009e5f5e6aa7b844ba2070797d32d22822de63a6b748d3", "Twofish-256");
-	std::cout << "BlockCipherRng passed the test!\n";
+	bulk_test_rng<symmetric::Aes<256>>(seed, iv, "AES-256");
+	bulk_test_rng<symmetric::Twofish<256>>(seed, iv, "Twofish-256");
+	test_thread_local_rng();
+	std::cout << "BlockCipherRng and ThreadLocalRng passed the test!\n";
 }
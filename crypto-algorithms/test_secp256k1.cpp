@@ -5,9 +5,32 @@
 #include "hex.hpp"
 #include <iostream>
 #include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
 
 using arithmetic::arbitrary::BigNum;
 
+//Counts every heap allocation in the program, so that the test below can
+//tell how many a signature and its verification take.
+static std::atomic<std::uint64_t> allocation_count;
+
+void *operator new(size_t size){
+	allocation_count++;
+	if (auto ret = malloc(size ? size : 1))
+		return ret;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept{
+	free(p);
+}
+
 template <typename DstT, typename SrcT>
 std::unique_ptr<DstT> static_pointer_cast(std::unique_ptr<SrcT> &&p){
 	return std::unique_ptr<DstT>(static_cast<DstT *>(p.release()));
@@ -77,9 +100,35 @@ static void test_secp256k1(const test_case &tc){
 		throw std::runtime_error("Secp256k1 failed signature verification test");
 	auto t3 = std::chrono::high_resolution_clock::now();
 	std::cout << "Verification time: " << delta_t(t3, t2) << " ms\n";
+	if (param_g.multiply_public(nonce.k) != param_g * nonce.k)
+		throw std::runtime_error("Secp256k1 failed public multiplication test");
 }
 
 
+static void test_allocations(const test_case &tc){
+	using namespace asymmetric::ECDSA::Secp256k1;
+
+	auto digest = utility::hex_string_to_buffer<32>(tc.digest_string);
+	PrivateKey private_key(BigNum::from_hex_string(tc.private_key_string));
+	Nonce nonce(BigNum::from_hex_string(tc.nonce_string));
+	auto public_key = private_key.get_public_key();
+
+	auto before = allocation_count.load();
+	auto signature = static_pointer_cast<Signature>(private_key.sign_digest(digest.data(), digest.size(), nonce));
+	signature->verify_digest(digest.data(), digest.size(), *public_key);
+	auto count = allocation_count.load() - before;
+	std::cout << "Heap allocations per sign/verify cycle: " << count << "\n";
+	//About 4.5k without the pool and 25 with it; far more means limbs are
+	//going to the heap again.
+#ifdef CRYPTO_ALGORITHMS_BIGNUM_POOL
+	const std::uint64_t limit = 100;
+#else
+	const std::uint64_t limit = 10000;
+#endif
+	if (count > limit)
+		throw std::runtime_error("Secp256k1 sign/verify cycle made too many heap allocations");
+}
+
 static void test_secp256k1(const test_case2 &tc){
 	std::string string = hash::algorithm::SHA256::compute(tc.original_message, strlen(tc.original_message));
 	if (string != tc.digest_string)
@@ -183,6 +232,7 @@ void test_secp256k1(){
 		test_secp256k1(t);
 	for (auto &t : test_cases2)
 		test_secp256k1(t);
+	test_allocations(test_cases2[0]);
 
 	std::cout << "Secp256k1 implementation passed the test!\n";
 }
@@ -1,4 +1,5 @@
 #include "sha1.hpp"
+#include "test_utility.hpp"
 #include <sstream>
 #include <stdexcept>
 #include <iostream>
@@ -18,5 +19,6 @@ void test_sha1(){
 	test_1("abc", "a9993e364706816aba3e25717850c26c9cd0d89d");
 	test_1("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
 	test_1("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", "a49b2446a02c645bf419f995b67091253a04a259");
+	test_midstate<hash::algorithm::SHA1>("SHA1");
 	std::cout << "SHA-1 implementation passed the test!\n";
 }
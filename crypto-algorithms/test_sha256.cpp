@@ -1,4 +1,5 @@
 #include "sha256.hpp"
+#include "test_utility.hpp"
 #include <sstream>
 #include <stdexcept>
 #include <iostream>
@@ -18,5 +19,6 @@ void test_sha256(){
 	test_256("abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
 	test_256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
 	test_256("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1");
+	test_midstate<hash::algorithm::SHA256>("SHA256");
 	std::cout << "SHA-256 implementation passed the test!\n";
 }
@@ -1,4 +1,5 @@
 #include "sha512.hpp"
+#include "test_utility.hpp"
 #include <array>
 #include <sstream>
 #include <cstring>
@@ -27,12 +28,14 @@ void test_sha512(const char *data, const char *sum){
 }
 
 std::string generate_data(){
+	//Don't rely on capacity(), since reserve() may round up the allocation.
+	const size_t size = 199935;
 	std::string ret;
-	ret.reserve(199933);
+	ret.reserve(size);
 	std::mt19937 rng(42);
-	while (ret.size() < ret.capacity()){
+	while (ret.size() < size){
 		auto n = rng();
-		for (int i = 0; i < 4 && ret.size() < ret.capacity(); i++){
+		for (int i = 0; i < 4 && ret.size() < size; i++){
 			ret.push_back(n & 0xFF);
 			n >>= 8;
 		}
@@ -73,5 +76,6 @@ void test_sha512(){
 		}
 	}
 
+	test_midstate<hash::algorithm::SHA512>("SHA512");
 	std::cout << "SHA-512 implementation passed the test!\n";
 }
@@ -1,9 +1,10 @@
 #include "shamir.hpp"
+#include "shamir_gf256.hpp"
 #include "aes.hpp"
+#include "hex.hpp"
+#include "test_utility.hpp"
 #include <iostream>
 
-std::string defragment_secret(const std::vector<FiniteField32> &fragments);
-
 namespace{
 
 const std::string input =
@@ -29,6 +30,50 @@ void test_fragmentation(){
 	auto output = defragment_secret(fragment_secret(input));
 	if (input != output)
 		throw std::runtime_error("Shamir implementation cannot round-trip encode a secret");
+
+	//Every length around the chunk size, including secrets ending in bytes
+	//that look like padding, fed in uneven pieces.
+	for (size_t size = 0; size < 100; size++){
+		auto secret = input.substr(0, size);
+		if (size % 3 == 1)
+			secret.back() = 0;
+		if (size % 3 == 2)
+			secret.back() = (char)0x80;
+		auto fragments = fragment_secret(secret);
+		if (fragments.size() % SecretFragmenter::chunk_elements)
+			throw std::runtime_error("Shamir fragmentation produced a partial chunk");
+		for (auto &f : fragments)
+			if ((std::uint32_t)f >= FiniteField32::P)
+				throw std::runtime_error("Shamir fragmentation produced an invalid element");
+
+		std::string output;
+		SecretDefragmenter defragmenter;
+		for (size_t i = 0; i < fragments.size(); i += 3)
+			defragmenter.write(fragments.data() + i, std::min<size_t>(3, fragments.size() - i), output);
+		defragmenter.finish(output);
+		if (output != secret)
+			throw std::runtime_error("Shamir implementation cannot round-trip encode a secret of length " + std::to_string(size));
+	}
+}
+
+//Shares serialized before the format was versioned.
+void test_legacy_shares(){
+	const char * const legacy[] = {
+		"5eb20bc3e6367768c6df01aec8ab3f83bb17b4231db148c28d21691eaf0ae73d01000000dc95c078a2408989ad48a2145275f3d86b4fb8684593133e779b38d15bffb63d8d609d5539d6e9ae76a9b2f3fc46268075d11b0e",
+		"5eb20bc3e6367768c6df01aec8ab3f83bb17b4231db148c28d21691eaf0ae73d02000000367718565c67a28ecde7327248c6f0ce4023419faaaa89bb9a4ebb1de3abba978adf9d9595f2dad62f37a6b56b0af8aa7133c9ed",
+		"5eb20bc3e6367768c6df01aec8ab3f83bb17b4231db148c28d21691eaf0ae73d0300000090587033168ebb93ed86c3cf3e17eec415f7c9d514c2ff38b8013e6a6b58bef1875e9ed5f10eccfee8c49977dacdc9d5729576cd",
+	};
+	std::vector<ShamirShare> shares;
+	for (auto s : legacy){
+		std::vector<std::uint8_t> buffer(strlen(s) / 2);
+		utility::hex_decode(buffer.data(), s, buffer.size());
+		shares.emplace_back(buffer);
+		if (shares.back().version != ShamirShare::legacy_version || shares.back().serialize() != buffer)
+			throw std::runtime_error("Shamir implementation failed to round-trip a legacy share");
+	}
+	shares.erase(shares.begin());
+	if (recover_secret(shares) != "Shares from before the format had a version.")
+		throw std::runtime_error("Shamir implementation failed to recover a secret from legacy shares");
 }
 
 int count_bits(int n){
@@ -91,10 +136,328 @@ void test_sharing(){
 		throw std::runtime_error("Shamir implementation failed expected result on corruption test case. It somehow recovered the secret?");
 }
 
+void test_finite_field_arithmetic(){
+	const auto P = FiniteField32::P;
+	csprng::BlockCipherRng<symmetric::Aes<128>> rng;
+	std::vector<std::uint32_t> values = { 0, 1, 2, 4, 5, 6, (std::uint32_t)P - 1, (std::uint32_t)P, 0xFFFFFFFF };
+	for (int i = 0; i < 100; i++)
+		values.push_back(rng.get<std::uint32_t>());
+	for (auto a : values){
+		for (auto b : values){
+			if ((std::uint32_t)(FiniteField32(a) * FiniteField32(b)) != (std::uint64_t)a * b % P)
+				throw std::runtime_error("FiniteField32 multiplication is wrong");
+			if ((std::uint32_t)(FiniteField32(a) + FiniteField32(b)) != ((std::uint64_t)a + b) % P)
+				throw std::runtime_error("FiniteField32 addition is wrong");
+		}
+		if ((std::uint32_t)(FiniteField32(a) + -FiniteField32(a)) != 0)
+			throw std::runtime_error("FiniteField32 negation is wrong");
+	}
+
+	std::vector<FiniteField32> inverses(values.begin(), values.end());
+	FiniteField32::batch_inverse(inverses.data(), inverses.size());
+	for (size_t i = 0; i < values.size(); i++)
+		if (inverses[i] != FiniteField32(values[i]).multiplicative_inverse())
+			throw std::runtime_error("FiniteField32 batch inversion is wrong");
+
+	//multiply_add() and horner_step() on every size up to 40 elements, which
+	//leaves every possible tail to the SSE2 and scalar kernels, with
+	//multipliers both reduced and not.
+	std::vector<FiniteField32> src(40), dst(40);
+	for (size_t i = 0; i < src.size(); i++){
+		src[i] = values[(i * 7) % values.size()];
+		dst[i] = values[(i * 11 + 3) % values.size()];
+	}
+	for (size_t size = 0; size <= src.size(); size++){
+		for (auto c : { 0U, 1U, 5U, (std::uint32_t)P - 1, 0xFFFFFFFFU, 0x12345678U }){
+			auto add = dst;
+			auto horner = dst;
+			FiniteField32::multiply_add(add.data(), src.data(), c, size);
+			FiniteField32::horner_step(horner.data(), src.data(), c, size);
+			for (size_t i = 0; i < dst.size(); i++){
+				std::uint64_t x = src[i];
+				std::uint64_t y = dst[i];
+				auto expected_add = i < size ? (c * x + y) % P : y;
+				auto expected_horner = i < size ? (c * y + x) % P : y;
+				if ((std::uint32_t)add[i] != expected_add || (std::uint32_t)horner[i] != expected_horner)
+					throw std::runtime_error("FiniteField32 bulk operation is wrong for size " + std::to_string(size));
+			}
+		}
+	}
+}
+
+//The weights must agree with evaluating the interpolating polynomial.
+void test_lagrange_weights(){
+	csprng::BlockCipherRng<symmetric::Aes<128>> rng;
+	for (size_t k = 2; k < 10; k++){
+		std::vector<FiniteField32> x;
+		std::vector<std::pair<FiniteField32, FiniteField32>> points;
+		for (size_t i = 0; i < k; i++){
+			std::uint32_t y;
+			rng.get(y);
+			x.emplace_back((std::uint32_t)(i * 7 + 3));
+			points.emplace_back(x.back(), y % FiniteField32::P);
+		}
+		auto weights = lagrange_weights(x);
+		FiniteField32 sum;
+		for (size_t i = 0; i < k; i++)
+			sum += weights[i] * points[i].second;
+		if (sum != Polynomial::lagrange_polynomial(points).eval(0))
+			throw std::runtime_error("Lagrange weights are wrong");
+	}
+
+	bool threw = false;
+	try{
+		lagrange_weights({ 1, 2, 1 });
+	}catch (std::runtime_error &){
+		threw = true;
+	}
+	if (!threw)
+		throw std::runtime_error("Lagrange weights accepted duplicate x coordinates");
+
+	//x coordinates that only differ by P are duplicates too, and P is 0.
+	for (auto &x : std::vector<std::vector<FiniteField32>>{ { 1, 2, FiniteField32::P + 1 }, { 1, FiniteField32::P } }){
+		threw = false;
+		try{
+			lagrange_weights(x);
+		}catch (std::runtime_error &){
+			threw = true;
+		}
+		if (!threw)
+			throw std::runtime_error("Lagrange weights accepted aliased x coordinates");
+	}
+}
+
+//Big enough to be split across threads.
+void test_parallel_recovery(){
+	csprng::BlockCipherRng<symmetric::Aes<256>> rng;
+	std::string secret(300 << 10, 0);
+	rng.get_bytes(&secret[0], secret.size());
+	for (unsigned sharing_threads : { 1, 4 }){
+		auto shares = share_secret(secret, 5, 3, rng, sharing_threads);
+		shares.erase(shares.begin() + 1);
+		for (unsigned threads : { 1, 4, 0 })
+			if (recover_secret(shares, threads) != secret)
+				throw std::runtime_error("Shamir implementation failed to recover a secret with " + std::to_string(threads) + " threads");
+	}
+}
+
+std::uint8_t slow_multiply(std::uint8_t a, std::uint8_t b){
+	std::uint8_t ret = 0;
+	for (; b; b >>= 1){
+		if (b & 1)
+			ret ^= a;
+		a = (std::uint8_t)(a << 1) ^ (a & 0x80 ? 0x1B : 0);
+	}
+	return ret;
+}
+
+void test_gf256_arithmetic(){
+	for (int a = 0; a < 256; a++){
+		for (int b = 0; b < 256; b++)
+			if (gf256::multiply((std::uint8_t)a, (std::uint8_t)b) != slow_multiply((std::uint8_t)a, (std::uint8_t)b))
+				throw std::runtime_error("GF(2^8) multiplication is wrong");
+		if (a && gf256::multiply((std::uint8_t)a, gf256::inverse((std::uint8_t)a)) != 1)
+			throw std::runtime_error("GF(2^8) inverse is wrong");
+	}
+
+	//multiply_add() and multiply_xor() on every size up to 100 bytes, past
+	//three AVX2 vectors, against the slow reference multiplication.
+	csprng::BlockCipherRng<symmetric::Aes<128>> rng;
+	std::vector<std::uint8_t> src(100), dst(100);
+	rng.get_bytes(src.data(), src.size());
+	rng.get_bytes(dst.data(), dst.size());
+	for (size_t size = 0; size <= src.size(); size++){
+		for (int c : { 0, 1, 2, 0x53, 0xFF }){
+			auto add = dst;
+			auto horner = dst;
+			gf256::multiply_add(add.data(), src.data(), (std::uint8_t)c, size);
+			gf256::multiply_xor(horner.data(), src.data(), (std::uint8_t)c, size);
+			for (size_t i = 0; i < dst.size(); i++){
+				auto expected_add = i < size ? dst[i] ^ slow_multiply((std::uint8_t)c, src[i]) : dst[i];
+				auto expected_horner = i < size ? slow_multiply((std::uint8_t)c, dst[i]) ^ src[i] : dst[i];
+				if (add[i] != expected_add || horner[i] != expected_horner)
+					throw std::runtime_error("GF(2^8) bulk operation is wrong for size " + std::to_string(size));
+			}
+		}
+	}
+}
+
+void test_gf256_sharing(){
+	csprng::BlockCipherRng<symmetric::Aes<256>> rng;
+	const int share_count = 9;
+	const int threshold = 6;
+	auto shares = gf256::share_secret(input, share_count, threshold, rng);
+
+	std::vector<gf256::Share> shares_deserialized;
+	for (auto &share : shares){
+		if (share.y.size() != input.size())
+			throw std::runtime_error("GF(2^8) Shamir share has the wrong size");
+		shares_deserialized.emplace_back(share.serialize());
+	}
+
+	std::vector<gf256::Share> share_selection;
+	for (int i = 1; i < 1 << share_count; i++){
+		auto bits = count_bits(i);
+		if (bits < 2)
+			continue;
+		share_selection.clear();
+		for (int j = 0; j < share_count; j++)
+			if (i & (1 << j))
+				share_selection.push_back(shares_deserialized[j]);
+		auto recovery_succeeded = gf256::recover_secret(share_selection) == input;
+		if (recovery_succeeded != (bits >= threshold))
+			throw std::runtime_error("GF(2^8) Shamir implementation failed expected result on test case " + std::to_string(i));
+	}
+
+	share_selection.assign(shares.begin(), shares.begin() + 2);
+	share_selection[1].x = share_selection[0].x;
+	bool threw = false;
+	try{
+		gf256::recover_secret(share_selection);
+	}catch (std::runtime_error &){
+		threw = true;
+	}
+	if (!threw)
+		throw std::runtime_error("GF(2^8) Shamir implementation accepted duplicate shares");
+}
+
+void test_gf256_streaming(){
+	csprng::BlockCipherRng<symmetric::Aes<256>> rng;
+	//Spans several blocks.
+	std::vector<std::uint8_t> secret(150000);
+	rng.get_bytes(secret.data(), secret.size());
+
+	VectorSource source(secret);
+	std::vector<VectorSink> sinks(5);
+	std::vector<utility::DataSink *> sink_pointers;
+	for (auto &sink : sinks)
+		sink_pointers.push_back(&sink);
+	gf256::share_secret(source, sink_pointers, 3, rng);
+
+	std::vector<VectorSource> sources;
+	for (size_t i : { 4, 1, 2 })
+		sources.emplace_back(sinks[i].data);
+	std::vector<utility::DataSource *> source_pointers;
+	for (auto &s : sources)
+		source_pointers.push_back(&s);
+	VectorSink recovered;
+	gf256::recover_secret(source_pointers, recovered);
+	if (recovered.data != secret)
+		throw std::runtime_error("GF(2^8) Shamir implementation failed to recover a streamed secret");
+
+	//The streamed shares are ordinary serialized shares.
+	std::vector<gf256::Share> shares;
+	for (size_t i : { 0, 3, 2 })
+		shares.emplace_back(sinks[i].data);
+	if (gf256::recover_secret(shares) != std::string(secret.begin(), secret.end()))
+		throw std::runtime_error("GF(2^8) Shamir implementation failed to recover a streamed secret");
+
+	//A short first share must not truncate the secret.
+	auto truncated = sinks[4].data;
+	truncated.pop_back();
+	std::vector<VectorSource> sources2;
+	sources2.emplace_back(truncated);
+	sources2.emplace_back(sinks[1].data);
+	sources2.emplace_back(sinks[2].data);
+	std::vector<utility::DataSource *> source_pointers2;
+	for (auto &s : sources2)
+		source_pointers2.push_back(&s);
+	bool failed = false;
+	try{
+		VectorSink recovered2;
+		gf256::recover_secret(source_pointers2, recovered2);
+	}catch (std::runtime_error &){
+		failed = true;
+	}
+	if (!failed)
+		throw std::runtime_error("GF(2^8) Shamir implementation accepted shares of different lengths");
+}
+
+bool chunked_recovery_fails(const std::vector<std::vector<std::uint8_t>> &shares){
+	std::vector<VectorSource> sources(shares.begin(), shares.end());
+	std::vector<utility::DataSource *> pointers;
+	for (auto &s : sources)
+		pointers.push_back(&s);
+	VectorSink recovered;
+	try{
+		recover_secret(pointers, recovered);
+	}catch (std::runtime_error &){
+		return true;
+	}
+	return false;
+}
+
+void test_chunked_shares(){
+	csprng::BlockCipherRng<symmetric::Aes<256>> rng;
+	for (size_t size : { 0, 1000, 200000 }){
+		std::vector<std::uint8_t> secret(size);
+		rng.get_bytes(secret.data(), secret.size());
+		VectorSource source(secret);
+		std::vector<VectorSink> sinks(5);
+		std::vector<utility::DataSink *> sink_pointers;
+		for (auto &sink : sinks)
+			sink_pointers.push_back(&sink);
+		share_secret(source, sink_pointers, 3, rng);
+
+		//The shares don't depend on the number of threads.
+		std::array<std::uint8_t, 32> seed = {};
+		std::vector<VectorSink> single(5), multiple(5);
+		std::vector<utility::DataSink *> single_pointers, multiple_pointers;
+		for (size_t i = 0; i < 5; i++){
+			single_pointers.push_back(&single[i]);
+			multiple_pointers.push_back(&multiple[i]);
+		}
+		VectorSource source1(secret), source2(secret);
+		detail::share_secret(source1, single_pointers, 3, seed, 1);
+		detail::share_secret(source2, multiple_pointers, 3, seed, 4);
+		for (size_t i = 0; i < 5; i++)
+			if (single[i].data != multiple[i].data)
+				throw std::runtime_error("Shamir implementation produced different chunked shares with more threads");
+
+		for (unsigned threads : { 1, 4, 0 }){
+			std::vector<VectorSource> sources;
+			for (size_t i : { 4, 0, 2 })
+				sources.emplace_back(sinks[i].data);
+			std::vector<utility::DataSource *> source_pointers;
+			for (auto &s : sources)
+				source_pointers.push_back(&s);
+			VectorSink recovered;
+			recover_secret(source_pointers, recovered, threads);
+			if (recovered.data != secret)
+				throw std::runtime_error("Shamir implementation failed to recover a secret from chunked shares");
+		}
+
+		if (!chunked_recovery_fails({ sinks[0].data, sinks[1].data }))
+			throw std::runtime_error("Shamir implementation recovered a secret from too few chunked shares");
+		auto corrupt = sinks[1].data;
+		corrupt[corrupt.size() / 2] ^= 1;
+		if (!chunked_recovery_fails({ sinks[0].data, corrupt, sinks[2].data }))
+			throw std::runtime_error("Shamir implementation accepted a corrupt chunked share");
+		auto truncated = sinks[1].data;
+		truncated.pop_back();
+		if (!chunked_recovery_fails({ sinks[0].data, truncated, sinks[2].data }))
+			throw std::runtime_error("Shamir implementation accepted a truncated chunked share");
+	}
+}
+
+void test_gf256(){
+	for_each_feature_set([](){
+		test_gf256_arithmetic();
+		test_gf256_sharing();
+	});
+	test_gf256_streaming();
+}
+
 }
 
 void test_shamir(){
 	test_fragmentation();
+	test_legacy_shares();
 	test_sharing();
+	for_each_feature_set(test_finite_field_arithmetic);
+	test_lagrange_weights();
+	test_parallel_recovery();
+	test_chunked_shares();
+	test_gf256();
 	std::cout << "Shamir implementation passed the test!\n";
 }
@@ -1,6 +1,13 @@
 #include "stream.hpp"
 #include "aes.hpp"
 #include "twofish.hpp"
+#include "sha256.hpp"
+#include "mirrored_ringbuffer.hpp"
+#include "base64.hpp"
+#include "pipeline.hpp"
+#include "test_utility.hpp"
+#include <sstream>
+#include <iostream>
 #include <cstring>
 #include <cassert>
 #include <vector>
@@ -56,6 +63,13 @@ std::vector<std::uint8_t> process_ctr(
     return ret;
 }
 
+class FailingSink : public utility::DataSink{
+public:
+	size_t write(const void *, size_t) override{
+		throw std::runtime_error("sink failed");
+	}
+};
+
 template <typename C>
 std::vector<std::uint8_t> process_ctr(
 		const std::vector<std::uint8_t> &input,
@@ -80,8 +94,129 @@ void basic_test_stream(){
     assert(CTR_CIPHER && decrypted.size() == n && !memcmp(input, decrypted.data(), n));
 }
 
+//Hashes the plaintext and the ciphertext in the same pass that encrypts.
+template <typename C>
+void hashing_test_stream(){
+	typename C::key_t key(::key);
+	typename C::block_t iv = C::block_from_string(::iv);
+	auto n = strlen(input);
+
+	hash::algorithm::SHA256 plaintext_hash;
+	hash::algorithm::SHA256 ciphertext_hash;
+	utility::StdDataSource file(std::make_unique<std::istringstream>(std::string(input, n)));
+	utility::HashingSource<> source(file, plaintext_hash);
+	utility::HashingSink<hash::algorithm::SHA256> sink(ciphertext_hash);
+
+	symmetric::stream::CtrCipherStream<C> stream(C(key), iv, true);
+	source >> stream;
+	stream.terminate();
+	stream >> sink;
+
+	assert2(plaintext_hash.get_digest() == hash::algorithm::SHA256::compute(input, n));
+	auto ciphertext = process_ctr<C>(input, n, key, iv, true);
+	assert2(ciphertext_hash.get_digest() == hash::algorithm::SHA256::compute(ciphertext.data(), ciphertext.size()));
+}
+
+//Pushes enough data through the stream, in odd sized pieces, that blocks
+//straddle the ends of its ring buffers, and checks against CTR computed by
+//hand.
+template <typename C, typename Buffer>
+void chunked_test_stream(){
+	typename C::key_t key(::key);
+	typename C::block_t iv = C::block_from_string(::iv);
+	C cipher(key);
+
+	std::vector<std::uint8_t> plaintext(300007);
+	for (size_t i = 0; i < plaintext.size(); i++)
+		plaintext[i] = (std::uint8_t)(i * i + i / 7);
+
+	std::vector<std::uint8_t> expected(plaintext.size());
+	for (size_t i = 0; i < plaintext.size(); i += C::block_size){
+		auto counter = iv;
+		auto s = (std::uint64_t)(i / C::block_size);
+		for (size_t j = 0; j < C::block_size && s; j++, s >>= 8)
+			counter[j] ^= s & 0xFF;
+		auto mask = cipher.encrypt_block(counter);
+		for (size_t j = 0; j < C::block_size && i + j < plaintext.size(); j++)
+			expected[i + j] = plaintext[i + j] ^ mask[j];
+	}
+
+	symmetric::stream::CtrCipherStream<C, Buffer> stream(cipher, iv, true);
+	std::vector<std::uint8_t> actual(plaintext.size());
+	size_t written = 0;
+	size_t read = 0;
+	while (written < plaintext.size()){
+		written += stream.write(plaintext.data() + written, std::min<size_t>(50021, plaintext.size() - written));
+		read += stream.read(actual.data() + read, std::min<size_t>(40009, actual.size() - read));
+	}
+	stream.terminate();
+	while (read < actual.size()){
+		auto n = stream.read(actual.data() + read, actual.size() - read);
+		assert2(n);
+		read += n;
+	}
+	assert2(actual == expected);
+}
+
+//Runs encryption, base64 encoding, decoding and decryption as a pipeline with
+//small queues, so that every stage has to wait on its neighbors, and checks
+//that the data makes the round trip intact.
+template <typename C>
+void pipeline_test_stream(){
+	typename C::key_t key(::key);
+	typename C::block_t iv = C::block_from_string(::iv);
+
+	std::string plaintext(1000003, 0);
+	for (size_t i = 0; i < plaintext.size(); i++)
+		plaintext[i] = (char)(i * 7 + i / 251);
+
+	{
+		utility::StdDataSource source(std::make_unique<std::istringstream>(plaintext));
+		symmetric::stream::CtrCipherStream<C> encrypt(C(key), iv, true);
+		utility::Base64Encoder encoder;
+		utility::Base64Decoder decoder;
+		symmetric::stream::CtrCipherStream<C> decrypt(C(key), iv, false);
+		VectorSink sink;
+		utility::Pipeline pipeline(source, 4 << 10);
+		pipeline
+			.add(encrypt, "encrypt")
+			.add(encoder, "encode")
+			.add(decoder, "decode")
+			.add(decrypt, "decrypt");
+		pipeline.run(sink);
+		assert2(sink.data.size() == plaintext.size() && !memcmp(sink.data.data(), plaintext.data(), plaintext.size()));
+
+		auto &statistics = pipeline.get_statistics();
+		assert2(statistics.size() == 6);
+		assert2(statistics[0].bytes_out == plaintext.size());
+		assert2(statistics[1].name == "encrypt" && statistics[1].bytes_out == plaintext.size());
+		assert2(statistics[2].bytes_out == (plaintext.size() + 2) / 3 * 4);
+		assert2(statistics[5].bytes_in == plaintext.size());
+	}
+
+	//A failure in any stage stops the whole pipeline and reaches the caller.
+	{
+		utility::StdDataSource source(std::make_unique<std::istringstream>(plaintext));
+		symmetric::stream::CtrCipherStream<C> encrypt(C(key), iv, true);
+		FailingSink sink;
+		utility::Pipeline pipeline(source, 4 << 10);
+		pipeline.add(encrypt);
+		bool thrown = false;
+		try{
+			pipeline.run(sink);
+		}catch (std::runtime_error &){
+			thrown = true;
+		}
+		assert2(thrown);
+	}
+}
+
 void test_stream(){
     basic_test_stream<symmetric::Aes<256>>();
     basic_test_stream<symmetric::Twofish<256>>();
+    hashing_test_stream<symmetric::Aes<256>>();
+    chunked_test_stream<symmetric::Aes<256>, utility::RingBuffer>();
+    chunked_test_stream<symmetric::Aes<256>, utility::MirroredRingBuffer>();
+    pipeline_test_stream<symmetric::Aes<256>>();
     std::cout << "CtrCipherStream passed the test!\n";
 }
@@ -2,5 +2,87 @@
 
 #include "hash.hpp"
 #include "hex.hpp"
+#include "cpu.hpp"
+#include "source_sink.hpp"
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+//Collects everything written to it.
+class VectorSink : public utility::DataSink{
+public:
+	std::vector<std::uint8_t> data;
+	size_t write(const void *src, size_t size) override{
+		auto p = (const std::uint8_t *)src;
+		this->data.insert(this->data.end(), p, p + size);
+		return size;
+	}
+};
+
+//Reads from a vector that must outlive it.
+class VectorSource : public utility::DataSource{
+	const std::vector<std::uint8_t> *data;
+	size_t offset = 0;
+public:
+	VectorSource(const std::vector<std::uint8_t> &data): data(&data){}
+	size_t read(void *dst, size_t size) override{
+		auto n = std::min(size, this->data->size() - this->offset);
+		if (n)
+			memcpy(dst, this->data->data() + this->offset, n);
+		this->offset += n;
+		return n;
+	}
+};
+
+//Runs f once with each set of kernels the machine supports, starting with the
+//scalar code, then restores the detected features, even if f throws.
+template <typename F>
+void for_each_feature_set(const F &f){
+	struct Restore{
+		utility::cpu::Features features = utility::cpu::features();
+		~Restore(){
+			utility::cpu::set_features(this->features);
+		}
+	} restore;
+	auto no_avx2 = restore.features;
+	no_avx2.avx2 = false;
+	auto no_pclmul = restore.features;
+	no_pclmul.pclmul = false;
+	for (auto &features : { utility::cpu::Features(), restore.features, no_avx2, no_pclmul }){
+		utility::cpu::set_features(features);
+		f();
+	}
+}
+
+//Hashes a common prefix once, then forks from it through clone() and through
+//a serialized midstate, and checks both against hashing everything at once.
+template <typename Algorithm>
+void test_midstate(const char *name){
+	const std::string prefix = "The quick brown fox jumps over the lazy dog, and then it jumps over the lazy dog again";
+	const char * const suffixes[] = { "", "a", "The quick brown fox jumps over the lazy dog once more for good measure, just to be sure" };
+
+	Algorithm base;
+	base.update(prefix.data(), prefix.size());
+	auto serialized = base.save_state().serialize();
+	if (serialized.size() != Algorithm::Midstate::serialized_size)
+		throw std::runtime_error((std::string)"Failed test: " + name + " midstate has the wrong serialized size");
+
+	for (auto suffix : suffixes){
+		auto expected = Algorithm::compute(prefix + suffix);
+
+		auto clone = base.clone();
+		clone.update(suffix, strlen(suffix));
+		if (clone.get_digest() != expected)
+			throw std::runtime_error((std::string)"Failed test: cloned " + name + " doesn't match the full hash");
+
+		Algorithm resumed;
+		resumed.load_state(Algorithm::Midstate::deserialize(serialized.data(), serialized.size()));
+		resumed.update(suffix, strlen(suffix));
+		if (resumed.get_digest() != expected)
+			throw std::runtime_error((std::string)"Failed test: resumed " + name + " doesn't match the full hash");
+	}
+}
@@ -0,0 +1,127 @@
+#include "thread_local_rng.hpp"
+#include "aes.hpp"
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+namespace{
+
+typedef symmetric::Aes<256> Cipher;
+typedef csprng::BlockCipherRng<Cipher> Generator;
+
+#ifdef _WIN32
+typedef DWORD process_id_t;
+
+process_id_t current_process(){
+	return GetCurrentProcessId();
+}
+#else
+typedef pid_t process_id_t;
+
+process_id_t current_process(){
+	return getpid();
+}
+#endif
+
+std::atomic<std::uint64_t> reseed_interval(csprng::ThreadLocalRng::default_reseed_interval);
+
+struct Seeded{
+	std::optional<Generator> rng;
+	process_id_t process = 0;
+	std::uint64_t generated = 0;
+
+	bool stale(process_id_t process) const{
+		return !this->rng || this->process != process;
+	}
+};
+
+std::mutex master_mutex;
+Seeded master;
+
+#ifndef _WIN32
+//Holds the master's mutex across fork(), so that the child doesn't inherit it
+//locked by a thread that doesn't exist there.
+void install_fork_handlers(){
+	static std::once_flag once;
+	std::call_once(once, [](){
+		auto prepare = [](){ master_mutex.lock(); };
+		auto parent = [](){ master_mutex.unlock(); };
+		auto child = [](){ new (&master_mutex) std::mutex; };
+		if (pthread_atfork(prepare, parent, child))
+			throw std::runtime_error("failed to install ThreadLocalRng fork handlers");
+	});
+}
+#endif
+
+void seed(Seeded &dst, process_id_t process){
+#ifndef _WIN32
+	install_fork_handlers();
+#endif
+	{
+		std::lock_guard<std::mutex> lg(master_mutex);
+		//A child process sees a stale master too, so that it doesn't hand
+		//out the same seeds as its parent.
+		if (master.stale(process)){
+			master.rng.emplace();
+			master.process = process;
+		}
+		auto key = master.rng->get_bytes_fixed<Cipher::key_t::size>();
+		auto counter = master.rng->get_bytes_fixed<Cipher::block_size>();
+		dst.rng.emplace(Cipher::key_t(key), counter);
+	}
+	dst.process = process;
+	dst.generated = 0;
+}
+
+thread_local Seeded thread_state;
+
+}
+
+namespace csprng{
+
+void ThreadLocalRng::get_bytes(void *void_dst, size_t size){
+	auto dst = (std::uint8_t *)void_dst;
+	auto &state = thread_state;
+	auto process = current_process();
+	auto interval = ::reseed_interval.load(std::memory_order_relaxed);
+	while (size){
+		if (state.stale(process) || state.generated >= interval)
+			seed(state, process);
+		auto n = (size_t)std::min<std::uint64_t>(size, interval - state.generated);
+		state.rng->get_bytes(dst, n);
+		state.generated += n;
+		dst += n;
+		size -= n;
+	}
+}
+
+ThreadLocalRng &ThreadLocalRng::get(){
+	static ThreadLocalRng ret;
+	return ret;
+}
+
+std::uint64_t ThreadLocalRng::reseed_interval(){
+	return ::reseed_interval.load(std::memory_order_relaxed);
+}
+
+void ThreadLocalRng::set_reseed_interval(std::uint64_t bytes){
+	if (!bytes)
+		throw std::runtime_error("ThreadLocalRng reseed interval must be positive");
+	::reseed_interval.store(bytes, std::memory_order_relaxed);
+}
+
+void ThreadLocalRng::reseed(){
+	thread_state.rng.reset();
+}
+
+}
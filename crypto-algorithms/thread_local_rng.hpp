@@ -0,0 +1,34 @@
+#pragma once
+
+#include "rng.hpp"
+#include <cstdint>
+
+namespace csprng{
+
+//A Prng backed by a generator private to the calling thread, so that any
+//number of threads can draw from it without locking:
+//
+//    auto key = asymmetric::Ed25519::PrivateKey::generate(csprng::ThreadLocalRng::get());
+//
+//Each thread's generator is created on first use, with a key and counter
+//drawn from a single process-wide master generator, which is itself seeded
+//from std::random_device only once. A thread's generator is reseeded from
+//the master after it has produced reseed_interval() bytes, and every
+//generator, including the master, is reseeded after a fork, so that parent
+//and child never share a stream.
+//The object holds no state, so any instance can be used from any thread.
+class ThreadLocalRng : public Prng{
+public:
+	static const std::uint64_t default_reseed_interval = 1ULL << 30;
+
+	void get_bytes(void *void_dst, size_t size) override;
+	using Prng::get_bytes;
+	static ThreadLocalRng &get();
+	static std::uint64_t reseed_interval();
+	//Takes effect for every thread the next time it generates anything.
+	static void set_reseed_interval(std::uint64_t bytes);
+	//Forces the calling thread's generator to be reseeded on next use.
+	static void reseed();
+};
+
+}